@@ -7,7 +7,329 @@
 #include <SDL.h>    // include SDL stuff
 #include <stdio.h>  // standard input/output
 #include <time.h>   // used for rng
-#include <stdlib.h> // contains rand()
+#include <stdlib.h> // contains atoi(), strtoul()
+#include <string.h> // strcmp() for command line options
+
+#include "pong_sim.h"    // physics, AI and scoring
+#include "pong_render.h" // drawing
+#include "pong_log.h"    // console messages, written on their own thread
+#include "pong_replay.h" // --record and --replay
+#include "pong_rally.h" // --rallies
+#include "pong_profile.h" // --profile
+#include "pong_timing.h" // F3 overlay and --timing-file
+#include "pong_rollback.h" // --host and --join
+#include "pong_snapshot.h" // game thread to render thread
+#include "pong_latency.h" // input to present times
+
+#define MENU_TEXT "Press F1 for controls.\n[1] Classic vs. AI\n[2] Classic vs. Human\n[3] RWG Mode vs. AI\n[4] RWG Mode vs. Human\n\n"
+
+#define DEFAULT_TICK_RATE 60	// simulation steps per second, config speeds are per 1/60 s and scaled to it
+#define MAX_FRAME_TIME 0.25		// most lag (in seconds) caught up in one pass, beyond that the game slows down instead
+#define JOIN_TIMEOUT 10000		// ms to wait for the host to answer
+#define SPIN_MS 1.5				// --low-latency: sleep until this close to a deadline, then spin
+#define IDLE_WAIT_MS 250		// longest either thread sleeps at the menu without looking around
+#define DEFAULT_REFRESH_RATE 60	// frames per second without vsync, when the display doesn't say
+
+//
+// prints what happened during a tick and keeps the window title in step with the score
+//
+static void report_events(SDL_Window* window, const PongMatch* match, unsigned int events)
+{
+	char title[24]; // "%d-%d", room for any two ints
+
+	if (events & PONG_EVENT_WALL_TOP)
+	{
+		PONG_LOG(PONG_LOG_DEBUG, "COLLISION: Top Wall\n");
+	}
+	if (events & PONG_EVENT_WALL_BOTTOM)
+	{
+		PONG_LOG(PONG_LOG_DEBUG, "COLLISION: Bottom Wall\n");
+	}
+	if (events & PONG_EVENT_HIT_P1)
+	{
+		PONG_LOG(PONG_LOG_DEBUG, "COLLISION: Player 1\n");
+	}
+	if (events & PONG_EVENT_HIT_P2)
+	{
+		PONG_LOG(PONG_LOG_DEBUG, "COLLISION: Player 2\n");
+	}
+
+	if (events & PONG_EVENT_MENU)
+	{
+		SDL_snprintf(title, sizeof(title), "%d-%d", 0, 0);
+		SDL_SetWindowTitle(window, title);
+		PONG_LOG(PONG_LOG_INFO, MENU_TEXT);
+	}
+	if (events & (PONG_EVENT_START | PONG_EVENT_SCORE))
+	{
+		// change title
+		SDL_snprintf(title, sizeof(title), "%d-%d", match->p1Score, match->p2Score);
+		SDL_SetWindowTitle(window, title);
+	}
+	if (events & PONG_EVENT_SCORE)
+	{
+		// print score
+		PONG_LOG(PONG_LOG_INFO, "SCORE: %d-%d\n", match->p1Score, match->p2Score);
+		PONG_LOG(PONG_LOG_INFO, "Last Point: %d\n", match->lastPoint);
+	}
+	if (events & PONG_EVENT_WIN)
+	{
+		if (match->p1Score >= match->config.winScore)
+		{
+			PONG_LOG(PONG_LOG_INFO, "Player 1 wins!\n");
+		}
+		else if (match->multiplayer == 1)
+		{
+			PONG_LOG(PONG_LOG_INFO, "Player 2 wins!\n");
+		}
+		else
+		{
+			PONG_LOG(PONG_LOG_INFO, "AI wins!\n");
+		}
+		PONG_LOG(PONG_LOG_INFO, MENU_TEXT);
+	}
+}
+
+//
+// the render thread: draws the newest snapshot and presents it, over and
+// over, so waiting for vsync never holds up input or the simulation
+//
+typedef struct RenderThread
+{
+	SDL_Window* window;
+	int vsync;
+	int lowLatency;				// present each tick as soon as it is published, without vsync
+	double tickTime;			// seconds per simulation step, for interpolation
+	PongSnapshotBuffer snapshots;
+	PongTiming timing;			// drawing, plus the game thread's phases from each snapshot
+	SDL_atomic_t running;		// cleared by the game thread to stop drawing
+	SDL_atomic_t ready;			// 1 once the renderer is up, -1 if it couldn't be made
+	SDL_sem* wake;				// posted by the game thread with each snapshot, for an idle render thread
+	double frameTime;			// seconds between presents when vsync was asked for and not given, else 0
+	PongLatency latency;		// input to present, measured after every present
+} RenderThread;
+
+// nothing moves at the menu: a frame of it only has to be drawn again when
+// something on it changes, a score, F2, F3 or the window
+typedef struct MenuPicture
+{
+	int shown;					// the last frame drawn was the menu
+	Uint32 state;				// pong_sim_checksum of the match
+	int scanlines;
+	int timings;
+	int exposures;
+} MenuPicture;
+
+static int at_menu(const PongSnapshot* snap)
+{
+	return snap->prev.gameOn == 0 && snap->cur.gameOn == 0;
+}
+
+static void menu_picture(MenuPicture* picture, const PongSnapshot* snap)
+{
+	picture->shown = at_menu(snap);
+	picture->state = picture->shown ? pong_sim_checksum(&snap->cur) : 0;
+	picture->scanlines = snap->scanlines;
+	picture->timings = snap->timings;
+	picture->exposures = snap->exposures;
+}
+
+static int menu_unchanged(const MenuPicture* drawn, const PongSnapshot* snap)
+{
+	MenuPicture picture;
+
+	menu_picture(&picture, snap);
+	return drawn->shown && picture.shown && picture.state == drawn->state && picture.scanlines == drawn->scanlines
+		&& picture.timings == drawn->timings && picture.exposures == drawn->exposures;
+}
+
+// vsync was asked for and not given: present at the display's rate rather
+// than as fast as the GPU goes
+static double frame_time(SDL_Window* window, SDL_Renderer* renderer, int vsync)
+{
+	SDL_RendererInfo info;
+	SDL_DisplayMode mode;
+	int refreshRate = DEFAULT_REFRESH_RATE;
+
+	if (!vsync || SDL_GetRendererInfo(renderer, &info) < 0 || (info.flags & SDL_RENDERER_PRESENTVSYNC))
+	{
+		return 0.0;
+	}
+	if (SDL_GetWindowDisplayMode(window, &mode) == 0 && mode.refresh_rate > 0)
+	{
+		refreshRate = mode.refresh_rate;
+	}
+	return 1.0 / refreshRate;
+}
+
+// low latency: sleeps until just before the next tick is due, then spins
+// until the game thread has published it
+static void wait_for_snapshot(RenderThread* rt, Uint64 due)
+{
+	Uint64 spin = (Uint64)(SPIN_MS / 1000.0 * SDL_GetPerformanceFrequency());
+
+	while (SDL_AtomicGet(&rt->running) && !pong_snapshot_fresh(&rt->snapshots))
+	{
+		if (SDL_GetPerformanceCounter() + spin < due)
+		{
+			SDL_Delay(1);
+		}
+	}
+}
+
+static int render_thread(void* data)
+{
+	RenderThread* rt = (RenderThread*)data;
+	double countsPerTick = rt->tickTime * SDL_GetPerformanceFrequency();
+	SDL_Renderer* renderer;
+	PongRenderer view;
+	MenuPicture drawn;			// what the last frame showed, if it was the menu
+	Uint64 nextPresent = 0;		// without vsync, the soonest the next frame may go out
+
+	// a renderer is only used from the thread that made it
+	renderer = SDL_CreateRenderer(rt->window, -1, SDL_RENDERER_ACCELERATED | (rt->vsync && !rt->lowLatency ? SDL_RENDERER_PRESENTVSYNC : 0));
+	if (!renderer)
+	{
+		fprintf(stderr, "*** Failed to create renderer: %s\n", SDL_GetError());
+		SDL_AtomicSet(&rt->ready, -1);
+		return 1;
+	}
+	pong_render_init(&view, renderer);
+	view.timing = &rt->timing;
+	rt->frameTime = frame_time(rt->window, renderer, rt->vsync && !rt->lowLatency);
+	SDL_memset(&drawn, 0, sizeof(drawn));
+	SDL_AtomicSet(&rt->ready, 1);
+
+	while (SDL_AtomicGet(&rt->running))
+	{
+		const PongSnapshot* snap;
+		double alpha;   // how far between the last two ticks we are drawing
+
+		snap = pong_snapshot_read(&rt->snapshots);
+		if (rt->lowLatency && !at_menu(snap))
+		{
+			wait_for_snapshot(rt, snap->curTime + (Uint64)countsPerTick);
+			pong_timing_skip(&rt->timing); // waiting isn't part of the frame
+			snap = pong_snapshot_read(&rt->snapshots);
+		}
+
+		// the menu is already on screen: sleep until the game thread has something new
+		if (menu_unchanged(&drawn, snap))
+		{
+			SDL_SemWaitTimeout(rt->wake, IDLE_WAIT_MS);
+			pong_timing_skip(&rt->timing);
+			continue;
+		}
+
+		pong_timing_begin(&rt->timing);
+		SDL_memcpy(rt->timing.current, snap->gamePhases, sizeof(snap->gamePhases));
+
+		// the picture runs up to a tick behind the simulation, blending towards cur
+		alpha = (double)(Sint64)(SDL_GetPerformanceCounter() - snap->curTime) / countsPerTick;
+		if (alpha > 1.0)
+		{
+			alpha = 1.0;
+		}
+
+		// a reset teleports the ball and paddles, don't slide them across the
+		// screen. Low latency always shows the newest tick as it is
+		if (snap->prev.gameOn != snap->cur.gameOn || snap->prev.ballInPlay != snap->cur.ballInPlay || rt->lowLatency)
+		{
+			alpha = 1.0;
+		}
+
+		//
+		// draw everything
+		//
+		pong_render_frame(&view, &snap->prev, &snap->cur, alpha, snap->scanlines);
+		if (snap->timings == 1)
+		{
+			pong_render_timings(&view, &rt->timing, snap->cur.config.scrHeight);
+		}
+		pong_timing_mark(&rt->timing, PONG_PHASE_OVERLAY);
+
+		// display everything we just drew
+		SDL_RenderPresent(renderer);
+		pong_timing_mark(&rt->timing, PONG_PHASE_PRESENT);
+		pong_timing_end(&rt->timing);
+		pong_latency_presented(&rt->latency, snap->inputTime, SDL_GetPerformanceCounter());
+		menu_picture(&drawn, snap);
+
+		// no vsync to hold us back, so don't go round faster than the display can show
+		if (rt->frameTime > 0.0)
+		{
+			Uint64 now = SDL_GetPerformanceCounter();
+
+			if (nextPresent > now)
+			{
+				SDL_Delay((Uint32)((nextPresent - now) * 1000 / SDL_GetPerformanceFrequency()));
+				now = nextPresent;
+			}
+			nextPresent = now + (Uint64)(rt->frameTime * SDL_GetPerformanceFrequency());
+			pong_timing_skip(&rt->timing); // the pause isn't part of the next frame
+		}
+	}
+
+	pong_render_destroy(&view);
+	SDL_DestroyRenderer(renderer);
+	return 0;
+}
+
+//
+// --rallies: writes out the rally that ended this tick, if one did. Games
+// are numbered from 1 in the order they were started
+//
+static void record_rally(PongRallyWriter* rallies, PongRallyTracker* tracker, const PongMatch* match, unsigned int events, Uint32* games)
+{
+	PongRally rally;
+
+	if (events & PONG_EVENT_START)
+	{
+		(*games)++;
+	}
+	if (rallies->file && pong_rally_track(tracker, match, events, &rally))
+	{
+		rally.match = *games;
+		pong_rally_writer_add(rallies, &rally);
+	}
+}
+
+//
+// prints a pong_sim_state to stderr, four fields to a line. Fields that
+// differ from other, if there is one, are marked with a *. Straight to
+// stderr, not the log: the report is wanted whatever the log level, in one
+// piece
+//
+static void print_state(const char* title, const int32_t* state, const int32_t* other)
+{
+	fprintf(stderr, "*** %s\n", title);
+	for (int i = 0; i < PONG_SIM_STATE_FIELDS; i++)
+	{
+		int changed = other && other[i] != state[i];
+
+		fprintf(stderr, "  %c%-18s %11d", changed ? '*' : ' ', pong_sim_state_names[i], (int)state[i]);
+		if (i % 4 == 3 || i == PONG_SIM_STATE_FIELDS - 1)
+		{
+			fprintf(stderr, "\n");
+		}
+	}
+}
+
+//
+// stamps key events as SDL pumps them, before they wait in the queue.
+// Runs on the thread that pumps events, the game thread
+//
+static int SDLCALL stamp_keys(void* data, SDL_Event* e)
+{
+	Uint64* stamp = (Uint64*)data;
+
+	// the oldest change the next tick hasn't used yet
+	if ((e->type == SDL_KEYDOWN || e->type == SDL_KEYUP) && !e->key.repeat && *stamp == 0)
+	{
+		*stamp = SDL_GetPerformanceCounter();
+	}
+	return 0;
+}
 
 int main(int argc, char** argv)
 {
@@ -16,96 +338,259 @@ int main(int argc, char** argv)
 	//
 	SDL_Window* window = NULL;      // a window to draw stuff on
 	const Uint8* keys = NULL;       // pointer to keyboard state managed by SDL
-	SDL_Renderer* renderer = NULL;  // processes our drawing commands
-	SDL_Rect p1;					
-	SDL_Rect p2;
-	SDL_Rect ball;
-
-	SDL_Point p1Center;				// used in collision detection
-	SDL_Point p2Center;
-	SDL_Point ballCenter;			
-
-	srand(time(NULL));				// random number seed
+	static RenderThread rt;         // draws the match on its own thread
+	SDL_Thread* renderThread;
+	PongSnapshot first;             // what the render thread shows until the game thread publishes
+
+	PongConfig config;				// balance settings
+	const char* profileFile = NULL;	// balance settings are read from here instead of the defaults
+	PongMatch match;				// paddles, ball, score and flags
+	PongMatch prevMatch;			// state as of the previous tick, for render interpolation
+
+	// timing
+	int tickRate = DEFAULT_TICK_RATE;
+	int vsync = 1;					// set to zero to present as fast as possible
+	int lowLatency = 0;				// keys read at the last moment, each tick presented at once without vsync
+	int exposures = 0;				// window exposes and resizes, passed on so the menu is drawn again
+	int idle;						// at the menu with nothing to do until an event comes
+	const char* logFile = NULL;		// NULL = console
+	unsigned int seed = (unsigned int)time(NULL);	// serves and RWG colours, --seed replays a match
+	uint64_t matchSeed;
+	uint64_t matchStream = 0;
+	double tickTime;				// seconds per simulation step
+	double accumulator = 0.0;		// unsimulated time carried over between passes
+	Uint64 lastTime;
+	PongInput commands = 0;			// key-down commands waiting for the next tick
+	Uint64 keyStamp = 0;			// when the oldest key event no tick has used yet was pumped, 0 if none
+	Uint64 inputTime = 0;			// the stamp the latest tick was played with
+
+	// recordings
+	const char* recordFile = NULL;	// every tick's input is written here
+	const char* replayFile = NULL;	// ticks come from here instead of the keyboard
+	PongRecorder recorder;
+	PongReplay replay;
+	int replayTick = 0;
+	int replayCheck = 0;			// the recording's next checkpoint
+	int replaySums = 0;				// the recording's per-tick checksums are this build's, still being compared
+	int checkEvery = PONG_REPLAY_CHECK_EVERY; // ticks between checkpoints in --record, 0 for none
+
+	// rally records
+	const char* ralliesFile = NULL;	// every rally's record is written here
+	PongRallyWriter rallies;
+	PongRallyTracker rallyTracker;
+	Uint32 games = 0;				// started so far
+
+	// online play
+	static PongRollback online;		// big: every saved frame
+	int hostPort = 0;				// --host: wait for a player on this port
+	char joinHost[256] = "";		// --join: play against whoever hosts there
+	int joinPort = 0;
+	int onlineRWG = 0;
+	int isOnline = 0;
+	int desyncs = 0;				// checksum failures already reported
+	PongNetFaults faults = { 0, 0, 0 };
+
+	// window, the playfield is scaled to fit it
+	int windowWidth = 0;			// 0 = the playfield's own size
+	int windowHeight = 0;
+	int fullscreen = 0;				// desktop resolution, no mode change
 
 	// flags
 	int done = 0;                   // set this to a non-zero value to exit the main loop
-	int ballInPlay = 0;				// set this to a non-zero value when ball has been served, revert when a point is scored
-	int gameOn = 0;					// set this to a non-zero value when a game has started, revert when a player wins
-	int RWGMode = 0;				// set this to a non-zero value to play Red, White, Green mode
-	int multiplayer = 0;			// set this to a non-zero value to play against another human player
 
 	// toggles: -1 = OFF; 1 = ON
 	int scanlines = 1;				// invert to show/hide scanlines
+	int timings = -1;				// invert to show/hide the frame timing overlay
 
 	// key locks: prevents firing per frame
 	int helpLock = 0;
 	int scanlinesLock = 0;
-	int p1AColorSwitchLock = 0;
-	int p1DColorSwitchLock = 0;
-	int p2LColorSwitchLock = 0;
-	int p2RColorSwitchLock = 0;
+	int timingsLock = 0;
 
-	int p1Score = 0;
-	int p2Score = 0;
-	int winScore = 11;
+	// frame timing
+	PongTiming gameTiming;			// events, keys and update, handed on with each snapshot
+	const char* timingFile = NULL;	// every frame's timings are written here on exit
 
-	char title[6];
-	sprintf(title, "%d-%d", p1Score, p2Score);
+	char title[24]; // "%d-%d", room for any two ints
+	SDL_snprintf(title, sizeof(title), "%d-%d", 0, 0);
 	
 
-	/* Score Display Digit Pieces
-
-		    _0_ 
-		  1|   |2
-		   |_3_|  
-		  4|   |5
-		   |_6_| 
-	*/
-
-	int scoreDisplay[10][7] = {
-		//0  1  2  3  4  5  6	<- Pieces
-		{ 1, 1, 1, 0, 1, 1, 1 }, // 0
-		{ 0, 0, 1, 0, 0, 1, 0 }, // 1
-		{ 1, 0, 1, 1, 1, 0, 1 }, // 2
-		{ 1, 0, 1, 1, 0, 1, 1 }, // 3
-		{ 0, 1, 1, 1, 0, 1, 0 }, // 4
-		{ 1, 1, 0, 1, 0, 1, 1 }, // 5
-		{ 1, 1, 0, 1, 1, 1, 1 }, // 6
-		{ 1, 0, 1, 0, 0, 1, 0 }, // 7
-		{ 1, 1, 1, 1, 1, 1, 1 }, // 8
-		{ 1, 1, 1, 1, 0, 1, 1 }  // 9
-	};							 // ^ Digits
-
-	SDL_Color *p1Color;
-	SDL_Color *p2Color;
-	SDL_Color *ballColor;
-
-	int p1ColorSetting = 0;
-	int p2ColorSetting = 0;
-	int ballColorSetting = 0;
-
-	SDL_Color white;	// color 0
-	SDL_Color red;		// color 1
-	SDL_Color green;	// color 2
-
-	int scrWidth = 640;
-	int scrHeight = 480;
-
-	int paddleSpeed = 7;
-
-	int ballSpeedX = 0;
-	int ballSpeedY = 0;
-	
-	int ballDirX = 1;
+	//
+	// command line: PONG [--tick-rate N] [--novsync] [--log-level LEVEL] [--log-file PATH] [--seed N]
+	//                   [--record FILE [--check-every N]] [--replay FILE] [--timing-file FILE.csv|FILE.json]
+	//                   [--host PORT [--rwg] | --join HOST:PORT] [--net-latency MS] [--net-jitter MS] [--net-loss PCT]
+	//                   [--size WxH] [--fullscreen] [--profile FILE] [--low-latency] [--rallies FILE]
+	//
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc)
+		{
+			tickRate = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--novsync") == 0)
+		{
+			vsync = 0;
+		}
+		else if (strcmp(argv[i], "--low-latency") == 0)
+		{
+			lowLatency = 1;
+		}
+		else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc && pong_log_parse_level(argv[i + 1]) >= 0)
+		{
+			pong_log_level = pong_log_parse_level(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--log-file") == 0 && i + 1 < argc)
+		{
+			logFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+		{
+			seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+		{
+			recordFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "--check-every") == 0 && i + 1 < argc)
+		{
+			checkEvery = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--rallies") == 0 && i + 1 < argc)
+		{
+			ralliesFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+		{
+			replayFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "--timing-file") == 0 && i + 1 < argc)
+		{
+			timingFile = argv[++i];
+		}
+		else if (strcmp(argv[i], "--host") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+		{
+			hostPort = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--join") == 0 && i + 1 < argc && strrchr(argv[i + 1], ':') && strlen(argv[i + 1]) < sizeof(joinHost) && atoi(strrchr(argv[i + 1], ':') + 1) > 0)
+		{
+			i++;
+			strncpy(joinHost, argv[i], sizeof(joinHost) - 1);
+			*strrchr(joinHost, ':') = '\0';
+			joinPort = atoi(strrchr(argv[i], ':') + 1);
+		}
+		else if (strcmp(argv[i], "--rwg") == 0)
+		{
+			onlineRWG = 1;
+		}
+		else if (strcmp(argv[i], "--net-latency") == 0 && i + 1 < argc)
+		{
+			faults.latencyMs = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--net-jitter") == 0 && i + 1 < argc)
+		{
+			faults.jitterMs = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--net-loss") == 0 && i + 1 < argc)
+		{
+			faults.lossPercent = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc
+			&& sscanf(argv[i + 1], "%dx%d", &windowWidth, &windowHeight) == 2 && windowWidth > 0 && windowHeight > 0)
+		{
+			i++;
+		}
+		else if (strcmp(argv[i], "--fullscreen") == 0)
+		{
+			fullscreen = 1;
+		}
+		else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+		{
+			profileFile = argv[++i];
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s [--tick-rate N] [--novsync] [--log-level debug|info|warn|error|off] [--log-file PATH] [--seed N] [--record FILE [--check-every N]] [--replay FILE] [--timing-file FILE.csv|FILE.json] [--host PORT [--rwg] | --join HOST:PORT] [--net-latency MS] [--net-jitter MS] [--net-loss PCT] [--size WxH] [--fullscreen] [--profile FILE] [--low-latency] [--rallies FILE]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	isOnline = hostPort > 0 || joinHost[0] != '\0';
+	if (isOnline && (recordFile || replayFile || ralliesFile || (hostPort > 0 && joinHost[0])))
+	{
+		fprintf(stderr, "*** --host and --join can't be combined with each other, --record, --replay or --rallies\n");
+		return 1;
+	}
+
+	//
+	// initialize the match: paddles and ball start centred, game waits at the menu
+	//
+	pong_config_default(&config);
+	if (profileFile)
+	{
+		int badLine;
 
-	int ballSpeedCapX = 6;
-	int ballSpeedCapY = 10;
+		if (pong_profile_load(&config, profileFile, &badLine) != 0)
+		{
+			if (badLine > 0)
+			{
+				fprintf(stderr, "*** %s:%d: not a setting this game knows, or out of range\n", profileFile, badLine);
+			}
+			else if (badLine < 0)
+			{
+				fprintf(stderr, "*** %s: the paddles or the ball don't fit on the screen\n", profileFile);
+			}
+			else
+			{
+				fprintf(stderr, "*** Failed to read profile %s\n", profileFile);
+			}
+			return 1;
+		}
+	}
+	matchSeed = seed;
+	if (replayFile)
+	{
+		// a replay brings its own settings, seed and speed
+		if (pong_replay_load(&replay, replayFile) != 0)
+		{
+			fprintf(stderr, "*** Failed to read recording %s\n", replayFile);
+			return 1;
+		}
+		config = replay.config;
+		matchSeed = replay.seed;
+		matchStream = replay.stream;
+		if (replay.tickRate > 0)
+		{
+			tickRate = replay.tickRate;
+		}
+	}
+	if (tickRate <= 0)
+	{
+		fprintf(stderr, "*** Tick rate must be positive\n");
+		return 1;
+	}
+	tickTime = 1.0 / tickRate;
+	if (!replayFile)
+	{
+		config.tickRate = tickRate; // same speeds in pixels per second at any tick rate
+	}
 
-	int aiMovement = 0;		// 0 = stationary; 1 = down; -1 = up
+	pong_sim_init(&match, &config);
+	pong_sim_seed(&match, matchSeed, matchStream);
+	prevMatch = match;
 
-	int ballHits = 0;	
-	int hitsPerSpeedUp = 1; // Every X hits, increase ballSpeedX
-	int lastPoint = 0;	// set to 1 when P1 scores, and 2 when P2 scores. Determines serve direction
+	recorder.file = NULL;
+	if (recordFile && pong_recorder_open(&recorder, recordFile, &config, matchSeed, matchStream, tickRate, checkEvery) != 0)
+	{
+		fprintf(stderr, "*** Failed to create recording %s\n", recordFile);
+		return 1;
+	}
+	pong_rally_track_reset(&rallyTracker);
+	rallies.file = NULL;
+	if (ralliesFile && pong_rally_writer_open(&rallies, ralliesFile) != 0)
+	{
+		fprintf(stderr, "*** Failed to create rally file %s\n", ralliesFile);
+		return 1;
+	}
 
 	//
 	// initialize SDL
@@ -116,101 +601,209 @@ int main(int argc, char** argv)
 	}
 
 	//
-	// create a window
+	// online: the host's settings are used by both sides, so connect before the window is made
+	//
+	if (isOnline)
+	{
+		int result = joinHost[0]
+			? pong_rollback_join(&online, joinHost, joinPort, &faults)
+			: pong_rollback_host(&online, hostPort, &faults, &config, onlineRWG, matchSeed);
+		Uint32 start = SDL_GetTicks();
+
+		if (result != 0)
+		{
+			fprintf(stderr, "*** Failed to %s\n", joinHost[0] ? "find the host" : "open the port");
+			SDL_Quit();
+			return 1;
+		}
+
+		if (joinHost[0])
+		{
+			printf("Joining %s:%d...\n", joinHost, joinPort);
+		}
+		else
+		{
+			printf("Waiting for a player to join on port %d...\n", hostPort);
+		}
+		while (!pong_rollback_connect(&online))
+		{
+			if (joinHost[0] && SDL_GetTicks() - start >= JOIN_TIMEOUT)
+			{
+				fprintf(stderr, "*** No answer from %s:%d\n", joinHost, joinPort);
+				pong_rollback_close(&online);
+				SDL_Quit();
+				return 1;
+			}
+			SDL_Delay(1);
+		}
+
+		match = online.match;
+		prevMatch = match;
+		config = match.config;
+		tickRate = config.tickRate;
+		tickTime = 1.0 / tickRate;
+	}
+
+	//
+	// create a window. The playfield is scaled to any size, but the window
+	// isn't resizable: SDL resizes a renderer from the thread that polls
+	// events, and ours belongs to the render thread
 	//
 	window = SDL_CreateWindow(title,
 		SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-		scrWidth, scrHeight,
-		SDL_WINDOW_SHOWN); // Removed resizable window: "SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE"
+		windowWidth > 0 ? windowWidth : config.scrWidth, windowHeight > 0 ? windowHeight : config.scrHeight,
+		SDL_WINDOW_SHOWN | SDL_WINDOW_ALLOW_HIGHDPI | (fullscreen ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0));
 	if (!window) {
 		fprintf(stderr, "*** Failed to create window: %s\n", SDL_GetError());
 		return 1;
 	}
 
+	// the window's first size events, before there is a renderer to hear them
+	SDL_PumpEvents();
+
+	// every key event from here on is stamped, for the input to present times
+	SDL_AddEventWatch(stamp_keys, &keyStamp);
+
 	//
 	// get a pointer to keyboard state managed by SDL
 	//
 	keys = SDL_GetKeyboardState(NULL);
 
 	//
-	// create a renderer that takes care of drawing stuff to the window
+	// start the render thread, it makes the renderer that takes care of drawing stuff to the window
 	//
-	renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
-	if (!renderer) {
-		fprintf(stderr, "*** Failed to create renderer: %s\n", SDL_GetError());
+	SDL_memset(&first, 0, sizeof(first));
+	first.prev = match;
+	first.cur = match;
+	first.curTime = SDL_GetPerformanceCounter();
+	first.scanlines = scanlines;
+	first.timings = timings;
+	rt.window = window;
+	rt.vsync = vsync;
+	rt.lowLatency = lowLatency;
+	pong_latency_init(&rt.latency);
+	rt.tickTime = tickTime;
+	pong_snapshot_init(&rt.snapshots, &first);
+	pong_timing_init(&rt.timing, timingFile != NULL);
+	SDL_AtomicSet(&rt.running, 1);
+	SDL_AtomicSet(&rt.ready, 0);
+	rt.wake = SDL_CreateSemaphore(0);
+
+	renderThread = SDL_CreateThread(render_thread, "pong_render", &rt);
+	while (renderThread && SDL_AtomicGet(&rt.ready) == 0)
+	{
+		SDL_Delay(1);
+	}
+	if (!renderThread || SDL_AtomicGet(&rt.ready) < 0)
+	{
+		if (!renderThread)
+		{
+			fprintf(stderr, "*** Failed to start the render thread: %s\n", SDL_GetError());
+		}
+		SDL_WaitThread(renderThread, NULL);
+		SDL_DestroySemaphore(rt.wake);
 		SDL_DestroyWindow(window);
+		SDL_Quit();
 		return 1;
 	}
 
 	//
-	// initialize colors
+	// start writing messages from a background thread, so the console never holds up a frame
 	//
-	white.r = 255;
-	white.g = 255;
-	white.b = 255;
-
-	red.r = 255;
-	red.g = 0;
-	red.b = 0;
-
-	green.r = 0;
-	green.g = 255;
-	green.b = 0;
+	if (pong_log_start(logFile) < 0)
+	{
+		fprintf(stderr, "*** Failed to open log file %s\n", logFile);
+		SDL_AtomicSet(&rt.running, 0);
+		SDL_SemPost(rt.wake);
+		SDL_WaitThread(renderThread, NULL);
+		SDL_DestroySemaphore(rt.wake);
+		SDL_Quit();
+		return 1;
+	}
+	if (rt.frameTime > 0.0)
+	{
+		PONG_LOG(PONG_LOG_WARN, "No vsync, presenting at most %d frames per second\n", (int)(1.0 / rt.frameTime + 0.5));
+	}
 
 	//
-	// initialize the sprite rectangles
+	// enter the main loop where we process events and update the world, once per tick.
+	// Everything is drawn on the render thread from the snapshots this loop publishes
 	//
 
-	const int PADDLE_W = 8;
-	const int PADDLE_H = 64;
-
-	// player 1 paddle
-	p1.w = PADDLE_W;
-	p1.h = PADDLE_H;
-	p1.x = p1.w; // paddle is away from the wall
-	p1.y = (scrHeight - p1.h)/2;
+	if (replayFile)
+	{
+		int32_t state[PONG_SIM_STATE_FIELDS];
+		int32_t recorded[PONG_SIM_STATE_FIELDS];
+		int sumMatched = !replay.sums || pong_sim_checksum(&match) == pong_replay_sum(&replay, 0);
 
-	// player 2 paddle
-	p2.w = PADDLE_W;
-	p2.h = PADDLE_H;
-	p2.x = scrWidth - (p2.w * 2); // paddle is away from the wall
-	p2.y = (scrHeight - p2.h) / 2;
-
-	// ball
-	ball.w = 8;
-	ball.h = 8;
-	ball.x = (scrWidth - ball.w) / 2;
-	ball.y = (scrHeight - ball.h) / 2;
-
-	//
-	// enter the main loop where we process events, update the world, and draw everything
-	//
+		PONG_LOG(PONG_LOG_INFO, "Replaying %d ticks, ESC to quit\n", replay.tickCount);
+		pong_sim_state(&match, state);
+		if (replay.start)
+		{
+			pong_replay_start_state(&replay, recorded);
+		}
 
-	printf("Press F1 for controls.\n[1] Classic vs. AI\n[2] Classic vs. Human\n[3] RWG Mode vs. AI\n[4] RWG Mode vs. Human\n\n");
+		// drift at tick 0: the seeded match already isn't the recording's
+		if (replay.start && memcmp(recorded, state, sizeof(state)) != 0)
+		{
+			print_state("Replay differs from the recording before the first tick. Recorded:", recorded, state);
+			print_state("Played:", state, recorded);
+			replayCheck = replay.checkCount; // once is enough
+		}
+		else if (!sumMatched && replay.start)
+		{
+			fprintf(stderr, "*** Replay checksums were recorded by a build that hashes differently, only comparing checkpoints\n");
+		}
+		else if (!sumMatched)
+		{
+			print_state("Replay differs from the recording before the first tick. Played:", state, NULL);
+			replayCheck = replay.checkCount;
+		}
+		else
+		{
+			replaySums = replay.sums != NULL;
+		}
+	}
+	else if (isOnline)
+	{
+		PONG_LOG(PONG_LOG_INFO, "Online as Player %d. W/S or UP/DOWN move your paddle, SPACE serves and starts the next game, ESC quits\n", online.player);
+	}
+	else
+	{
+		PONG_LOG(PONG_LOG_INFO, "Seed: %u\n", seed);
+	}
+	if (!isOnline)
+	{
+		PONG_LOG(PONG_LOG_INFO, MENU_TEXT);
+	}
+	pong_timing_init(&gameTiming, 0);
+	lastTime = SDL_GetPerformanceCounter();
 	while (!done) {
 		//
 		// handle events
 		//
 		SDL_Event e;    // structure that receives event information from SDL
+		PongInput input = 0; // held keys this pass
+		Uint64 now;
+		PongSnapshot* snap;
+		double wait;    // seconds until the next tick is due
+
+		pong_timing_begin(&gameTiming);
 
 		while (SDL_PollEvent(&e)) {
 
 			switch (e.type) {
 			case SDL_QUIT:
-				printf("User closed the window");
+				PONG_LOG(PONG_LOG_INFO, "User closed the window");
 				done = 1;
 				break;
 
 			case SDL_KEYDOWN:
 				switch (e.key.keysym.sym) {
 				case SDLK_ESCAPE:
-					if (gameOn == 1)
+					if (match.gameOn == 1 && !replayFile && !isOnline)
 					{
-						gameOn = 0;
-						ballInPlay = 0;
-						sprintf(title, "%d-%d", 0, 0);
-						SDL_SetWindowTitle(window, title);
-						printf("Press F1 for controls.\n[1] Classic vs. AI\n[2] Classic vs. Human\n[3] RWG Mode vs. AI\n[4] RWG Mode vs. Human\n\n");
+						commands |= PONG_INPUT_MENU;
 					}
 					else
 					{
@@ -218,173 +811,34 @@ int main(int argc, char** argv)
 					}
 					break;
 				case SDLK_1:
-					if (gameOn == 0)
-					{
-						multiplayer = 0;
-						gameOn = 1;
-						RWGMode = 0;
-
-						// reset score
-						p1Score = 0;
-						p2Score = 0;
-
-						sprintf(title, "%d-%d", p1Score, p2Score);
-						SDL_SetWindowTitle(window, title);
-
-						// reset paddle positions
-						p1.x = p1.w; // paddle is away from the wall
-						p1.y = (scrHeight - p1.h) / 2;
-
-						p2.x = scrWidth - (p2.w * 2); // paddle is away from the wall
-						p2.y = (scrHeight - p2.h) / 2;
-
-						// reset ball
-						ball.x = (scrWidth - ball.w) / 2;
-						ball.y = (scrHeight - ball.h) / 2;
-						ballSpeedX = 0;
-						ballSpeedY = 0;
-
-						// reset colors
-						p1ColorSetting = 0;
-						p2ColorSetting = 0;
-						ballColorSetting = 0;
-					}
+					commands |= PONG_INPUT_MODE_1;
 					break;
 				case SDLK_2:
-					if (gameOn == 0)
-					{
-						multiplayer = 1;
-						gameOn = 1;
-						RWGMode = 0;
-
-						// reset score
-						p1Score = 0;
-						p2Score = 0;
-
-						sprintf(title, "%d-%d", p1Score, p2Score);
-						SDL_SetWindowTitle(window, title);
-
-						// reset paddle positions
-						p1.x = p1.w; // paddle is away from the wall
-						p1.y = (scrHeight - p1.h) / 2;
-
-						p2.x = scrWidth - (p2.w * 2); // paddle is away from the wall
-						p2.y = (scrHeight - p2.h) / 2;
-
-						// reset ball
-						ball.x = (scrWidth - ball.w) / 2;
-						ball.y = (scrHeight - ball.h) / 2;
-						ballSpeedX = 0;
-						ballSpeedY = 0;
-
-						// reset colors
-						p1ColorSetting = 0;
-						p2ColorSetting = 0;
-						ballColorSetting = 0;
-					}
+					commands |= PONG_INPUT_MODE_2;
 					break;
 				case SDLK_3:
-					if (gameOn == 0)
-					{
-						multiplayer = 0;
-						gameOn = 1;
-						RWGMode = 1;
-
-						// reset score
-						p1Score = 0;
-						p2Score = 0;
-
-						sprintf(title, "%d-%d", p1Score, p2Score);
-						SDL_SetWindowTitle(window, title);
-
-						// reset paddle positions
-						p1.x = p1.w; // paddle is away from the wall
-						p1.y = (scrHeight - p1.h) / 2;
-
-						p2.x = scrWidth - (p2.w * 2); // paddle is away from the wall
-						p2.y = (scrHeight - p2.h) / 2;
-
-						// reset ball
-						ball.x = (scrWidth - ball.w) / 2;
-						ball.y = (scrHeight - ball.h) / 2;
-						ballSpeedX = 0;
-						ballSpeedY = 0;
-
-						// reset colors
-						p1ColorSetting = 0;
-						p2ColorSetting = 0;
-						ballColorSetting = 0;
-					}
+					commands |= PONG_INPUT_MODE_3;
 					break;
 				case SDLK_4:
-					if (gameOn == 0)
-					{
-						multiplayer = 1;
-						gameOn = 1;
-						RWGMode = 1;
-
-						// reset score
-						p1Score = 0;
-						p2Score = 0;
-
-						sprintf(title, "%d-%d", p1Score, p2Score);
-						SDL_SetWindowTitle(window, title);
-
-						// reset paddle positions
-						p1.x = p1.w; // paddle is away from the wall
-						p1.y = (scrHeight - p1.h) / 2;
-
-						p2.x = scrWidth - (p2.w * 2); // paddle is away from the wall
-						p2.y = (scrHeight - p2.h) / 2;
-
-						// reset ball
-						ball.x = (scrWidth - ball.w) / 2;
-						ball.y = (scrHeight - ball.h) / 2;
-						ballSpeedX = 0;
-						ballSpeedY = 0;
-
-						// reset colors
-						p1ColorSetting = 0;
-						p2ColorSetting = 0;
-						ballColorSetting = 0;
-					}
+					commands |= PONG_INPUT_MODE_4;
 					break;
 				case SDLK_SPACE:
-					if (ballInPlay == 0 && gameOn == 1)
-					{
-						ballInPlay = 1;
-
-						// randomize initial speed and direction
-						ballSpeedX = 2;
-						ballSpeedY = rand() % 3;
-
-						if (rand() % 2 == 0) // 50/50 to start moving up/down
-						{
-							ballSpeedY *= -1;
-						}
-
-						if (lastPoint == 0) // new game
-						{
-							if (rand() % 2 == 0) // 50/50 to move toward P1
-							{
-								ballDirX = -1;
-							}
-						}
-						else if (lastPoint == 1) // if P1 scored last, move towards P2
-						{
-							ballDirX = 1;
-						}
-						else if (lastPoint == 2) // if P2 scored last, move towards P1
-						{
-							ballDirX = -1;
-						}
+					commands |= PONG_INPUT_SERVE;
+					break;
+				}
+				break;
 
-					}
+			case SDL_WINDOWEVENT:
+				switch (e.window.event) {
+				case SDL_WINDOWEVENT_EXPOSED:
+				case SDL_WINDOWEVENT_SIZE_CHANGED:
+					exposures++;
 					break;
 				}
 				break;
 			}
 		}
+		pong_timing_mark(&gameTiming, PONG_PHASE_EVENTS);
 
 		//
 		// function controls
@@ -394,7 +848,7 @@ int main(int argc, char** argv)
 		if (keys[SDL_SCANCODE_F1] && helpLock == 0)
 		{
 			helpLock = 1;
-			printf("CONTROLS:\nPlayer 1 uses W/S to move Up/Down\nPlayer 2 uses UP/DOWN arrows to move Up/Down\nSPACE = Serve Ball\nESC = Back to Main Menu / Quit\n\nRWG Additional Controls:\nPlayer 1 uses A/D to switch colours.\nPlayer 2 uses LEFT/RIGHT arrows to switch colours.\nYour paddle must match the ball's colour to hit it.\n\nF1 = Show Controls (This screen)\nF2 = Toggle Scanlines\n\n");
+			PONG_LOG(PONG_LOG_INFO, "CONTROLS:\nPlayer 1 uses W/S to move Up/Down\nPlayer 2 uses UP/DOWN arrows to move Up/Down\nSPACE = Serve Ball\nESC = Back to Main Menu / Quit\n\nRWG Additional Controls:\nPlayer 1 uses A/D to switch colours.\nPlayer 2 uses LEFT/RIGHT arrows to switch colours.\nYour paddle must match the ball's colour to hit it.\n\nF1 = Show Controls (This screen)\nF2 = Toggle Scanlines\nF3 = Toggle Frame Timings\n\n");
 		}
 		else if (!keys[SDL_SCANCODE_F1] && helpLock == 1)
 		{
@@ -410,733 +864,271 @@ int main(int argc, char** argv)
 		else if (!keys[SDL_SCANCODE_F2] && scanlinesLock == 1)
 		{
 			scanlinesLock = 0;
-		}		
+		}
 
-		if (gameOn == 1)
+		// frame timings
+		if (keys[SDL_SCANCODE_F3] && timingsLock == 0)
 		{
-			//
-			// update paddle position based on current keyboard state
-			//
-
-			// player 1 controls
-			if (keys[SDL_SCANCODE_W])
-			{
-				p1.y -= paddleSpeed;
-			}
-			if (keys[SDL_SCANCODE_S])
-			{
-				p1.y += paddleSpeed;
-			}
-
-			// player 2 controls
-			if (multiplayer == 1)
-			{
-				if (keys[SDL_SCANCODE_UP])
-				{
-					p2.y -= paddleSpeed;
-				}
-				if (keys[SDL_SCANCODE_DOWN])
-				{
-					p2.y += paddleSpeed;
-				}
-			}
-			else // AI controls
-			{
-				int aiDetectRange = 3; // min of 2, larger numbers make ai detect ball farther away
+			timingsLock = 1;
+			timings *= -1;
+		}
+		else if (!keys[SDL_SCANCODE_F3] && timingsLock == 1)
+		{
+			timingsLock = 0;
+		}		
 
-				if (ballCenter.x > scrWidth / aiDetectRange && ballDirX == 1) // if ball on AI side and headed towards AI
-				{
-					if (ballCenter.y > p2Center.y + paddleSpeed) // move down to ball
-					{
-						p2.y += paddleSpeed;
-						aiMovement = 1;
-					}
-					else if (ballCenter.y < p2Center.y - paddleSpeed) // move up to ball
-					{
-						p2.y -= paddleSpeed;
-						aiMovement = -1;
-					}
-				}
-				else
-				{
-					aiMovement = 0;
-				}
+		//
+		// read the current keyboard state
+		//
+		if (keys[SDL_SCANCODE_W])
+		{
+			input |= PONG_INPUT_P1_UP;
+		}
+		if (keys[SDL_SCANCODE_S])
+		{
+			input |= PONG_INPUT_P1_DOWN;
+		}
+		if (keys[SDL_SCANCODE_A])
+		{
+			input |= PONG_INPUT_P1_LEFT;
+		}
+		if (keys[SDL_SCANCODE_D])
+		{
+			input |= PONG_INPUT_P1_RIGHT;
+		}
+		if (keys[SDL_SCANCODE_UP])
+		{
+			input |= PONG_INPUT_P2_UP;
+		}
+		if (keys[SDL_SCANCODE_DOWN])
+		{
+			input |= PONG_INPUT_P2_DOWN;
+		}
+		if (keys[SDL_SCANCODE_LEFT])
+		{
+			input |= PONG_INPUT_P2_LEFT;
+		}
+		if (keys[SDL_SCANCODE_RIGHT])
+		{
+			input |= PONG_INPUT_P2_RIGHT;
+		}
+		pong_timing_mark(&gameTiming, PONG_PHASE_KEYS);
+
+		//
+		// update the world in fixed steps, however long the last pass took
+		//
+		now = SDL_GetPerformanceCounter();
+		accumulator += (double)(now - lastTime) / SDL_GetPerformanceFrequency();
+		lastTime = now;
+		if (accumulator > MAX_FRAME_TIME)
+		{
+			accumulator = MAX_FRAME_TIME;
+		}
+
+		while (accumulator >= tickTime && (!replayFile || replayTick < replay.tickCount))
+		{
+			PongInput tickInput = input | commands;
+			unsigned int events;
+
+			// this tick plays the keys pumped so far
+			if (keyStamp)
+			{
+				inputTime = keyStamp;
+				keyStamp = 0;
 			}
 
-			// RWG Controls
-			if (RWGMode == 1)
+			if (isOnline)
 			{
-				// player 1
-				if (keys[SDL_SCANCODE_A] && p1AColorSwitchLock == 0)
-				{
-					p1AColorSwitchLock = 1;
-					p1ColorSetting--;
-					if (p1ColorSetting < 0)
-					{
-						p1ColorSetting = 2;
-					}
-				}
-				else if (!keys[SDL_SCANCODE_A] && p1AColorSwitchLock == 1)
+				int result = pong_rollback_tick(&online, tickInput, &events);
+
+				// a stalled or waiting tick keeps the picture still, and its serve for the next one
+				prevMatch = match;
+				match = online.match;
+				report_events(window, &match, events);
+				if (result == PONG_ROLLBACK_GONE)
 				{
-					p1AColorSwitchLock = 0;
+					PONG_LOG(PONG_LOG_WARN, "Lost the other player\n");
+					done = 1;
 				}
-				if (keys[SDL_SCANCODE_D] && p1DColorSwitchLock == 0)
+				if (online.stats.checksFailed > desyncs)
 				{
-					p1DColorSwitchLock = 1;
-					p1ColorSetting++;
-					if (p1ColorSetting > 2)
+					// the first time, what this side had: the other side logs its own
+					if (desyncs == 0)
 					{
-						p1ColorSetting = 0;
-					}
-				}
-				else if (!keys[SDL_SCANCODE_D] && p1DColorSwitchLock == 1)
-				{
-					p1DColorSwitchLock = 0;
-				}
+						char title[96];
 
-				// player 2
-				if (multiplayer == 1)
-				{
-					if (keys[SDL_SCANCODE_LEFT] && p2LColorSwitchLock == 0)
-					{
-						p2LColorSwitchLock = 1;
-						p2ColorSetting--;
-						if (p2ColorSetting < 0)
-						{
-							p2ColorSetting = 2;
-						}
-					}
-					else if (!keys[SDL_SCANCODE_LEFT] && p2LColorSwitchLock == 1)
-					{
-						p2LColorSwitchLock = 0;
-					}
-					if (keys[SDL_SCANCODE_RIGHT] && p2RColorSwitchLock == 0)
-					{
-						p2RColorSwitchLock = 1;
-						p2ColorSetting++;
-						if (p2ColorSetting > 2)
-						{
-							p2ColorSetting = 0;
-						}
-					}
-					else if (!keys[SDL_SCANCODE_RIGHT] && p2RColorSwitchLock == 1)
-					{
-						p2RColorSwitchLock = 0;
+						sprintf(title, "Out of sync with the other player after frame %d, this side had:", online.desyncFrame);
+						print_state(title, online.desyncState, NULL);
 					}
-				}
-				else // AI RWG Controls
-				{
-					if (ballDirX > 0 && ballCenter.x > scrWidth / 2)
+					else
 					{
-						p2ColorSetting = ballColorSetting; // always match ball color
+						PONG_LOG(PONG_LOG_WARN, "Out of sync with the other player\n");
 					}
+					desyncs = online.stats.checksFailed;
 				}
+				commands = 0;
+				accumulator -= tickTime;
+				continue;
 			}
-			
-
-			// ball movement
-			if (ballInPlay != 0)
-			{
-				ball.x += ballSpeedX * ballDirX;
-				ball.y += ballSpeedY;
-			}
-			if (ballHits >= hitsPerSpeedUp)
-			{
-				ballHits = 0;
-				if (ballSpeedX < ballSpeedCapX)
-				{
-					ballSpeedX++;
-				}
-			}
-
-
-			// player 1 boundary collision
-			if (p1.y < 0)
-			{
-				p1.y = 0;
-			}
-			if (p1.y > scrHeight - p1.h)
-			{
-				p1.y = scrHeight - p1.h;
-			}
-
-			// player 2 boundary collision
-			if (p2.y < 0)
+			if (replayFile)
 			{
-				p2.y = 0;
+				tickInput = pong_replay_input(&replay, replayTick++);
 			}
-			if (p2.y > scrHeight - p2.h)
+			if (recorder.file)
 			{
-				p2.y = scrHeight - p2.h;
+				pong_recorder_add(&recorder, tickInput);
 			}
 
-			// ball boundary collision
-			if (ball.y < 0)
+			prevMatch = match;
+			events = pong_sim_step(&match, tickInput);
+			report_events(window, &match, events);
+			record_rally(&rallies, &rallyTracker, &match, events, &games);
+			if (recorder.file)
 			{
-				printf("COLLISION: Top Wall\n");
-				ball.y = 0;
-				ballSpeedY *= -1;
-				/* TOO HARD
-				if (RWGMode == 1)
-				{
-					ballColorSetting = rand() % 3;
-				}
-				*/
+				pong_recorder_state(&recorder, &match);
 			}
-			if (ball.y > scrHeight - ball.h)
-			{
-				printf("COLLISION: Bottom Wall\n");
-				ball.y = scrHeight - ball.h;
-				ballSpeedY *= -1;
-				/* TOO HARD
-				if (RWGMode == 1)
-				{
-					ballColorSetting = rand() % 3;
-				}
-				*/
-			}
-
-			// calculate center of rectangles
-
-			p1Center.x = p1.x + (p1.w / 2);
-			p1Center.y = p1.y + (p1.h / 2);
-
-			p2Center.x = p2.x + (p2.w / 2);
-			p2Center.y = p2.y + (p2.h / 2);
 
-			ballCenter.x = ball.x + (ball.w / 2);
-			ballCenter.y = ball.y + (ball.h / 2);
-
-			//
-			// ball and paddle collision
-			//
-
-			SDL_bool p1Collision = SDL_HasIntersection(&ball, &p1);
-			SDL_bool p2Collision = SDL_HasIntersection(&ball, &p2);
-
-			// classic physics: https://www.youtube.com/watch?v=SHsYjWm8XSI
-			
-			if (p1Collision && ballDirX == -1 && (p1ColorSetting == ballColorSetting))
+			// the first tick and checkpoint this build doesn't agree with, e.g. after a compiler or platform change
+			if (replaySums && pong_sim_checksum(&match) != pong_replay_sum(&replay, replayTick))
 			{
-				printf("COLLISION: Player 1\n");
-				ballDirX *= -1;
-				ballHits++;
-
-				if (keys[SDL_SCANCODE_W] && ballSpeedY > -ballSpeedCapY) // paddle moving up
-				{
-					ballSpeedY--;
-				}
-				else if (keys[SDL_SCANCODE_S] && ballSpeedY < ballSpeedCapY) // paddle moving down
-				{
-					ballSpeedY++;
-				}
-
-				if (RWGMode == 1)
-				{
-					ballColorSetting = rand() % 3;
-				}
+				fprintf(stderr, "*** Replay first differs from the recording after tick %d\n", replayTick);
+				replaySums = 0;
 			}
-			else if (p2Collision && ballDirX == 1 && (p2ColorSetting == ballColorSetting))
+			if (replayFile && replayCheck < replay.checkCount && replayTick == (replayCheck + 1) * replay.checkEvery)
 			{
-				printf("COLLISION: Player 2\n");
-				ballDirX *= -1;
-				ballHits++;
-
-				if ((keys[SDL_SCANCODE_UP] && ballSpeedY > -ballSpeedCapY) || (multiplayer == 1 && aiMovement == -1))
-				{
-					ballSpeedY--;
-				}
-				else if ((keys[SDL_SCANCODE_DOWN] && ballSpeedY < ballSpeedCapY) || (multiplayer == 1 && aiMovement == 1))
-				{
-					ballSpeedY++;
-				}
-
-				if (RWGMode == 1)
+				int32_t recorded[PONG_SIM_STATE_FIELDS];
+				int32_t state[PONG_SIM_STATE_FIELDS];
+				char title[96];
+
+				pong_replay_checkpoint(&replay, replayCheck, recorded);
+				pong_sim_state(&match, state);
+				replayCheck++;
+				if (memcmp(recorded, state, sizeof(state)) != 0)
 				{
-					ballColorSetting = rand() % 3;
+					sprintf(title, "Replay drifted from the recording between ticks %d and %d. Recorded:", replayTick - replay.checkEvery, replayTick);
+					print_state(title, recorded, state);
+					print_state("Played:", state, recorded);
+					replayCheck = replay.checkCount; // once is enough
 				}
 			}
+			commands = 0; // commands only fire on the first tick after the key went down
+			accumulator -= tickTime;
 
-			/*
-			//FANCY PHYSICS
-
-			if (p1Collision || p2Collision) // collision with either paddle
-			{
-				printf("COLLISION: ");
-
-				// collision math: http://gamedev.stackexchange.com/questions/24078/which-side-was-hit/24091#24091
-
-				// player 1 collision
-				if (p1Collision)
-				{
-					int wy = (ball.w + p1.w) * (ballCenter.y - p1Center.y);
-					int hx = (ball.h + p1.h) * (ballCenter.x - p1Center.x);
-
-					if (wy > hx)
-					{
-						if (wy > -hx)
-						{
-							printf("Player 1 - BOTTOM\n");
-
-							ball.y = p1.y + p1.h;
-							ballSpeedY *= -1;
-						}
-						else
-						{
-							printf("Player 1 - LEFT\n");
-
-							ball.x = p1.x - ball.w;
-							ballSpeedX *= -1;
-						}
-					}
-					else
-					{
-						if (wy > -hx)
-						{
-							printf("Player 1 - RIGHT\n");
-
-							ball.x = p1.x + p1.w;
-							ballSpeedX *= -1;
-						}
-						else
-						{
-							printf("Player 1 - TOP\n");
-
-							ball.y = p1.y - ball.h;
-							ballSpeedY *= -1;
-						}
-					}
-					//printf("wy: %d\nhx: %d\n", wy, hx);
-				}
-
-				// player 2 collision
-				if (p2Collision)
-				{
-					double wy = (double)(ball.w + p2.w) * (ballCenter.y - p2Center.y);
-					double hx = (double)(ball.h + p2.h) * (ballCenter.x - p2Center.x);
-
-					if (wy > hx)
-					{
-						if (wy > -hx)
-						{
-							printf("Player 2 - BOTTOM\n");
-							ball.y = p2.y + p2.h;
-							ballSpeedY *= -1;
-						}
-						else
-						{
-							printf("Player 2 - LEFT\n");
-
-							ball.x = p2.x - ball.w;
-							ballSpeedX *= -1;
-						}
-					}
-					else
-					{
-						if (wy > -hx)
-						{
-							printf("Player 2 - RIGHT\n");
-
-							ball.x = p2.x + p2.w;
-							ballSpeedX *= -1;
-						}
-						else
-						{
-							printf("Player 2 - TOP\n");
-
-							ball.y = p2.y - ball.h;
-							ballSpeedY *= -1;
-						}
-					}
-				}
-				//printf("wy: %d\nhx: %d\n", wy, hx);
-
-			}*/
-
-			// ball out of bounds
-			if (ball.x < 0 - ball.w || ball.x > scrWidth) // score
+			if (replayFile && replayTick == replay.tickCount)
 			{
-				if (ball.x > scrWidth)	// player 1 score
-				{
-					p1Score++;
-					lastPoint = 1;
-				}
-				else					// player 2 score
+				PONG_LOG(PONG_LOG_INFO, "Replay finished at %d-%d, recorded %d-%d\n", match.p1Score, match.p2Score, replay.p1Score, replay.p2Score);
+				if (match.p1Score != replay.p1Score || match.p2Score != replay.p2Score)
 				{
-					p2Score++;
-					lastPoint = 2;
+					PONG_LOG(PONG_LOG_WARN, "Replay did not end on the recorded score\n");
 				}
-
-				// play is paused
-				ballInPlay = 0;
-
-				// reset colours
-				p1ColorSetting = 0;
-				p2ColorSetting = 0;
-				ballColorSetting = 0;
-				
-				// reset ball position
-				ball.x = (scrWidth - ball.w) / 2;
-				ball.y = (scrHeight - ball.h) / 2;
-
-				// stop ball at reset location
-				ballSpeedX = 0;
-				ballSpeedY = 0;
-
-				// change title
-				sprintf(title, "%d-%d", p1Score, p2Score);
-				SDL_SetWindowTitle(window, title);
-
-				// print score
-				printf("SCORE: %d-%d\n", p1Score, p2Score);
-				printf("Last Point: %d\n", lastPoint);
-
-				// win score reached
-				if (p1Score >= winScore || p2Score >= winScore)
-				{
-					gameOn = 0;
-					if (p1Score >= winScore)
-					{
-						printf("Player 1 wins!\n");
-					}
-					else if (multiplayer == 1)
-					{
-						printf("Player 2 wins!\n");
-					}
-					else
-					{
-						printf("AI wins!\n");
-					}
-					printf("Press F1 for controls.\n[1] Classic vs. AI\n[2] Classic vs. Human\n[3] RWG Mode vs. AI\n[4] RWG Mode vs. Human\n\n");
-				}
-			}
-
-
-			// player 1 color
-			switch (p1ColorSetting) {
-			case 0:
-				p1Color = &white;
-				break;
-			case 1:
-				p1Color = &red;
-				break;
-			case 2:
-				p1Color = &green;
-				break;
-			}
-
-			// player 2 color
-			switch (p2ColorSetting) {
-			case 0:
-				p2Color = &white;
-				break;
-			case 1:
-				p2Color = &red;
-				break;
-			case 2:
-				p2Color = &green;
-				break;
-			}
-
-			// ball color
-			switch (ballColorSetting) {
-			case 0:
-				ballColor = &white;
-				break;
-			case 1:
-				ballColor = &red;
-				break;
-			case 2:
-				ballColor = &green;
-				break;
 			}
 		}
-
-		//
-		// draw everything
-		//
-
-		// background
-		SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-		SDL_RenderClear(renderer);
-
-		// half line
-		SDL_SetRenderDrawColor(renderer, 128, 128, 128, 255);
-		SDL_RenderDrawLine(renderer, scrWidth / 2, 0, scrWidth / 2, scrHeight);
-
-		if (gameOn == 1)
+		if (replayFile && replayTick == replay.tickCount)
 		{
-			// p1 paddle
-			SDL_SetRenderDrawColor(renderer, p1Color->r, p1Color->g, p1Color->b, 255);
-			SDL_RenderFillRect(renderer, &p1);
-
-			// p2 paddle
-			SDL_SetRenderDrawColor(renderer, p2Color->r, p2Color->g, p2Color->b, 255);
-			SDL_RenderFillRect(renderer, &p2);
-
-			// ball
-			if (ballInPlay != 0)
-			{
-				SDL_SetRenderDrawColor(renderer, ballColor->r, ballColor->g, ballColor->b, 255);
-				SDL_RenderFillRect(renderer, &ball);
-			}
+			// the recording is over, hold the last tick
+			prevMatch = match;
+			accumulator = 0.0;
 		}
+		pong_timing_mark(&gameTiming, PONG_PHASE_UPDATE);
+
 		//
-		// score
+		// hand the latest two ticks to the render thread, cur was due accumulator seconds ago
 		//
-		SDL_Rect hr; // horizontal number piece, default position
-		hr.w = 16;
-		hr.h = 4;
-
-		SDL_Rect vr; // vertical number piece, default position
-		vr.w = 4;
-		vr.h = 16;
-
-		int scoreDisplayWidth = hr.w + vr.w + hr.w;
-
-		// score display offset from (0,0), or ((scrWidth - scoreDisplayWidth), 0)
-		int scoreDisplayOffsetX = (scrWidth / 4) - (scoreDisplayWidth / 2);
-		int scoreDisplayOffsetY = 4;
-
-		int scoreOnesDigitOffsetX = hr.w + vr.w; // ones digit offset from tens digit
-
-		if (p1Score < winScore)
-		{
-			SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-		}
-		else
+		snap = pong_snapshot_write(&rt.snapshots);
+		snap->prev = prevMatch;
+		snap->cur = match;
+		snap->curTime = now - (Uint64)(accumulator * SDL_GetPerformanceFrequency());
+		snap->scanlines = scanlines;
+		snap->timings = timings;
+		snap->inputTime = inputTime;
+		snap->exposures = exposures;
+		SDL_memcpy(snap->gamePhases, gameTiming.current, sizeof(snap->gamePhases));
+		pong_snapshot_publish(&rt.snapshots);
+		if (SDL_SemValue(rt.wake) == 0)
 		{
-			SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255);
+			SDL_SemPost(rt.wake);
 		}
+		pong_timing_end(&gameTiming);
 
-		// p1 score, ones
-		if (scoreDisplay[p1Score % 10][0] == 1)
-		{			
-			hr.x = 0 + scoreDisplayOffsetX + scoreOnesDigitOffsetX;
-			hr.y = 0 + scoreDisplayOffsetY;
-
-			SDL_RenderFillRect(renderer, &hr);
-		}
-		if (scoreDisplay[p1Score % 10][1] == 1)
-		{
-			vr.x = 0 + scoreDisplayOffsetX + scoreOnesDigitOffsetX;
-			vr.y = 0 + scoreDisplayOffsetY;
-
-			SDL_RenderFillRect(renderer, &vr);
-		}
-		if (scoreDisplay[p1Score % 10][2] == 1)
-		{
-			vr.x = 12 + scoreDisplayOffsetX + scoreOnesDigitOffsetX;
-			vr.y = 0 + scoreDisplayOffsetY;
-
-			SDL_RenderFillRect(renderer, &vr);
-		}
-		if (scoreDisplay[p1Score % 10][3] == 1)
-		{
-			hr.x = 0 + scoreDisplayOffsetX + scoreOnesDigitOffsetX;
-			hr.y = 12 + scoreDisplayOffsetY;
-
-			SDL_RenderFillRect(renderer, &hr);
-		}
-		if (scoreDisplay[p1Score % 10][4] == 1)
-		{
-			vr.x = 0 + scoreDisplayOffsetX + scoreOnesDigitOffsetX;
-			vr.y = 12 + scoreDisplayOffsetY;
-
-			SDL_RenderFillRect(renderer, &vr);
-		}
-		if (scoreDisplay[p1Score % 10][5] == 1)
-		{
-			vr.x = 12 + scoreDisplayOffsetX + scoreOnesDigitOffsetX;
-			vr.y = 12 + scoreDisplayOffsetY;
-
-			SDL_RenderFillRect(renderer, &vr);
-		}
-		if (scoreDisplay[p1Score % 10][6] == 1)
-		{
-			hr.x = 0 + scoreDisplayOffsetX + scoreOnesDigitOffsetX;
-			hr.y = 24 + scoreDisplayOffsetY;
-
-			SDL_RenderFillRect(renderer, &hr);
-		}
-
-		// p1 score, tens
-		if (scoreDisplay[p1Score / 10][0] == 1)
-		{
-			hr.x = 0 + scoreDisplayOffsetX;
-			hr.y = 0 + scoreDisplayOffsetY;
-
-			SDL_RenderFillRect(renderer, &hr);
-		}
-		if (scoreDisplay[p1Score / 10][1] == 1)
-		{
-			vr.x = 0 + scoreDisplayOffsetX;
-			vr.y = 0 + scoreDisplayOffsetY;
-
-			SDL_RenderFillRect(renderer, &vr);
-		}
-		if (scoreDisplay[p1Score / 10][2] == 1)
-		{
-			vr.x = 12 + scoreDisplayOffsetX;
-			vr.y = 0 + scoreDisplayOffsetY;
-
-			SDL_RenderFillRect(renderer, &vr);
-		}
-		if (scoreDisplay[p1Score / 10][3] == 1)
-		{
-			hr.x = 0 + scoreDisplayOffsetX;
-			hr.y = 12 + scoreDisplayOffsetY;
-
-			SDL_RenderFillRect(renderer, &hr);
-		}
-		if (scoreDisplay[p1Score / 10][4] == 1)
-		{
-			vr.x = 0 + scoreDisplayOffsetX;
-			vr.y = 12 + scoreDisplayOffsetY;
+		// the menu does nothing tick to tick, only a key or window event changes it.
+		// Replays and online play keep ticking
+		idle = match.gameOn == 0 && commands == 0 && !replayFile && !isOnline;
 
-			SDL_RenderFillRect(renderer, &vr);
-		}
-		if (scoreDisplay[p1Score / 10][5] == 1)
+		//
+		// sleep until the next tick is due, so the keys are read just before it
+		//
+		if (idle)
 		{
-			vr.x = 12 + scoreDisplayOffsetX;
-			vr.y = 12 + scoreDisplayOffsetY;
+			SDL_WaitEventTimeout(NULL, IDLE_WAIT_MS);
 
-			SDL_RenderFillRect(renderer, &vr);
+			// the ticks slept through were all the same, there is nothing to catch up.
+			// Run one straight away for whatever woke us
+			lastTime = SDL_GetPerformanceCounter();
+			accumulator = tickTime;
 		}
-		if (scoreDisplay[p1Score / 10][6] == 1)
+		else if (lowLatency)
 		{
-			hr.x = 0 + scoreDisplayOffsetX;
-			hr.y = 24 + scoreDisplayOffsetY;
-
-			SDL_RenderFillRect(renderer, &hr);
-		}
+			// SDL_Delay can oversleep by a millisecond or more: wake early, keep
+			// stamping key events as they come, and spin the rest of the way
+			Uint64 due = now + (Uint64)((tickTime - accumulator) * SDL_GetPerformanceFrequency()) + 1;
+			Uint64 spin = (Uint64)(SPIN_MS / 1000.0 * SDL_GetPerformanceFrequency());
 
-		if (p2Score < winScore)
-		{
-			SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+			while (SDL_GetPerformanceCounter() + spin < due)
+			{
+				SDL_Delay(1);
+				SDL_PumpEvents();
+			}
+			while (SDL_GetPerformanceCounter() < due)
+			{
+			}
 		}
 		else
 		{
-			SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255);
-		}
-
-		// p2 score, ones
-		if (scoreDisplay[p2Score % 10][0] == 1)
-		{
-			hr.x = (scrWidth - scoreDisplayWidth) - scoreDisplayOffsetX + scoreOnesDigitOffsetX;
-			hr.y = 0 + scoreDisplayOffsetY;
-
-			SDL_RenderFillRect(renderer, &hr);
-		}
-		if (scoreDisplay[p2Score % 10][1] == 1)
-		{
-			vr.x = (scrWidth - scoreDisplayWidth) - scoreDisplayOffsetX + scoreOnesDigitOffsetX;
-			vr.y = 0 + scoreDisplayOffsetY;
-
-			SDL_RenderFillRect(renderer, &vr);
-		}
-		if (scoreDisplay[p2Score % 10][2] == 1)
-		{
-			vr.x = (scrWidth - scoreDisplayWidth) + 12 - scoreDisplayOffsetX + scoreOnesDigitOffsetX;
-			vr.y = 0 + scoreDisplayOffsetY;
-
-			SDL_RenderFillRect(renderer, &vr);
-		}
-		if (scoreDisplay[p2Score % 10][3] == 1)
-		{
-			hr.x = (scrWidth - scoreDisplayWidth) - scoreDisplayOffsetX + scoreOnesDigitOffsetX;
-			hr.y = 12 + scoreDisplayOffsetY;
-
-			SDL_RenderFillRect(renderer, &hr);
-		}
-		if (scoreDisplay[p2Score % 10][4] == 1)
-		{
-			vr.x = (scrWidth - scoreDisplayWidth) - scoreDisplayOffsetX + scoreOnesDigitOffsetX;
-			vr.y = 12 + scoreDisplayOffsetY;
-
-			SDL_RenderFillRect(renderer, &vr);
-		}
-		if (scoreDisplay[p2Score % 10][5] == 1)
-		{
-			vr.x = (scrWidth - scoreDisplayWidth) + 12 - scoreDisplayOffsetX + scoreOnesDigitOffsetX;
-			vr.y = 12 + scoreDisplayOffsetY;
-
-			SDL_RenderFillRect(renderer, &vr);
-		}
-		if (scoreDisplay[p2Score % 10][6] == 1)
-		{
-			hr.x = (scrWidth - scoreDisplayWidth) - scoreDisplayOffsetX + scoreOnesDigitOffsetX;
-			hr.y = 24 + scoreDisplayOffsetY;
-
-			SDL_RenderFillRect(renderer, &hr);
-		}
-
-		// p2 score, tens
-		if (scoreDisplay[p2Score / 10][0] == 1)
-		{
-			hr.x = (scrWidth - scoreDisplayWidth) - scoreDisplayOffsetX;
-			hr.y = 0 + scoreDisplayOffsetY;
-
-			SDL_RenderFillRect(renderer, &hr);
-		}
-		if (scoreDisplay[p2Score / 10][1] == 1)
-		{
-			vr.x = (scrWidth - scoreDisplayWidth) - scoreDisplayOffsetX;
-			vr.y = 0 + scoreDisplayOffsetY;
-
-			SDL_RenderFillRect(renderer, &vr);
+			wait = tickTime - accumulator - (double)(SDL_GetPerformanceCounter() - now) / SDL_GetPerformanceFrequency();
+			SDL_Delay(wait > 0.0 ? (Uint32)(wait * 1000.0) : 0);
 		}
-		if (scoreDisplay[p2Score / 10][2] == 1)
-		{
-			vr.x = (scrWidth - scoreDisplayWidth) + 12 - scoreDisplayOffsetX;
-			vr.y = 0 + scoreDisplayOffsetY;
-
-			SDL_RenderFillRect(renderer, &vr);
-		}
-		if (scoreDisplay[p2Score / 10][3] == 1)
-		{
-			hr.x = (scrWidth - scoreDisplayWidth) - scoreDisplayOffsetX;
-			hr.y = 12 + scoreDisplayOffsetY;
-
-			SDL_RenderFillRect(renderer, &hr);
-		}
-		if (scoreDisplay[p2Score / 10][4] == 1)
-		{
-			vr.x = (scrWidth - scoreDisplayWidth) - scoreDisplayOffsetX;
-			vr.y = 12 + scoreDisplayOffsetY;
-
-			SDL_RenderFillRect(renderer, &vr);
-		}
-		if (scoreDisplay[p2Score / 10][5] == 1)
-		{
-			vr.x = (scrWidth - scoreDisplayWidth) + 12 - scoreDisplayOffsetX;
-			vr.y = 12 + scoreDisplayOffsetY;
+		pong_timing_skip(&gameTiming);
+	}
+	SDL_AtomicSet(&rt.running, 0);
+	SDL_SemPost(rt.wake);
+	SDL_WaitThread(renderThread, NULL);
+	SDL_DestroySemaphore(rt.wake);
+	SDL_DelEventWatch(stamp_keys, &keyStamp);
+
+	if (recorder.file && pong_recorder_close(&recorder, &match) != 0)
+	{
+		PONG_LOG(PONG_LOG_ERROR, "Failed to write recording\n");
+	}
+	if (rallies.file && pong_rally_writer_close(&rallies) != 0)
+	{
+		PONG_LOG(PONG_LOG_ERROR, "Failed to write rally file\n");
+	}
+	if (replayFile)
+	{
+		pong_replay_free(&replay);
+	}
+	if (isOnline)
+	{
+		PONG_LOG(PONG_LOG_INFO, "Rollbacks: %d (%d frames played again, at most %d at once), stalls: %d\n",
+			online.stats.rollbacks, online.stats.resimulated, online.stats.maxDepth, online.stats.stalls);
+		PONG_LOG(PONG_LOG_INFO, "Checksums: %d matched, %d differed\n", online.stats.checksOk, online.stats.checksFailed);
+		pong_rollback_close(&online);
+	}
 
-			SDL_RenderFillRect(renderer, &vr);
-		}
-		if (scoreDisplay[p2Score / 10][6] == 1)
+	// this closes the window and shuts down SDL
+	pong_log_stop();
+	if (timingFile)
+	{
+		pong_timing_print_summary(&rt.timing, stdout);
+		if (pong_timing_write(&rt.timing, timingFile) != 0)
 		{
-			hr.x = (scrWidth - scoreDisplayWidth) - scoreDisplayOffsetX;
-			hr.y = 24 + scoreDisplayOffsetY;
-
-			SDL_RenderFillRect(renderer, &hr);
+			fprintf(stderr, "*** Failed to write frame timings to %s\n", timingFile);
 		}
-
-		// scanlines
-		if (scanlines == 1)
-		{
-			SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-			for (int y = 1; y < scrHeight; y += 2)
-			{
-				SDL_RenderDrawLine(renderer, 0, y, scrWidth, y);
-			}
-		}		
-
-		// display everything we just drew
-		SDL_RenderPresent(renderer);
 	}
-
-	// this closes the window and shuts down SDL
+	pong_latency_print_summary(&rt.latency, stdout);
+	pong_latency_free(&rt.latency);
+	pong_timing_free(&rt.timing);
+	pong_timing_free(&gameTiming);
 	SDL_Quit();
 
 	// we're done
@@ -0,0 +1,77 @@
+/*
+	Program: PONG
+	Module: pong_latency
+*/
+
+#include "pong_latency.h"
+
+#include <stdlib.h> // qsort(), realloc()
+
+#define SAMPLES_START 256
+
+void pong_latency_init(PongLatency* latency)
+{
+	SDL_memset(latency, 0, sizeof(*latency));
+	latency->msPerCount = 1000.0 / SDL_GetPerformanceFrequency();
+}
+
+void pong_latency_free(PongLatency* latency)
+{
+	free(latency->samples);
+	SDL_memset(latency, 0, sizeof(*latency));
+}
+
+void pong_latency_presented(PongLatency* latency, Uint64 inputTime, Uint64 presentTime)
+{
+	if (inputTime == 0 || inputTime == latency->lastInput || presentTime < inputTime)
+	{
+		return;
+	}
+	latency->lastInput = inputTime;
+
+	if (latency->count == latency->capacity)
+	{
+		int capacity = latency->capacity ? latency->capacity * 2 : SAMPLES_START;
+		float* samples = (float*)realloc(latency->samples, capacity * sizeof(float));
+
+		// out of memory: keep what there is and stop measuring
+		if (!samples)
+		{
+			return;
+		}
+		latency->samples = samples;
+		latency->capacity = capacity;
+	}
+	latency->samples[latency->count++] = (float)((presentTime - inputTime) * latency->msPerCount);
+}
+
+static int compare_floats(const void* a, const void* b)
+{
+	float x = *(const float*)a;
+	float y = *(const float*)b;
+
+	return (x > y) - (x < y);
+}
+
+void pong_latency_print_summary(const PongLatency* latency, FILE* out)
+{
+	int n = latency->count;
+	float* sorted;
+
+	if (n == 0)
+	{
+		return;
+	}
+	sorted = (float*)malloc(n * sizeof(float));
+	if (!sorted)
+	{
+		return;
+	}
+	SDL_memcpy(sorted, latency->samples, n * sizeof(float));
+	qsort(sorted, n, sizeof(float), compare_floats);
+
+	// nearest rank, as in pong_timing
+	fprintf(out, "INPUT TO PRESENT: %d inputs, p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms\n", n,
+		sorted[(n * 50 + 99) / 100 - 1], sorted[(n * 90 + 99) / 100 - 1], sorted[(n * 99 + 99) / 100 - 1], sorted[n - 1]);
+	free(sorted);
+}
@@ -0,0 +1,42 @@
+/*
+	Program: PONG
+	Module: pong_latency
+
+	Input to present latency: the time from SDL handing the game a key
+	press or release to SDL_RenderPresent returning with the first frame
+	that shows a tick played with it. The game thread stamps key events as
+	they are pumped and hands the stamp on in the snapshot of the tick that
+	used it; the render thread measures when it presents that snapshot.
+
+	The stamp is taken when the game pumps events, not when the key went
+	down. The default loop pumps once per tick, so a key can wait up to a
+	tick before it is stamped; --low-latency pumps every millisecond while
+	it waits, so its numbers miss less.
+*/
+
+#ifndef PONG_LATENCY_H
+#define PONG_LATENCY_H
+
+#include <SDL.h>
+#include <stdio.h> // FILE
+
+typedef struct PongLatency
+{
+	double msPerCount;
+	Uint64 lastInput;		// stamp of the newest input measured, so each is counted once
+	float* samples;			// ms
+	int count;
+	int capacity;
+} PongLatency;
+
+void pong_latency_init(PongLatency* latency);
+void pong_latency_free(PongLatency* latency);
+
+// render thread, after SDL_RenderPresent: a frame whose newest input was
+// stamped at inputTime (0 for none) went out at presentTime
+void pong_latency_presented(PongLatency* latency, Uint64 inputTime, Uint64 presentTime);
+
+// p50/p90/p99/max over every sample, one line. Nothing if there are none
+void pong_latency_print_summary(const PongLatency* latency, FILE* out);
+
+#endif
@@ -0,0 +1,208 @@
+/*
+	Program: PONG
+	Module: pong_log
+*/
+
+#include "pong_log.h"
+
+#include <SDL.h>
+#include <stdarg.h> // va_list
+#include <stdio.h>  // fprintf()
+#include <string.h> // strcmp()
+
+#define LOG_CAPACITY 512	// queued messages, a power of two
+#define LOG_IDLE_DELAY 10	// ms the log thread sleeps when there is nothing to write
+
+// one queued message. sequence says whose turn the slot is: the producer
+// that reserved position p fills it when it reads p and hands it over by
+// setting p + 1, the log thread frees it again by setting p + LOG_CAPACITY
+typedef struct LogRecord
+{
+	SDL_atomic_t sequence;
+	int level;
+	char text[PONG_LOG_MAX_TEXT];
+} LogRecord;
+
+int pong_log_level = PONG_LOG_DEBUG;
+
+static LogRecord ring[LOG_CAPACITY];
+static SDL_atomic_t head;		// next position to reserve, shared by every producer
+static unsigned int tail;		// next position to write out, only touched by the log thread
+static SDL_atomic_t dropped;	// messages lost to a full buffer since the last write
+static SDL_atomic_t running;
+static int started;				// messages go through the ring, not straight out
+static SDL_Thread* thread;
+static FILE* out;
+
+static void write_record(int level, const char* text)
+{
+	if (level >= PONG_LOG_WARN)
+	{
+		fprintf(out, "*** ");
+	}
+	fputs(text, out);
+}
+
+//
+// writes every message that is ready, returns how many there were
+//
+static int drain(void)
+{
+	int count = 0;
+	int lost;
+
+	for (;;)
+	{
+		LogRecord* record = &ring[tail & (LOG_CAPACITY - 1)];
+
+		if (SDL_AtomicGet(&record->sequence) != (int)(tail + 1))
+		{
+			break; // empty, or the producer is still filling it
+		}
+		write_record(record->level, record->text);
+		SDL_AtomicSet(&record->sequence, (int)(tail + LOG_CAPACITY));
+		tail++;
+		count++;
+	}
+
+	lost = SDL_AtomicSet(&dropped, 0);
+	if (lost > 0)
+	{
+		fprintf(out, "*** %d log messages dropped, buffer full\n", lost);
+		count++;
+	}
+	if (count > 0)
+	{
+		fflush(out);
+	}
+
+	return count;
+}
+
+static int log_thread(void* data)
+{
+	(void)data;
+	SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+
+	while (SDL_AtomicGet(&running))
+	{
+		if (drain() == 0)
+		{
+			SDL_Delay(LOG_IDLE_DELAY);
+		}
+	}
+	drain(); // anything posted before pong_log_stop
+
+	return 0;
+}
+
+int pong_log_start(const char* path)
+{
+	out = stdout;
+	if (path)
+	{
+		out = fopen(path, "w");
+		if (!out)
+		{
+			out = stdout;
+			return -1;
+		}
+	}
+
+	for (int i = 0; i < LOG_CAPACITY; i++)
+	{
+		SDL_AtomicSet(&ring[i].sequence, i);
+	}
+	SDL_AtomicSet(&head, 0);
+	SDL_AtomicSet(&dropped, 0);
+	SDL_AtomicSet(&running, 1);
+	tail = 0;
+
+	thread = SDL_CreateThread(log_thread, "pong_log", NULL);
+	if (!thread)
+	{
+		SDL_AtomicSet(&running, 0);
+		return 0; // no thread, keep writing straight away
+	}
+	started = 1;
+
+	return 0;
+}
+
+void pong_log_stop(void)
+{
+	if (started)
+	{
+		started = 0;
+		SDL_AtomicSet(&running, 0);
+		SDL_WaitThread(thread, NULL);
+		thread = NULL;
+	}
+	if (out && out != stdout)
+	{
+		fclose(out);
+	}
+	out = NULL;
+}
+
+int pong_log_parse_level(const char* name)
+{
+	static const char* names[] = { "debug", "info", "warn", "error", "off" };
+
+	for (int i = 0; i < 5; i++)
+	{
+		if (strcmp(name, names[i]) == 0)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+void pong_log_post(int level, const char* format, ...)
+{
+	va_list list;
+
+	if (!started)
+	{
+		if (!out)
+		{
+			out = stdout;
+		}
+		if (level >= PONG_LOG_WARN)
+		{
+			fprintf(out, "*** ");
+		}
+		va_start(list, format);
+		vfprintf(out, format, list);
+		va_end(list);
+		return;
+	}
+
+	for (;;)
+	{
+		unsigned int pos = (unsigned int)SDL_AtomicGet(&head);
+		LogRecord* record = &ring[pos & (LOG_CAPACITY - 1)];
+		int diff = (int)((unsigned int)SDL_AtomicGet(&record->sequence) - pos);
+
+		if (diff == 0)
+		{
+			if (SDL_AtomicCAS(&head, (int)pos, (int)(pos + 1)))
+			{
+				// the slot is ours until sequence is set, format straight into it
+				record->level = level;
+				va_start(list, format);
+				SDL_vsnprintf(record->text, sizeof(record->text), format, list);
+				va_end(list);
+				SDL_AtomicSet(&record->sequence, (int)(pos + 1)); // full barrier, the log thread sees a complete record
+				return;
+			}
+		}
+		else if (diff < 0)
+		{
+			SDL_AtomicAdd(&dropped, 1); // the log thread hasn't caught up, don't wait for it
+			return;
+		}
+		// another producer took this position, try the next one
+	}
+}
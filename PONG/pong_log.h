@@ -0,0 +1,55 @@
+/*
+	Program: PONG
+	Module: pong_log
+
+	Game messages (collisions, scores, menus) without the console in the
+	frame loop. Logging a message formats it into a slot of a ring buffer,
+	which costs no more than a short sprintf and never blocks; a background
+	thread writes the slots out to stdout or a file.
+*/
+
+#ifndef PONG_LOG_H
+#define PONG_LOG_H
+
+#define PONG_LOG_DEBUG 0	// every collision
+#define PONG_LOG_INFO 1		// scores, wins, menus
+#define PONG_LOG_WARN 2
+#define PONG_LOG_ERROR 3
+#define PONG_LOG_OFF 4
+
+// messages below this level are compiled out, /D PONG_LOG_MIN_LEVEL=4 removes logging altogether
+#ifndef PONG_LOG_MIN_LEVEL
+#define PONG_LOG_MIN_LEVEL PONG_LOG_DEBUG
+#endif
+
+#define PONG_LOG_MAX_TEXT 512	// longest message, longer ones are cut short
+
+// messages below this level are dropped at run time, before anything is queued
+extern int pong_log_level;
+
+// PONG_LOG(level, format, ...): printf formatting, done before it returns,
+// so any arguments are fine, strings in buffers about to be reused included
+#define PONG_LOG(level, ...) \
+	do \
+	{ \
+		if ((level) >= PONG_LOG_MIN_LEVEL && (level) >= pong_log_level) \
+		{ \
+			pong_log_post((level), __VA_ARGS__); \
+		} \
+	} while (0)
+
+// starts the log thread writing to path, or to stdout if path is NULL.
+// returns -1 if the file can't be opened. Until then messages are written straight away
+int pong_log_start(const char* path);
+
+// writes whatever is still queued and stops the log thread
+void pong_log_stop(void);
+
+// "debug", "info", "warn", "error" or "off", -1 for anything else
+int pong_log_parse_level(const char* name);
+
+// use PONG_LOG, it skips this call for filtered levels. Never blocks: when the
+// buffer is full the message is dropped and counted
+void pong_log_post(int level, const char* format, ...);
+
+#endif
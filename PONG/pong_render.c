@@ -0,0 +1,424 @@
+/*
+	Program: PONG
+	Module: pong_render
+*/
+
+#include "pong_render.h"
+
+/* Score Display Digit Pieces
+
+	    _0_ 
+	  1|   |2
+	   |_3_|  
+	  4|   |5
+	   |_6_| 
+*/
+
+static const int scoreDisplay[10][7] = {
+	//0  1  2  3  4  5  6	<- Pieces
+	{ 1, 1, 1, 0, 1, 1, 1 }, // 0
+	{ 0, 0, 1, 0, 0, 1, 0 }, // 1
+	{ 1, 0, 1, 1, 1, 0, 1 }, // 2
+	{ 1, 0, 1, 1, 0, 1, 1 }, // 3
+	{ 0, 1, 1, 1, 0, 1, 0 }, // 4
+	{ 1, 1, 0, 1, 0, 1, 1 }, // 5
+	{ 1, 1, 0, 1, 1, 1, 1 }, // 6
+	{ 1, 0, 1, 0, 0, 1, 0 }, // 7
+	{ 1, 1, 1, 1, 1, 1, 1 }, // 8
+	{ 1, 1, 1, 1, 0, 1, 1 }  // 9
+};							 // ^ Digits
+
+// where each piece sits inside a digit
+static const SDL_Rect scorePieces[7] = {
+	{ 0, 0, 16, 4 },	// 0, horizontal pieces are 16 x 4
+	{ 0, 0, 4, 16 },	// 1, vertical pieces are 4 x 16
+	{ 12, 0, 4, 16 },	// 2
+	{ 0, 12, 16, 4 },	// 3
+	{ 0, 12, 4, 16 },	// 4
+	{ 12, 12, 4, 16 },	// 5
+	{ 0, 24, 16, 4 }	// 6
+};
+
+#define SCORE_DIGIT_WIDTH 16
+#define SCORE_DIGIT_PITCH 20	// next digit offset from the one before it
+#define SCORE_MIN_DIGITS 2		// 0 is shown as 00
+#define SCORE_OFFSET_Y 4
+
+// F3 frame timing overlay, half size digits
+#define TIMING_DIGITS 4			// microseconds, up to 9999
+#define TIMING_ROW_HEIGHT 18
+#define TIMING_BAR_X 48
+#define TIMING_BAR_SCALE 20		// pixels per millisecond
+#define TIMING_BAR_MAX 340		// 17 ms, a missed frame at 60 Hz runs off the end
+
+#define QUADS_START 256			// first size of the vertex buffer, doubled when it fills up
+
+void pong_render_init(PongRenderer* r, SDL_Renderer* renderer)
+{
+	SDL_Color white = { 255, 255, 255, 255 };	// color 0
+	SDL_Color red = { 255, 0, 0, 255 };			// color 1
+	SDL_Color green = { 0, 255, 0, 255 };		// color 2
+
+	SDL_memset(r, 0, sizeof(*r));
+	r->renderer = renderer;
+	r->palette[PONG_COLOR_WHITE] = white;
+	r->palette[PONG_COLOR_RED] = red;
+	r->palette[PONG_COLOR_GREEN] = green;
+	r->scaleX = 1.0f;
+	r->scaleY = 1.0f;
+
+	// the lit pieces of every digit, so drawing a score is just copying them
+	for (int digit = 0; digit < 10; digit++)
+	{
+		for (int piece = 0; piece < 7; piece++)
+		{
+			if (scoreDisplay[digit][piece] == 1)
+			{
+				r->digitRects[digit][r->digitRectCount[digit]++] = scorePieces[piece];
+			}
+		}
+	}
+}
+
+void pong_render_destroy(PongRenderer* r)
+{
+	SDL_free(r->vertices);
+	SDL_free(r->indices);
+	SDL_memset(r, 0, sizeof(*r));
+}
+
+//
+// room for count more quads, returns 0 if the buffers couldn't grow
+//
+static int reserve_quads(PongRenderer* r, int count)
+{
+	int capacity = r->quadCapacity > 0 ? r->quadCapacity : QUADS_START;
+	SDL_Vertex* vertices;
+	int* indices;
+
+	if (r->quadCount + count <= r->quadCapacity)
+	{
+		return 1;
+	}
+	while (capacity < r->quadCount + count)
+	{
+		capacity *= 2;
+	}
+
+	vertices = (SDL_Vertex*)SDL_realloc(r->vertices, capacity * 4 * sizeof(SDL_Vertex));
+	if (!vertices)
+	{
+		return 0;
+	}
+	r->vertices = vertices;
+	indices = (int*)SDL_realloc(r->indices, capacity * 6 * sizeof(int));
+	if (!indices)
+	{
+		return 0;
+	}
+	r->indices = indices;
+
+	// top left, top right, bottom left / bottom left, top right, bottom right
+	for (int q = r->quadCapacity; q < capacity; q++)
+	{
+		indices[q * 6 + 0] = q * 4 + 0;
+		indices[q * 6 + 1] = q * 4 + 1;
+		indices[q * 6 + 2] = q * 4 + 2;
+		indices[q * 6 + 3] = q * 4 + 2;
+		indices[q * 6 + 4] = q * 4 + 1;
+		indices[q * 6 + 5] = q * 4 + 3;
+	}
+	r->quadCapacity = capacity;
+
+	return 1;
+}
+
+//
+// a logical coordinate moved to the nearest edge between output pixels, so
+// edges stay sharp at any scale and movement is as smooth as the output allows
+//
+static float snap(float logical, float scale)
+{
+	return SDL_floorf(logical * scale + 0.5f) / scale;
+}
+
+//
+// adds a w x h rectangle at (x, y) in logical pixels, in one colour
+//
+static void push_rect(PongRenderer* r, float x, float y, float w, float h, SDL_Color color)
+{
+	SDL_Vertex* v;
+	float left, right, top, bottom;
+
+	if (!reserve_quads(r, 1))
+	{
+		return;
+	}
+
+	left = snap(x, r->scaleX);
+	right = snap(x + w, r->scaleX);
+	top = snap(y, r->scaleY);
+	bottom = snap(y + h, r->scaleY);
+
+	v = &r->vertices[r->quadCount * 4];
+	for (int i = 0; i < 4; i++)
+	{
+		v[i].position.x = (i & 1) ? right : left;
+		v[i].position.y = (i & 2) ? bottom : top;
+		v[i].color = color;
+		v[i].tex_coord.x = 0.0f;
+		v[i].tex_coord.y = 0.0f;
+	}
+	r->quadCount++;
+}
+
+//
+// draws every quad added since the last submit in one call
+//
+static void submit(PongRenderer* r)
+{
+	if (r->quadCount > 0)
+	{
+		SDL_RenderGeometry(r->renderer, NULL, r->vertices, r->quadCount * 4, r->indices, r->quadCount * 6);
+		r->drawCalls++;
+		r->quadCount = 0;
+	}
+}
+
+//
+// sets the playfield size, SDL works out the scale and letterbox from the output size
+//
+static void update_scale(PongRenderer* r, int scrWidth, int scrHeight)
+{
+	if (r->logicalWidth != scrWidth || r->logicalHeight != scrHeight)
+	{
+		SDL_RenderSetLogicalSize(r->renderer, scrWidth, scrHeight);
+		r->logicalWidth = scrWidth;
+		r->logicalHeight = scrHeight;
+	}
+	SDL_RenderGetScale(r->renderer, &r->scaleX, &r->scaleY);
+	if (r->scaleX <= 0.0f || r->scaleY <= 0.0f)
+	{
+		r->scaleX = 1.0f;
+		r->scaleY = 1.0f;
+	}
+}
+
+//
+// blends a rectangle between the previous and the current tick, alpha in [0, 1],
+// and adds it in logical pixels, fractions kept for outputs bigger than the playfield
+//
+static void push_lerp_rect(PongRenderer* r, const PongRect* from, const PongRect* to, double alpha, SDL_Color color)
+{
+	double x = from->x + (to->x - from->x) * alpha;
+	double y = from->y + (to->y - from->y) * alpha;
+
+	push_rect(r, (float)(x / PONG_FIXED_ONE), (float)(y / PONG_FIXED_ONE), (float)PONG_PIXELS(to->w), (float)PONG_PIXELS(to->h), color);
+}
+
+//
+// darkens every odd playfield row, so the lines grow with the picture like a CRT's
+//
+static void push_scanlines(PongRenderer* r, int scrWidth, int scrHeight)
+{
+	SDL_Color black = { 0, 0, 0, 255 };
+
+	if (!reserve_quads(r, scrHeight / 2))
+	{
+		return;
+	}
+	for (int y = 1; y < scrHeight; y += 2)
+	{
+		push_rect(r, 0.0f, (float)y, (float)scrWidth, 1.0f, black);
+	}
+}
+
+//
+// digits needed to show value, never fewer than minDigits
+//
+static int count_digits(int value, int minDigits)
+{
+	int digits = 1;
+
+	while (value >= 10 && digits < PONG_RENDER_MAX_DIGITS)
+	{
+		value /= 10;
+		digits++;
+	}
+
+	return digits < minDigits ? minDigits : digits;
+}
+
+//
+// fills rects with the lit pieces of value, left-most digit at (x, y), and returns how many.
+// shrink divides the size of the digits, 1 for the score
+//
+static int build_number_rects(const PongRenderer* r, int value, int digits, int x, int y, int shrink, SDL_Rect* rects)
+{
+	int count = 0;
+
+	// ones first, walking left
+	for (int i = digits - 1; i >= 0; i--)
+	{
+		int digit = value % 10;
+		int digitX = x + i * SCORE_DIGIT_PITCH / shrink;
+
+		for (int piece = 0; piece < r->digitRectCount[digit]; piece++)
+		{
+			const SDL_Rect* p = &r->digitRects[digit][piece];
+
+			rects[count].x = digitX + p->x / shrink;
+			rects[count].y = y + p->y / shrink;
+			rects[count].w = p->w / shrink;
+			rects[count].h = p->h / shrink;
+			count++;
+		}
+		value /= 10;
+	}
+
+	return count;
+}
+
+//
+// adds a number's lit pieces in one colour
+//
+static void push_number(PongRenderer* r, int value, int digits, int x, int y, int shrink, SDL_Color color)
+{
+	SDL_Rect rects[PONG_RENDER_MAX_DIGITS * 7];
+	int count = build_number_rects(r, value, digits, x, y, shrink, rects);
+
+	for (int i = 0; i < count; i++)
+	{
+		push_rect(r, (float)rects[i].x, (float)rects[i].y, (float)rects[i].w, (float)rects[i].h, color);
+	}
+}
+
+//
+// adds one player's score, centred on the middle of their half
+//
+static void push_score(PongRenderer* r, int score, int won, int player, int scrWidth)
+{
+	int digits = count_digits(score, SCORE_MIN_DIGITS);
+	int w = digits * SCORE_DIGIT_PITCH - (SCORE_DIGIT_PITCH - SCORE_DIGIT_WIDTH);
+	int x = (scrWidth / 4) - (w / 2);
+
+	if (player == 2)
+	{
+		x = (scrWidth - w) - x;
+	}
+	push_number(r, score, digits, x, SCORE_OFFSET_Y, 1, r->palette[won ? PONG_COLOR_GREEN : PONG_COLOR_WHITE]);
+}
+
+//
+// charges the time since the last mark to phase, if frames are being timed
+//
+static void mark(PongRenderer* r, int phase)
+{
+	if (r->timing)
+	{
+		pong_timing_mark(r->timing, phase);
+	}
+}
+
+void pong_render_frame(PongRenderer* r, const PongMatch* prev, const PongMatch* cur, double alpha, int scanlines)
+{
+	SDL_Renderer* renderer = r->renderer;
+	SDL_Color grey = { 128, 128, 128, 255 };
+	int scrWidth = cur->config.scrWidth;
+	int scrHeight = cur->config.scrHeight;
+	int winScore = cur->config.winScore;
+	int p1Score = cur->p1Score;
+	int p2Score = cur->p2Score;
+
+	update_scale(r, scrWidth, scrHeight);
+	r->quadCount = 0;
+
+	// background, the letterbox bars too
+	SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+	SDL_RenderClear(renderer);
+	r->drawCalls++;
+	mark(r, PONG_PHASE_BACKGROUND);
+
+	// half line
+	push_rect(r, (float)(scrWidth / 2), 0.0f, 1.0f, (float)scrHeight, grey);
+	mark(r, PONG_PHASE_HALF_LINE);
+
+	if (cur->gameOn == 1)
+	{
+		// paddles
+		push_lerp_rect(r, &prev->p1, &cur->p1, alpha, r->palette[cur->p1ColorSetting]);
+		push_lerp_rect(r, &prev->p2, &cur->p2, alpha, r->palette[cur->p2ColorSetting]);
+		mark(r, PONG_PHASE_PADDLES);
+
+		// ball
+		if (cur->ballInPlay != 0)
+		{
+			push_lerp_rect(r, &prev->ball, &cur->ball, alpha, r->palette[cur->ballColorSetting]);
+		}
+		mark(r, PONG_PHASE_BALL);
+	}
+	// score
+	push_score(r, p1Score, p1Score >= winScore, 1, scrWidth);
+	push_score(r, p2Score, p2Score >= winScore, 2, scrWidth);
+	mark(r, PONG_PHASE_SCORE);
+
+	// scanlines
+	if (scanlines == 1)
+	{
+		push_scanlines(r, scrWidth, scrHeight);
+	}
+	mark(r, PONG_PHASE_SCANLINES);
+
+	submit(r);
+	mark(r, PONG_PHASE_SUBMIT);
+}
+
+void pong_render_timings(PongRenderer* r, const PongTiming* timing, int scrHeight)
+{
+	// one row per phase and one for the whole frame, in the order of pong_phase_names
+	static const SDL_Color colors[PONG_PHASE_COUNT + 1] = {
+		{ 255, 160, 0, 255 },	// events
+		{ 255, 255, 0, 255 },	// keys
+		{ 0, 255, 255, 255 },	// update
+		{ 96, 96, 255, 255 },	// background
+		{ 128, 128, 128, 255 },	// half line
+		{ 255, 255, 255, 255 },	// paddles
+		{ 255, 0, 255, 255 },	// ball
+		{ 0, 255, 0, 255 },		// score
+		{ 160, 96, 64, 255 },	// scanlines
+		{ 64, 160, 96, 255 },	// submit
+		{ 96, 96, 96, 255 },	// overlay
+		{ 255, 0, 0, 255 },		// present
+		{ 255, 255, 255, 255 }	// total
+	};
+	SDL_Color shade = { 0, 0, 0, 192 };
+	int rows = PONG_PHASE_COUNT + 1;
+	int panelW = TIMING_BAR_X + TIMING_BAR_MAX + 4;
+	int panelH = rows * TIMING_ROW_HEIGHT + 4;
+	int panelY = scrHeight - panelH;
+
+	r->quadCount = 0;
+	push_rect(r, 0.0f, (float)panelY, (float)panelW, (float)panelH, shade);
+
+	for (int i = 0; i < rows; i++)
+	{
+		float ms = i < PONG_PHASE_COUNT ? timing->average[i] : timing->averageTotal;
+		int us = (int)(ms * 1000.0f + 0.5f);
+		int y = panelY + 4 + i * TIMING_ROW_HEIGHT;
+		int barW = (int)(ms * TIMING_BAR_SCALE) + 1;
+
+		if (barW > TIMING_BAR_MAX)
+		{
+			barW = TIMING_BAR_MAX;
+		}
+
+		// microseconds, then a bar of TIMING_BAR_SCALE pixels per millisecond
+		push_number(r, us > 9999 ? 9999 : us, TIMING_DIGITS, 4, y, 2, colors[i]);
+		push_rect(r, (float)TIMING_BAR_X, (float)(y + 2), (float)barW, (float)(TIMING_ROW_HEIGHT - 6), colors[i]);
+	}
+
+	// the panel is see-through, everything else is opaque and draws the same either way
+	SDL_SetRenderDrawBlendMode(r->renderer, SDL_BLENDMODE_BLEND);
+	submit(r);
+	SDL_SetRenderDrawBlendMode(r->renderer, SDL_BLENDMODE_NONE);
+}
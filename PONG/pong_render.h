@@ -0,0 +1,63 @@
+/*
+	Program: PONG
+	Module: pong_render
+
+	Draws a match: background, half line, paddles, ball, score and the
+	scanline effect. The playfield is config.scrWidth x scrHeight logical
+	pixels, scaled to whatever size the output is with SDL's logical size,
+	letterboxed to keep its shape. Everything but the clear is a coloured
+	quad in one vertex buffer, drawn with a single SDL_RenderGeometry call,
+	so a frame costs the same two draw calls at any resolution.
+*/
+
+#ifndef PONG_RENDER_H
+#define PONG_RENDER_H
+
+#include <SDL.h>
+
+#if !SDL_VERSION_ATLEAST(2, 0, 18)
+#error "pong_render needs SDL 2.0.18 or newer for SDL_RenderGeometry"
+#endif
+
+#include "pong_sim.h"
+#include "pong_timing.h"
+
+#define PONG_RENDER_MAX_DIGITS 10 // enough for any int score
+
+typedef struct PongRenderer
+{
+	SDL_Renderer* renderer;
+	SDL_Color palette[PONG_COLOR_COUNT];	// white, red, green, indexed by colour setting
+
+	// the quads of the frame so far, four vertices and two triangles each.
+	// The indices never change, they are filled in as the buffers grow
+	SDL_Vertex* vertices;
+	int* indices;
+	int quadCount;
+	int quadCapacity;
+
+	// playfield size last given to SDL_RenderSetLogicalSize, and output pixels per logical pixel
+	int logicalWidth;
+	int logicalHeight;
+	float scaleX;
+	float scaleY;
+
+	// seven segment score: the lit pieces of each digit, built once
+	SDL_Rect digitRects[10][7];
+	int digitRectCount[10];
+
+	PongTiming* timing;				// if set, each part of the frame is marked as it is drawn
+	int drawCalls;					// SDL_Render* calls so far, clears and geometry
+} PongRenderer;
+
+void pong_render_init(PongRenderer* r, SDL_Renderer* renderer);
+void pong_render_destroy(PongRenderer* r);
+
+// draws cur, with paddles and ball blended from prev by alpha (0 = prev, 1 = cur)
+void pong_render_frame(PongRenderer* r, const PongMatch* prev, const PongMatch* cur, double alpha, int scanlines);
+
+// F3 overlay: average microseconds and a bar per phase, plus the whole frame,
+// in the bottom left corner. One more geometry call
+void pong_render_timings(PongRenderer* r, const PongTiming* timing, int scrHeight);
+
+#endif
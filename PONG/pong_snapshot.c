@@ -0,0 +1,44 @@
+/*
+	Program: PONG
+	Module: pong_snapshot
+*/
+
+#include "pong_snapshot.h"
+
+void pong_snapshot_init(PongSnapshotBuffer* b, const PongSnapshot* first)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		b->slots[i] = *first;
+	}
+	b->front = 0;
+	b->back = 1;
+	SDL_AtomicSet(&b->shared, 2);
+}
+
+PongSnapshot* pong_snapshot_write(PongSnapshotBuffer* b)
+{
+	return &b->slots[b->back];
+}
+
+void pong_snapshot_publish(PongSnapshotBuffer* b)
+{
+	// the snapshot must be complete before the reader can see it
+	SDL_MemoryBarrierRelease();
+	b->back = SDL_AtomicSet(&b->shared, b->back | PONG_SNAPSHOT_FRESH) & 3;
+}
+
+const PongSnapshot* pong_snapshot_read(PongSnapshotBuffer* b)
+{
+	if (SDL_AtomicGet(&b->shared) & PONG_SNAPSHOT_FRESH)
+	{
+		b->front = SDL_AtomicSet(&b->shared, b->front) & 3;
+		SDL_MemoryBarrierAcquire();
+	}
+	return &b->slots[b->front];
+}
+
+int pong_snapshot_fresh(PongSnapshotBuffer* b)
+{
+	return (SDL_AtomicGet(&b->shared) & PONG_SNAPSHOT_FRESH) != 0;
+}
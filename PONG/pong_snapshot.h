@@ -0,0 +1,60 @@
+/*
+	Program: PONG
+	Module: pong_snapshot
+
+	Hands the game thread's latest state to the render thread without
+	either one ever waiting for the other. Three snapshots take turns: the
+	game thread fills its own, then swaps it with the shared one; the
+	render thread swaps its own with the shared one whenever a newer one is
+	there. Each swap is a single atomic exchange, so the game thread can
+	publish at its tick rate while the render thread is stuck in a vsync
+	present, and the render thread always draws the newest whole snapshot.
+*/
+
+#ifndef PONG_SNAPSHOT_H
+#define PONG_SNAPSHOT_H
+
+#include <SDL.h>
+
+#include "pong_sim.h"
+#include "pong_timing.h"
+
+// what one drawn frame needs
+typedef struct PongSnapshot
+{
+	PongMatch prev;			// the tick before cur, for interpolation
+	PongMatch cur;
+	Uint64 curTime;			// performance counter when cur was due
+	int scanlines;			// F2, -1 or 1
+	int timings;			// F3, -1 or 1
+	Uint64 inputTime;		// stamp of the newest key event any tick up to cur was played with, see pong_latency
+	int exposures;			// window exposes and resizes so far, the picture has to be drawn again after one
+
+	// ms the game thread spent on the pass that made this snapshot, events to update
+	float gamePhases[PONG_PHASE_UPDATE + 1];
+} PongSnapshot;
+
+typedef struct PongSnapshotBuffer
+{
+	PongSnapshot slots[3];
+	SDL_atomic_t shared;	// slot index, plus PONG_SNAPSHOT_FRESH when it is newer than the reader's
+	int back;				// the game thread's slot
+	int front;				// the render thread's slot
+} PongSnapshotBuffer;
+
+#define PONG_SNAPSHOT_FRESH 4
+
+// every slot starts as first, before either thread runs
+void pong_snapshot_init(PongSnapshotBuffer* b, const PongSnapshot* first);
+
+// game thread: the snapshot to fill in, then publish it
+PongSnapshot* pong_snapshot_write(PongSnapshotBuffer* b);
+void pong_snapshot_publish(PongSnapshotBuffer* b);
+
+// render thread: the newest published snapshot, the same one again if nothing newer came
+const PongSnapshot* pong_snapshot_read(PongSnapshotBuffer* b);
+
+// render thread: non-zero if pong_snapshot_read would return a newer snapshot
+int pong_snapshot_fresh(PongSnapshotBuffer* b);
+
+#endif
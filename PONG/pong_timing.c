@@ -0,0 +1,264 @@
+/*
+	Program: PONG
+	Module: pong_timing
+*/
+
+#include "pong_timing.h"
+
+#include <stdlib.h> // qsort(), realloc()
+#include <string.h> // strlen(), strcmp()
+
+#define AVERAGE_WEIGHT 0.05f	// share of each new frame in the smoothed average
+
+const char* const pong_phase_names[PONG_PHASE_COUNT] = {
+	"events",
+	"keys",
+	"update",
+	"background",
+	"half_line",
+	"paddles",
+	"ball",
+	"score",
+	"scanlines",
+	"submit",
+	"overlay",
+	"present"
+};
+
+// p50, p99 and max of one column
+typedef struct Summary
+{
+	float p50;
+	float p99;
+	float max;
+} Summary;
+
+void pong_timing_init(PongTiming* timing, int keepFrames)
+{
+	SDL_memset(timing, 0, sizeof(*timing));
+	timing->msPerCount = 1000.0 / SDL_GetPerformanceFrequency();
+	timing->keepFrames = keepFrames;
+	timing->last = SDL_GetPerformanceCounter();
+}
+
+void pong_timing_free(PongTiming* timing)
+{
+	free(timing->frames);
+	SDL_memset(timing, 0, sizeof(*timing));
+}
+
+void pong_timing_begin(PongTiming* timing)
+{
+	// the clock keeps running from the last mark, so no time falls between frames
+	SDL_memset(timing->current, 0, sizeof(timing->current));
+}
+
+void pong_timing_skip(PongTiming* timing)
+{
+	timing->last = SDL_GetPerformanceCounter();
+}
+
+void pong_timing_mark(PongTiming* timing, int phase)
+{
+	Uint64 now = SDL_GetPerformanceCounter();
+
+	timing->current[phase] += (float)((now - timing->last) * timing->msPerCount);
+	timing->last = now;
+}
+
+void pong_timing_end(PongTiming* timing)
+{
+	float total = 0.0f;
+
+	for (int i = 0; i < PONG_PHASE_COUNT; i++)
+	{
+		timing->average[i] += (timing->current[i] - timing->average[i]) * AVERAGE_WEIGHT;
+		total += timing->current[i];
+	}
+	timing->averageTotal += (total - timing->averageTotal) * AVERAGE_WEIGHT;
+
+	if (!timing->keepFrames)
+	{
+		return;
+	}
+	if (timing->frameCount == timing->frameCapacity)
+	{
+		int capacity = timing->frameCapacity ? timing->frameCapacity * 2 : 4096;
+		float* frames = (float*)realloc(timing->frames, (size_t)capacity * PONG_PHASE_COUNT * sizeof(float));
+
+		if (!frames)
+		{
+			return; // out of memory, stop keeping frames but keep the game going
+		}
+		timing->frames = frames;
+		timing->frameCapacity = capacity;
+	}
+	SDL_memcpy(timing->frames + (size_t)timing->frameCount * PONG_PHASE_COUNT, timing->current, sizeof(timing->current));
+	timing->frameCount++;
+}
+
+static int compare_floats(const void* a, const void* b)
+{
+	float x = *(const float*)a;
+	float y = *(const float*)b;
+
+	return (x > y) - (x < y);
+}
+
+//
+// nearest-rank percentiles of one phase, or of the whole frame if phase is PONG_PHASE_COUNT
+//
+static Summary summarize(const PongTiming* timing, int phase, float* scratch)
+{
+	Summary s = { 0.0f, 0.0f, 0.0f };
+	int n = timing->frameCount;
+
+	if (n == 0)
+	{
+		return s;
+	}
+	for (int f = 0; f < n; f++)
+	{
+		const float* frame = timing->frames + (size_t)f * PONG_PHASE_COUNT;
+
+		if (phase < PONG_PHASE_COUNT)
+		{
+			scratch[f] = frame[phase];
+		}
+		else
+		{
+			scratch[f] = 0.0f;
+			for (int i = 0; i < PONG_PHASE_COUNT; i++)
+			{
+				scratch[f] += frame[i];
+			}
+		}
+	}
+	qsort(scratch, n, sizeof(float), compare_floats);
+
+	s.p50 = scratch[(n * 50 + 99) / 100 - 1];
+	s.p99 = scratch[(n * 99 + 99) / 100 - 1];
+	s.max = scratch[n - 1];
+
+	return s;
+}
+
+static float frame_total(const float* frame)
+{
+	float total = 0.0f;
+
+	for (int i = 0; i < PONG_PHASE_COUNT; i++)
+	{
+		total += frame[i];
+	}
+	return total;
+}
+
+static void write_csv(const PongTiming* timing, FILE* out)
+{
+	fprintf(out, "frame");
+	for (int i = 0; i < PONG_PHASE_COUNT; i++)
+	{
+		fprintf(out, ",%s", pong_phase_names[i]);
+	}
+	fprintf(out, ",total\n");
+
+	for (int f = 0; f < timing->frameCount; f++)
+	{
+		const float* frame = timing->frames + (size_t)f * PONG_PHASE_COUNT;
+
+		fprintf(out, "%d", f);
+		for (int i = 0; i < PONG_PHASE_COUNT; i++)
+		{
+			fprintf(out, ",%.4f", frame[i]);
+		}
+		fprintf(out, ",%.4f\n", frame_total(frame));
+	}
+}
+
+static void write_json(const PongTiming* timing, FILE* out, float* scratch)
+{
+	fprintf(out, "{\n  \"unit\": \"ms\",\n  \"frames\": %d,\n  \"summary\": {\n", timing->frameCount);
+	for (int i = 0; i <= PONG_PHASE_COUNT; i++)
+	{
+		Summary s = summarize(timing, i, scratch);
+
+		fprintf(out, "    \"%s\": { \"p50\": %.4f, \"p99\": %.4f, \"max\": %.4f }%s\n",
+			i < PONG_PHASE_COUNT ? pong_phase_names[i] : "total", s.p50, s.p99, s.max, i < PONG_PHASE_COUNT ? "," : "");
+	}
+	fprintf(out, "  },\n  \"phases\": [");
+	for (int i = 0; i < PONG_PHASE_COUNT; i++)
+	{
+		fprintf(out, "%s\"%s\"", i ? ", " : "", pong_phase_names[i]);
+	}
+	fprintf(out, "],\n  \"data\": [\n");
+	for (int f = 0; f < timing->frameCount; f++)
+	{
+		const float* frame = timing->frames + (size_t)f * PONG_PHASE_COUNT;
+
+		fprintf(out, "    [");
+		for (int i = 0; i < PONG_PHASE_COUNT; i++)
+		{
+			fprintf(out, "%s%.4f", i ? ", " : "", frame[i]);
+		}
+		fprintf(out, "]%s\n", f + 1 < timing->frameCount ? "," : "");
+	}
+	fprintf(out, "  ]\n}\n");
+}
+
+int pong_timing_write(const PongTiming* timing, const char* path)
+{
+	size_t length = strlen(path);
+	FILE* out = fopen(path, "w");
+	int result = 0;
+
+	if (!out)
+	{
+		return -1;
+	}
+
+	if (length >= 5 && strcmp(path + length - 5, ".json") == 0)
+	{
+		float* scratch = (float*)malloc((size_t)(timing->frameCount + 1) * sizeof(float));
+
+		if (scratch)
+		{
+			write_json(timing, out, scratch);
+			free(scratch);
+		}
+		else
+		{
+			result = -1;
+		}
+	}
+	else
+	{
+		write_csv(timing, out);
+	}
+
+	if (fclose(out) != 0)
+	{
+		result = -1;
+	}
+	return result;
+}
+
+void pong_timing_print_summary(const PongTiming* timing, FILE* out)
+{
+	float* scratch = (float*)malloc((size_t)(timing->frameCount + 1) * sizeof(float));
+
+	if (!scratch)
+	{
+		return;
+	}
+
+	fprintf(out, "FRAME TIMES: %d frames, ms\n", timing->frameCount);
+	fprintf(out, "  %-12s %8s %8s %8s\n", "phase", "p50", "p99", "max");
+	for (int i = 0; i <= PONG_PHASE_COUNT; i++)
+	{
+		Summary s = summarize(timing, i, scratch);
+
+		fprintf(out, "  %-12s %8.3f %8.3f %8.3f\n", i < PONG_PHASE_COUNT ? pong_phase_names[i] : "total", s.p50, s.p99, s.max);
+	}
+	free(scratch);
+}
@@ -0,0 +1,80 @@
+/*
+	Program: PONG
+	Module: pong_timing
+
+	Where the frame time goes. Each thread keeps its own PongTiming and
+	calls pong_timing_mark at the end of each of its phases; everything
+	since the last mark is charged to that phase. Keeps a smoothed average
+	for the F3 overlay and, if asked, every frame for a CSV or JSON export
+	with p50/p99/max per phase.
+
+	The game thread times events, keys and update, the render thread the
+	rest. A drawn frame's events, keys and update are those of the game
+	thread pass that made the snapshot it drew, so the total is the work
+	behind a frame rather than the time between presents.
+*/
+
+#ifndef PONG_TIMING_H
+#define PONG_TIMING_H
+
+#include <SDL.h>
+#include <stdio.h> // FILE
+
+// in frame order
+#define PONG_PHASE_EVENTS 0		// SDL_PollEvent, game thread
+#define PONG_PHASE_KEYS 1		// function key locks and keyboard state
+#define PONG_PHASE_UPDATE 2		// simulation ticks
+#define PONG_PHASE_BACKGROUND 3	// render thread from here on
+#define PONG_PHASE_HALF_LINE 4
+#define PONG_PHASE_PADDLES 5
+#define PONG_PHASE_BALL 6
+#define PONG_PHASE_SCORE 7
+#define PONG_PHASE_SCANLINES 8	// half line to scanlines only add vertices
+#define PONG_PHASE_SUBMIT 9		// the one SDL_RenderGeometry call that draws them
+#define PONG_PHASE_OVERLAY 10	// the timing overlay itself
+#define PONG_PHASE_PRESENT 11	// SDL_RenderPresent, includes waiting for vsync
+#define PONG_PHASE_COUNT 12
+
+extern const char* const pong_phase_names[PONG_PHASE_COUNT];
+
+typedef struct PongTiming
+{
+	Uint64 last;						// counter at the previous mark
+	double msPerCount;
+
+	float current[PONG_PHASE_COUNT];	// ms, frame in progress
+	float average[PONG_PHASE_COUNT];	// ms, smoothed over roughly the last 20 frames
+	float averageTotal;
+
+	// every finished frame, PONG_PHASE_COUNT values each, only if keepFrames was set
+	int keepFrames;
+	float* frames;
+	int frameCount;
+	int frameCapacity;
+} PongTiming;
+
+// keepFrames: non-zero to remember every frame for pong_timing_write
+void pong_timing_init(PongTiming* timing, int keepFrames);
+void pong_timing_free(PongTiming* timing);
+
+// starts a new frame
+void pong_timing_begin(PongTiming* timing);
+
+// restarts the clock without charging the time since the last mark to
+// anything, for a thread that has been sleeping
+void pong_timing_skip(PongTiming* timing);
+
+// charges the time since the last mark to phase
+void pong_timing_mark(PongTiming* timing, int phase);
+
+// finishes the frame: updates the averages and keeps it if asked to
+void pong_timing_end(PongTiming* timing);
+
+// writes every kept frame, JSON if path ends in .json and CSV otherwise.
+// JSON also gets the p50/p99/max summary. returns -1 if the file can't be written
+int pong_timing_write(const PongTiming* timing, const char* path);
+
+// p50/p99/max per phase and for the whole frame, one line each
+void pong_timing_print_summary(const PongTiming* timing, FILE* out);
+
+#endif
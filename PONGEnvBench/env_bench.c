@@ -0,0 +1,208 @@
+/*
+	Program: PONG
+	Tool: env_bench
+
+	Throughput test for pong_env. Steps a set of environments with random
+	actions, the way a training loop would, and reports env-steps per
+	second along with the episodes and points played. With --verify a
+	second copy on one thread is stepped alongside and every buffer is
+	compared after every step, so threading can't change a single value.
+
+	usage: env_bench [--envs N] [--steps N] [--threads N] [--pixels WxH]
+	                 [--opponent NAME] [--rwg] [--verify]
+*/
+
+#include <stdio.h>  // standard input/output
+#include <stdlib.h> // atoi(), malloc()
+#include <string.h> // strcmp(), memcmp()
+
+#include "pong_env.h"
+#include "pong_thread.h" // pong_cpu_count(), pong_clock_seconds()
+
+// one env's worth of the caller's buffers
+typedef struct Buffers
+{
+	float* observations;
+	float* rewards;
+	unsigned char* dones;
+	unsigned char* pixels;
+} Buffers;
+
+static void usage(const char* program)
+{
+	fprintf(stderr, "usage: %s [--envs N] [--steps N] [--threads N] [--pixels WxH]\n"
+		"                 [--opponent NAME] [--rwg] [--verify]\n", program);
+}
+
+static int alloc_buffers(Buffers* b, int envs, int pixels)
+{
+	b->observations = (float*)malloc((size_t)envs * PONG_ENV_FEATURES * sizeof(float));
+	b->rewards = (float*)malloc((size_t)envs * sizeof(float));
+	b->dones = (unsigned char*)malloc(envs);
+	b->pixels = pixels > 0 ? (unsigned char*)malloc((size_t)envs * pixels) : NULL;
+
+	return b->observations && b->rewards && b->dones && (pixels == 0 || b->pixels) ? 0 : -1;
+}
+
+static void free_buffers(Buffers* b)
+{
+	free(b->observations);
+	free(b->rewards);
+	free(b->dones);
+	free(b->pixels);
+}
+
+static int same_buffers(const Buffers* a, const Buffers* b, int envs, int pixels)
+{
+	return memcmp(a->observations, b->observations, (size_t)envs * PONG_ENV_FEATURES * sizeof(float)) == 0
+		&& memcmp(a->rewards, b->rewards, (size_t)envs * sizeof(float)) == 0
+		&& memcmp(a->dones, b->dones, envs) == 0
+		&& (pixels == 0 || memcmp(a->pixels, b->pixels, (size_t)envs * pixels) == 0);
+}
+
+int main(int argc, char** argv)
+{
+	PongEnvSettings settings;
+	PongEnv env, reference;
+	Buffers buffers, referenceBuffers;
+	int* actions;
+	int envs = 4096;
+	int steps = 2000;
+	int verify = 0;
+	int pixels;
+	unsigned int actionState = 1;
+	long long episodes = 0, cutOff = 0, won = 0, lost = 0;
+	double start, elapsed;
+
+	pong_env_settings_default(&settings);
+	settings.threads = pong_cpu_count();
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--envs") == 0 && i + 1 < argc)
+		{
+			envs = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--steps") == 0 && i + 1 < argc)
+		{
+			steps = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			settings.threads = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--pixels") == 0 && i + 1 < argc
+			&& sscanf(argv[i + 1], "%dx%d", &settings.pixelWidth, &settings.pixelHeight) == 2)
+		{
+			i++;
+		}
+		else if (strcmp(argv[i], "--opponent") == 0 && i + 1 < argc)
+		{
+			settings.opponent = pong_controller_find(argv[++i]);
+			if (!settings.opponent)
+			{
+				fprintf(stderr, "*** No controller called %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--rwg") == 0)
+		{
+			settings.RWGMode = 1;
+		}
+		else if (strcmp(argv[i], "--verify") == 0)
+		{
+			verify = 1;
+		}
+		else
+		{
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (envs <= 0 || steps <= 0 || settings.threads <= 0 || settings.pixelWidth < 0 || settings.pixelHeight < 0)
+	{
+		fprintf(stderr, "*** Envs, steps and threads must be positive, pixel sizes not negative\n");
+		return 1;
+	}
+	pixels = settings.pixelWidth * settings.pixelHeight;
+
+	actions = (int*)malloc((size_t)envs * sizeof(int));
+	if (!actions || pong_env_create(&env, &settings, envs) != 0 || alloc_buffers(&buffers, envs, pixels) != 0)
+	{
+		fprintf(stderr, "*** Failed to allocate %d envs\n", envs);
+		return 1;
+	}
+	pong_env_set_buffers(&env, buffers.observations, buffers.rewards, buffers.dones, buffers.pixels);
+	if (verify)
+	{
+		PongEnvSettings single = settings;
+
+		single.threads = 1;
+		if (pong_env_create(&reference, &single, envs) != 0 || alloc_buffers(&referenceBuffers, envs, pixels) != 0)
+		{
+			fprintf(stderr, "*** Failed to allocate %d envs\n", envs);
+			return 1;
+		}
+		pong_env_set_buffers(&reference, referenceBuffers.observations, referenceBuffers.rewards, referenceBuffers.dones, referenceBuffers.pixels);
+		pong_env_reset(&reference, 1);
+	}
+
+	printf("%d envs x %d steps, %d threads, %s vs %s, %d features", envs, steps, settings.threads,
+		settings.RWGMode ? "RWG" : "classic", settings.opponent ? settings.opponent->name : "built-in AI", PONG_ENV_FEATURES);
+	if (pixels > 0)
+	{
+		printf(" + %dx%d pixels", settings.pixelWidth, settings.pixelHeight);
+	}
+	printf("%s\n", verify ? ", verifying" : "");
+
+	pong_env_reset(&env, 1);
+	start = pong_clock_seconds();
+	for (int s = 0; s < steps; s++)
+	{
+		for (int i = 0; i < envs; i++)
+		{
+			actionState = actionState * 1103515245u + 12345u;
+			actions[i] = (actionState >> 16) % (settings.RWGMode ? PONG_ENV_ACTIONS : PONG_ENV_DOWN + 1);
+		}
+
+		pong_env_step(&env, actions);
+
+		for (int i = 0; i < envs; i++)
+		{
+			won += buffers.rewards[i] > 0.0f;
+			lost += buffers.rewards[i] < 0.0f;
+			episodes += buffers.dones[i] != PONG_ENV_RUNNING;
+			cutOff += buffers.dones[i] == PONG_ENV_CUT_OFF;
+		}
+
+		if (verify)
+		{
+			pong_env_step(&reference, actions);
+			if (!same_buffers(&buffers, &referenceBuffers, envs, pixels))
+			{
+				fprintf(stderr, "*** Step %d differs from the single thread run\n", s);
+				return 1;
+			}
+		}
+	}
+	elapsed = pong_clock_seconds() - start;
+	if (elapsed <= 0.0)
+	{
+		elapsed = 1e-9;
+	}
+
+	printf("%lld episodes finished (%lld cut off), points %lld won / %lld lost\n", episodes, cutOff, won, lost);
+	printf("%.2f M env-steps per second%s\n", (double)envs * steps / elapsed / 1e6, verify ? " (including verification)" : "");
+	if (verify)
+	{
+		printf("every step identical to the single thread run\n");
+		pong_env_destroy(&reference);
+		free_buffers(&referenceBuffers);
+	}
+
+	pong_env_destroy(&env);
+	free_buffers(&buffers);
+	free(actions);
+
+	return 0;
+}
@@ -0,0 +1,517 @@
+/*
+	Program: PONG
+	Tool: load_gen
+
+	Load generator for the dedicated server, for Linux. Simulates players,
+	each on its own UDP socket so the server spreads them over its workers
+	the way it would real clients. Every player joins, sends its keys every
+	tick (following the ball, and serving whenever it is dead), joins a new
+	match when one ends, and leaves at the end.
+
+	Players are shared out over worker threads, each with one epoll loop
+	over its players' sockets and a timerfd ticking at the tick rate. At
+	the end it reports how many of the states the server should have sent
+	arrived, and the time from sending an input to getting a state back
+	that includes it. --min-delivery and --max-p99 turn those into a pass
+	or fail for scripts.
+
+	usage: load_gen [--server HOST:PORT] [--matches N] [--pvp] [--threads N]
+	                [--seconds N] [--tick-rate N] [--min-delivery PCT] [--max-p99 MS]
+*/
+
+#define _GNU_SOURCE // CPU_SET()
+
+#include <sched.h>  // sched_setaffinity()
+#include <stdio.h>  // standard input/output
+#include <stdlib.h> // atoi(), calloc()
+#include <string.h> // strcmp(), strrchr()
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "pong_server.h"
+#include "pong_thread.h"
+
+#define JOIN_EVERY 0.25			// seconds between joins until the server answers
+#define SILENCE 2.0				// seconds without a state before a player gives up on a match
+#define LATENCY_BUCKETS 10000	// 0.1 ms each, the last one holds everything slower
+#define EVENTS 256
+
+typedef struct Player
+{
+	int socket;
+	int joined;
+	uint32_t match;
+	int number;				// 1 or 2
+	double lastJoin;
+	double lastState;
+	uint32_t lastEcho;		// latest client time seen in a state
+	uint32_t firstTick;		// server ticks of the first and last state of this match
+	uint32_t lastTick;
+	int states;				// states of this match so far
+	PongServerPacket state;
+} Player;
+
+typedef struct LoadGen LoadGen;
+
+typedef struct Worker
+{
+	LoadGen* gen;
+	int index;
+	Player* players;
+	int count;
+	int timer;
+	int epoll;
+	PongThread* thread;
+
+	long long expected;		// states that should have arrived, going by their ticks
+	long long received;
+	long long finished;		// matches played to the end
+	long long abandoned;	// matches given up after SILENCE
+	long long joins;
+	long long* latency;		// LATENCY_BUCKETS
+} Worker;
+
+struct LoadGen
+{
+	struct sockaddr_in server;
+	int tickRate;
+	int mode;
+	double start;
+	volatile int stop;
+	PongConfig config;		// the server's sizes, to steer by
+};
+
+// microseconds since the run started, what goes out as the client time
+static uint32_t client_time(const LoadGen* g, double now)
+{
+	return (uint32_t)((now - g->start) * 1e6) | 1;	// never 0, which means "none yet"
+}
+
+// done with the current match. Every server tick in between should have sent a state
+static void leave_match(Worker* w, Player* p)
+{
+	if (p->states > 0)
+	{
+		w->expected += p->lastTick - p->firstTick + 1;
+	}
+	p->joined = 0;
+}
+
+// keys for the next tick: follow the ball, serve when it's dead
+static PongInput steer(const LoadGen* g, const Player* p)
+{
+	PongFixed paddle = (p->number == 1 ? p->state.p1Y : p->state.p2Y) + PONG_FIXED(g->config.paddleH) / 2;
+	PongFixed ball = p->state.ballY + PONG_FIXED(g->config.ballSize) / 2;
+	PongInput keys = 0;
+
+	if (ball < paddle - PONG_FIXED(8))
+	{
+		keys |= PONG_INPUT_P1_UP;
+	}
+	else if (ball > paddle + PONG_FIXED(8))
+	{
+		keys |= PONG_INPUT_P1_DOWN;
+	}
+	if (!(p->state.flags & PONG_SERVER_BALL_IN_PLAY))
+	{
+		keys |= PONG_INPUT_SERVE;
+	}
+	return keys;
+}
+
+static void tick(Worker* w)
+{
+	LoadGen* g = w->gen;
+	double now = pong_clock_seconds();
+	unsigned char packet[PONG_SERVER_MAX_PACKET];
+
+	for (int i = 0; i < w->count; i++)
+	{
+		Player* p = &w->players[i];
+
+		if (p->joined && now - p->lastState > SILENCE)
+		{
+			leave_match(w, p);
+			w->abandoned++;
+		}
+
+		if (!p->joined)
+		{
+			if (now - p->lastJoin >= JOIN_EVERY)
+			{
+				p->lastJoin = now;
+				send(p->socket, packet, pong_server_write_join(packet, g->mode), 0);
+			}
+			continue;
+		}
+
+		send(p->socket, packet, pong_server_write_input(packet, p->match, p->number, steer(g, p), client_time(g, now)), 0);
+	}
+}
+
+static void receive(Worker* w, Player* p)
+{
+	LoadGen* g = w->gen;
+	unsigned char data[PONG_SERVER_MAX_PACKET];
+	PongServerPacket packet;
+	double now = pong_clock_seconds();
+	int size;
+
+	while ((size = (int)recv(p->socket, data, sizeof(data), MSG_DONTWAIT)) > 0)
+	{
+		switch (pong_server_read(&packet, data, size)) {
+		case PONG_SERVER_WELCOME:
+			if (!p->joined)
+			{
+				p->joined = 1;
+				p->match = packet.match;
+				p->number = packet.player;
+				p->lastState = now;
+				p->lastEcho = 0;
+				p->states = 0;
+				memset(&p->state, 0, sizeof(p->state));
+				w->joins++;
+			}
+			break;
+		case PONG_SERVER_STATE:
+			if (!p->joined || packet.match != p->match)
+			{
+				break;
+			}
+			w->received++;
+			if (p->states++ == 0)
+			{
+				p->firstTick = packet.tick;
+			}
+			p->lastTick = packet.tick;
+			p->lastState = now;
+			p->state = packet;
+
+			// one sample per input that made it into a state
+			if (packet.clientTime != 0 && packet.clientTime != p->lastEcho)
+			{
+				int bucket = (int)((client_time(g, now) - packet.clientTime) / 100);
+
+				w->latency[bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1]++;
+				p->lastEcho = packet.clientTime;
+			}
+
+			// straight back in for the next one
+			if (packet.flags & PONG_SERVER_OVER)
+			{
+				leave_match(w, p);
+				p->lastJoin = 0.0;
+				w->finished++;
+			}
+			break;
+		}
+	}
+}
+
+static int run_worker(void* data)
+{
+	Worker* w = (Worker*)data;
+	struct epoll_event events[EVENTS];
+	unsigned char packet[PONG_SERVER_MAX_PACKET];
+	cpu_set_t cpus;
+
+	CPU_ZERO(&cpus);
+	CPU_SET(w->index % pong_cpu_count(), &cpus);
+	sched_setaffinity(0, sizeof(cpus), &cpus);
+
+	while (!w->gen->stop)
+	{
+		int n = epoll_wait(w->epoll, events, EVENTS, 100);
+
+		for (int i = 0; i < n; i++)
+		{
+			if (events[i].data.u32 == (uint32_t)w->count)
+			{
+				uint64_t expirations;
+
+				if (read(w->timer, &expirations, sizeof(expirations)) == sizeof(expirations))
+				{
+					tick(w);
+				}
+			}
+			else
+			{
+				receive(w, &w->players[events[i].data.u32]);
+			}
+		}
+	}
+
+	for (int i = 0; i < w->count; i++)
+	{
+		if (w->players[i].joined)
+		{
+			send(w->players[i].socket, packet, pong_server_write_leave(packet, w->players[i].match, w->players[i].number), 0);
+			leave_match(w, &w->players[i]);
+		}
+	}
+	return 0;
+}
+
+// sockets, timer and epoll for one worker's players, -1 on failure
+static int open_worker(LoadGen* g, Worker* w)
+{
+	struct itimerspec interval;
+	struct epoll_event event;
+	long long nanos = 1000000000LL / g->tickRate;
+
+	w->timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+	w->epoll = epoll_create1(0);
+	w->latency = (long long*)calloc(LATENCY_BUCKETS, sizeof(long long));
+	if (w->timer < 0 || w->epoll < 0 || !w->latency)
+	{
+		return -1;
+	}
+
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	for (int i = 0; i < w->count; i++)
+	{
+		Player* p = &w->players[i];
+
+		// a socket of its own, so each player has its own port
+		p->socket = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, IPPROTO_UDP);
+		if (p->socket < 0 || connect(p->socket, (const struct sockaddr*)&g->server, sizeof(g->server)) != 0)
+		{
+			return -1;
+		}
+		event.data.u32 = (uint32_t)i;
+		if (epoll_ctl(w->epoll, EPOLL_CTL_ADD, p->socket, &event) != 0)
+		{
+			return -1;
+		}
+	}
+
+	memset(&interval, 0, sizeof(interval));
+	interval.it_interval.tv_sec = (time_t)(nanos / 1000000000LL);
+	interval.it_interval.tv_nsec = (long)(nanos % 1000000000LL);
+	interval.it_value = interval.it_interval;
+	if (timerfd_settime(w->timer, 0, &interval, NULL) != 0)
+	{
+		return -1;
+	}
+	event.data.u32 = (uint32_t)w->count;
+	return epoll_ctl(w->epoll, EPOLL_CTL_ADD, w->timer, &event);
+}
+
+// ms below which share of the samples fall
+static double percentile(const long long* latency, long long samples, double share)
+{
+	long long wanted = (long long)(samples * share);
+	long long seen = 0;
+
+	for (int b = 0; b < LATENCY_BUCKETS; b++)
+	{
+		seen += latency[b];
+		if (seen > wanted)
+		{
+			return (b + 1) / 10.0;
+		}
+	}
+	return LATENCY_BUCKETS / 10.0;
+}
+
+int main(int argc, char** argv)
+{
+	LoadGen g;
+	Worker* workers;
+	Player* players;
+	char host[256] = "127.0.0.1";
+	int port = 7777;
+	int matches = 1000;
+	int threads = pong_cpu_count();
+	int seconds = 10;
+	double minDelivery = 0.0;
+	double maxP99 = 0.0;
+	int count;
+	struct addrinfo hints, *found;
+	struct rlimit files;
+	long long expected = 0, received = 0, finished = 0, abandoned = 0, joins = 0, samples = 0;
+	long long* latency;
+	double delivered, elapsed;
+	int failed = 0;
+
+	memset(&g, 0, sizeof(g));
+	g.tickRate = 60;
+	g.mode = PONG_SERVER_VS_AI;
+	pong_config_default(&g.config);
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--server") == 0 && i + 1 < argc && strrchr(argv[i + 1], ':') && strlen(argv[i + 1]) < sizeof(host))
+		{
+			i++;
+			strncpy(host, argv[i], sizeof(host) - 1);
+			*strrchr(host, ':') = '\0';
+			port = atoi(strrchr(argv[i], ':') + 1);
+		}
+		else if (strcmp(argv[i], "--matches") == 0 && i + 1 < argc)
+		{
+			matches = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--pvp") == 0)
+		{
+			g.mode = PONG_SERVER_VS_PLAYER;
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			threads = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+		{
+			seconds = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc)
+		{
+			g.tickRate = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--min-delivery") == 0 && i + 1 < argc)
+		{
+			minDelivery = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--max-p99") == 0 && i + 1 < argc)
+		{
+			maxP99 = atof(argv[++i]);
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s [--server HOST:PORT] [--matches N] [--pvp] [--threads N] [--seconds N] [--tick-rate N] [--min-delivery PCT] [--max-p99 MS]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (port <= 0 || port > 65535 || matches <= 0 || threads <= 0 || seconds <= 0 || g.tickRate <= 0)
+	{
+		fprintf(stderr, "*** --matches, --threads, --seconds, --tick-rate and the port must be positive\n");
+		return 1;
+	}
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	if (getaddrinfo(host, NULL, &hints, &found) != 0)
+	{
+		fprintf(stderr, "*** Can't find %s\n", host);
+		return 1;
+	}
+	memcpy(&g.server, found->ai_addr, sizeof(g.server));
+	g.server.sin_port = htons((unsigned short)port);
+	freeaddrinfo(found);
+
+	// a socket per player, more than the usual file limit
+	count = g.mode == PONG_SERVER_VS_PLAYER ? matches * 2 : matches;
+	if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < (rlim_t)count + 64)
+	{
+		files.rlim_cur = files.rlim_max < (rlim_t)count + 64 ? files.rlim_max : (rlim_t)count + 64;
+		setrlimit(RLIMIT_NOFILE, &files);
+	}
+	if (threads > count)
+	{
+		threads = count;
+	}
+
+	workers = (Worker*)calloc(threads, sizeof(Worker));
+	players = (Player*)calloc(count, sizeof(Player));
+	latency = (long long*)calloc(LATENCY_BUCKETS, sizeof(long long));
+	if (!workers || !players || !latency)
+	{
+		fprintf(stderr, "*** Out of memory\n");
+		return 1;
+	}
+	for (int i = 0; i < threads; i++)
+	{
+		Worker* w = &workers[i];
+
+		w->gen = &g;
+		w->index = i;
+		w->players = players + (long long)count * i / threads;
+		w->count = (int)((long long)count * (i + 1) / threads - (long long)count * i / threads);
+		if (open_worker(&g, w) != 0)
+		{
+			fprintf(stderr, "*** Failed to open sockets for %d players, check ulimit -n\n", count);
+			return 1;
+		}
+	}
+
+	printf("%d players in %d matches %s on %s:%d, %d threads, %d ticks per second, %d s\n", count, matches,
+		g.mode == PONG_SERVER_VS_PLAYER ? "against each other" : "against the built-in AI", host, port, threads, g.tickRate, seconds);
+	fflush(stdout);
+
+	g.start = pong_clock_seconds();
+	for (int i = 0; i < threads; i++)
+	{
+		workers[i].thread = pong_thread_create(run_worker, &workers[i]);
+		if (!workers[i].thread)
+		{
+			fprintf(stderr, "*** Failed to start worker %d\n", i);
+			g.stop = 1;
+			return 1;
+		}
+	}
+	while (pong_clock_seconds() - g.start < seconds)
+	{
+		pong_sleep_ms(10);
+	}
+	g.stop = 1;
+	elapsed = pong_clock_seconds() - g.start;
+
+	for (int i = 0; i < threads; i++)
+	{
+		Worker* w = &workers[i];
+
+		pong_thread_join(w->thread);
+		expected += w->expected;
+		received += w->received;
+		finished += w->finished;
+		abandoned += w->abandoned;
+		joins += w->joins;
+		for (int b = 0; b < LATENCY_BUCKETS; b++)
+		{
+			latency[b] += w->latency[b];
+			samples += w->latency[b];
+		}
+		for (int p = 0; p < w->count; p++)
+		{
+			close(w->players[p].socket);
+		}
+		close(w->timer);
+		close(w->epoll);
+		free(w->latency);
+	}
+
+	delivered = expected > 0 ? 100.0 * received / expected : 0.0;
+	printf("%lld joins, %lld matches finished, %lld abandoned after %.0f s of silence\n", joins, finished, abandoned, SILENCE);
+	printf("states: %lld of %lld arrived (%.2f%%), %.0f per second\n", received, expected, delivered, received / elapsed);
+	if (samples > 0)
+	{
+		printf("input to state: p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, p99.9 %.1f ms (%lld samples)\n",
+			percentile(latency, samples, 0.5), percentile(latency, samples, 0.9), percentile(latency, samples, 0.99),
+			percentile(latency, samples, 0.999), samples);
+	}
+
+	if (delivered < minDelivery)
+	{
+		fprintf(stderr, "*** Only %.2f%% of the states arrived, below %.2f%%\n", delivered, minDelivery);
+		failed = 1;
+	}
+	if (maxP99 > 0.0 && (samples == 0 || percentile(latency, samples, 0.99) > maxP99))
+	{
+		fprintf(stderr, "*** p99 input to state time over %.1f ms\n", maxP99);
+		failed = 1;
+	}
+
+	free(workers);
+	free(players);
+	free(latency);
+
+	return failed;
+}
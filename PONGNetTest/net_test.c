@@ -0,0 +1,235 @@
+/*
+	Program: PONG
+	Tool: net_test
+
+	Plays an online match between two computer players in one process,
+	host and joiner talking over loopback UDP through pong_rollback, in real
+	time, with made up latency, jitter and packet loss. Reports how often
+	each side had to roll back or stall, and fails if the two copies of the
+	match ever disagree on a checksum.
+
+	usage: net_test [--seconds N] [--latency MS] [--jitter MS] [--loss PCT]
+	                [--rwg] [--swept] [--p1 NAME] [--p2 NAME]
+*/
+
+#include <stdio.h>  // standard input/output
+#include <stdlib.h> // atoi()
+#include <string.h> // strcmp()
+
+#include "pong_ai.h"
+#include "pong_rollback.h"
+#include "pong_thread.h" // pong_clock_seconds(), pong_sleep_ms()
+
+#define CONNECT_TIMEOUT 5.0	// seconds
+
+typedef struct Side
+{
+	PongRollback rb;
+	const PongController* controller;
+	PongAIState ai;
+	int frames;
+	int gone;
+} Side;
+
+static void usage(const char* program)
+{
+	fprintf(stderr, "usage: %s [--seconds N] [--latency MS] [--jitter MS] [--loss PCT]\n"
+		"                [--rwg] [--swept] [--p1 NAME] [--p2 NAME]\n", program);
+}
+
+// one tick of one side: its controller decides from the match as this side sees it
+static void tick(Side* side)
+{
+	const PongMatch* match = &side->rb.match;
+	PongInput input = side->controller->think(&side->ai, match);
+	unsigned int events;
+	int result;
+
+	if (match->gameOn && !match->ballInPlay)
+	{
+		input |= PONG_INPUT_SERVE;
+	}
+
+	result = pong_rollback_tick(&side->rb, input, &events);
+	if (result == PONG_ROLLBACK_STEPPED)
+	{
+		side->frames++;
+	}
+	else if (result == PONG_ROLLBACK_GONE)
+	{
+		side->gone = 1;
+	}
+}
+
+static void print_side(const char* name, const Side* side)
+{
+	const PongRollbackStats* s = &side->rb.stats;
+
+	printf("%-5s %7d %9d %11.2f %9d %7d %6d %8d %8d %7d\n", name, side->frames, s->rollbacks,
+		s->rollbacks > 0 ? (double)s->resimulated / s->rollbacks : 0.0, s->maxDepth, s->stalls, s->waits,
+		s->checksOk, s->checksFailed, side->rb.net.dropped);
+}
+
+int main(int argc, char** argv)
+{
+	static Side host, join;
+	PongNetFaults faults = { 0, 0, 0 };
+	PongConfig config;
+	double seconds = 10.0;
+	int RWGMode = 0;
+	double start, next, step;
+
+	pong_config_default(&config);
+	host.controller = pong_controller_find("intercept-medium");
+	join.controller = pong_controller_find("random");
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+		{
+			seconds = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--latency") == 0 && i + 1 < argc)
+		{
+			faults.latencyMs = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--jitter") == 0 && i + 1 < argc)
+		{
+			faults.jitterMs = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--loss") == 0 && i + 1 < argc)
+		{
+			faults.lossPercent = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--rwg") == 0)
+		{
+			RWGMode = 1;
+		}
+		else if (strcmp(argv[i], "--swept") == 0)
+		{
+			config.physics = PONG_PHYSICS_SWEPT;
+		}
+		else if ((strcmp(argv[i], "--p1") == 0 || strcmp(argv[i], "--p2") == 0) && i + 1 < argc)
+		{
+			const PongController* controller = pong_controller_find(argv[i + 1]);
+
+			if (!controller)
+			{
+				fprintf(stderr, "*** No controller called %s\n", argv[i + 1]);
+				return 1;
+			}
+			if (argv[i][3] == '1')
+			{
+				host.controller = controller;
+			}
+			else
+			{
+				join.controller = controller;
+			}
+			i++;
+		}
+		else
+		{
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (seconds <= 0.0 || faults.latencyMs < 0 || faults.jitterMs < 0 || faults.lossPercent < 0 || faults.lossPercent > 100)
+	{
+		fprintf(stderr, "*** Seconds must be positive, latency and jitter not negative, and loss 0 to 100\n");
+		return 1;
+	}
+
+	if (pong_rollback_host(&host.rb, 0, &faults, &config, RWGMode, 1) != 0
+		|| pong_rollback_join(&join.rb, "127.0.0.1", pong_net_port(&host.rb.net), &faults) != 0)
+	{
+		fprintf(stderr, "*** Failed to open a loopback UDP socket\n");
+		return 1;
+	}
+	pong_ai_init(&host.ai, 1, 1, 1);
+	pong_ai_init(&join.ai, 2, 1, 2);
+
+	start = pong_clock_seconds();
+	for (;;)
+	{
+		int hostReady = pong_rollback_connect(&host.rb);
+		int joinReady = pong_rollback_connect(&join.rb);
+
+		if (hostReady && joinReady)
+		{
+			break;
+		}
+		if (pong_clock_seconds() - start > CONNECT_TIMEOUT)
+		{
+			fprintf(stderr, "*** The two sides never connected\n");
+			return 1;
+		}
+		pong_sleep_ms(1);
+	}
+
+	printf("%s vs %s, %s mode, %s physics, %d ms latency + up to %d ms jitter each way, %d%% loss, %.0f s\n\n",
+		host.controller->name, join.controller->name, RWGMode ? "RWG" : "classic",
+		config.physics == PONG_PHYSICS_SWEPT ? "swept" : "classic",
+		faults.latencyMs, faults.jitterMs, faults.lossPercent, seconds);
+
+	// both sides tick at the tick rate, each on its own schedule
+	step = 1.0 / config.tickRate;
+	start = next = pong_clock_seconds();
+	while (next - start < seconds && !host.gone && !join.gone)
+	{
+		while (pong_clock_seconds() < next)
+		{
+			pong_sleep_ms(1);
+		}
+		tick(&host);
+		tick(&join);
+		next += step;
+	}
+
+	// a quiet second for the last packets, so the final checksums get compared
+	for (int i = 0; i < config.tickRate; i++)
+	{
+		unsigned int events;
+
+		pong_rollback_tick(&host.rb, 0, &events);
+		pong_rollback_tick(&join.rb, 0, &events);
+		pong_sleep_ms(1000 / config.tickRate);
+	}
+
+	printf("side   frames rollbacks  avg frames max depth  stalls  waits  checks  desyncs dropped\n");
+	print_side("host", &host);
+	print_side("join", &join);
+	printf("\nscore %d-%d\n", host.rb.match.p1Score, host.rb.match.p2Score);
+
+	pong_rollback_close(&host.rb);
+	pong_rollback_close(&join.rb);
+
+	if (host.gone || join.gone)
+	{
+		printf("*** A side stopped hearing from the other\n");
+		return 1;
+	}
+	if (host.rb.stats.checksFailed > 0 || join.rb.stats.checksFailed > 0)
+	{
+		printf("*** The two sides played different matches\n");
+
+		// both sides keep their state from the first frame that disagreed
+		if (host.rb.desyncFrame >= 0 && host.rb.desyncFrame == join.rb.desyncFrame)
+		{
+			printf("\nafter frame %d:\n  %-20s %12s %12s\n", host.rb.desyncFrame, "", "host", "join");
+			for (int i = 0; i < PONG_SIM_STATE_FIELDS; i++)
+			{
+				printf("%c %-20s %12d %12d\n", host.rb.desyncState[i] != join.rb.desyncState[i] ? '*' : ' ',
+					pong_sim_state_names[i], (int)host.rb.desyncState[i], (int)join.rb.desyncState[i]);
+			}
+		}
+		return 1;
+	}
+	if (host.rb.stats.checksOk == 0 || join.rb.stats.checksOk == 0)
+	{
+		printf("*** No checksums were compared\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,128 @@
+/*
+	Program: PONG
+	Tool: rallies
+
+	Summarises rally files written by tournament --rallies, a chunk at a
+	time so files of any size read in one pass at disk speed: rally
+	lengths, ball speeds and colour switches, split by which side the serve
+	went to, and how often the player served at wins the point.
+
+	usage: rallies FILE ...
+*/
+
+#include <stdio.h>  // standard input/output
+#include <stdlib.h> // malloc()
+
+#include "pong_rally.h"
+#include "pong_thread.h" // pong_clock_seconds()
+
+// one row of the summary
+typedef struct Totals
+{
+	long long rallies;
+	long long hits;
+	long long ticks;
+	long long switches;
+	double peakSpeed;		// pixels per tick, summed
+	long long receiverWon;	// the player the ball was served at took the point
+	long long finished;		// scored, not abandoned
+	int longestHits;
+	unsigned int longestTicks;
+} Totals;
+
+static void add(Totals* t, const PongRallyChunk* c, int i)
+{
+	int receiver = c->serveDir[i] > 0 ? 2 : 1;
+
+	t->rallies++;
+	t->hits += c->hits[i];
+	t->ticks += c->ticks[i];
+	t->switches += c->p1Switches[i] + c->p2Switches[i];
+	t->peakSpeed += (double)c->peakSpeedX[i] / PONG_FIXED_ONE;
+	if (c->scorer[i] != 0)
+	{
+		t->finished++;
+		t->receiverWon += c->scorer[i] == receiver;
+	}
+	if (c->hits[i] > t->longestHits)
+	{
+		t->longestHits = c->hits[i];
+	}
+	if (c->ticks[i] > t->longestTicks)
+	{
+		t->longestTicks = c->ticks[i];
+	}
+}
+
+static void print_row(const char* name, const Totals* t)
+{
+	double n = t->rallies ? (double)t->rallies : 1.0;
+
+	printf("%-12s %12lld %9.2f %9.1f %9.2f %9.3f %8.1f %10d %10u\n", name, t->rallies,
+		t->hits / n, t->ticks / n, t->peakSpeed / n, t->switches / n,
+		t->finished ? 100.0 * t->receiverWon / t->finished : 0.0, t->longestHits, t->longestTicks);
+}
+
+int main(int argc, char** argv)
+{
+	PongRallyChunk* chunk = (PongRallyChunk*)malloc(sizeof(PongRallyChunk));
+	int failed = 0;
+
+	if (argc < 2 || argv[1][0] == '-')
+	{
+		fprintf(stderr, "usage: %s FILE ...\n", argv[0]);
+		return 1;
+	}
+	if (!chunk)
+	{
+		fprintf(stderr, "*** Out of memory\n");
+		return 1;
+	}
+
+	for (int f = 1; f < argc; f++)
+	{
+		PongRallyReader reader;
+		Totals all = { 0 }, towardsP1 = { 0 }, towardsP2 = { 0 };
+		long long abandoned = 0;
+		int chunks = 0;
+		int rows;
+		double start, elapsed;
+
+		if (pong_rally_reader_open(&reader, argv[f]) != 0)
+		{
+			fprintf(stderr, "*** %s is not a rally file\n", argv[f]);
+			failed = 1;
+			continue;
+		}
+
+		start = pong_clock_seconds();
+		while ((rows = pong_rally_reader_next(&reader, chunk)) > 0)
+		{
+			for (int i = 0; i < rows; i++)
+			{
+				add(&all, chunk, i);
+				add(chunk->serveDir[i] > 0 ? &towardsP2 : &towardsP1, chunk, i);
+				abandoned += chunk->scorer[i] == 0;
+			}
+			chunks++;
+		}
+		elapsed = pong_clock_seconds() - start;
+		pong_rally_reader_close(&reader);
+		if (rows < 0)
+		{
+			fprintf(stderr, "*** %s is cut short after %d chunks\n", argv[f], chunks);
+			failed = 1;
+		}
+
+		printf("%s: %lld rallies in %d chunks, %lld abandoned, read in %.2f s (%.1f M rallies per second)\n\n", argv[f],
+			all.rallies, chunks, abandoned, elapsed, all.rallies / (elapsed > 0 ? elapsed : 1e-9) / 1e6);
+		printf("%-12s %12s %9s %9s %9s %9s %8s %10s %10s\n", "served at", "rallies", "hits", "ticks", "peak x", "switches", "recv %", "most hits", "most ticks");
+		print_row("P1", &towardsP1);
+		print_row("P2", &towardsP2);
+		print_row("all", &all);
+		printf("\n");
+	}
+
+	free(chunk);
+	return failed;
+}
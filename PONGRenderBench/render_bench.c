@@ -0,0 +1,196 @@
+/*
+	Program: PONG
+	Tool: render_bench
+
+	Headless drawing benchmark. Plays a fixed stretch of an RWG game once,
+	then draws those states over and over through the game's own
+	pong_render_frame, with SDL's software renderer into an offscreen
+	surface. No window, display or GPU is needed, so it runs on CI.
+	The playfield keeps its 640x480 and is scaled to each output size.
+	Reports frames per second and draw calls per frame at each size.
+
+	usage: render_bench [--frames N] [--size WxH ...] [--no-scanlines]
+	                    [--max-draw-calls N]
+*/
+
+#include <SDL.h>
+#include <stdio.h>  // standard input/output
+#include <stdlib.h> // atoi()
+#include <string.h> // strcmp()
+
+#include "pong_sim.h"
+#include "pong_ai.h"
+#include "pong_render.h"
+
+#define STATE_COUNT 600		// ten seconds of play, drawn in a loop
+#define MAX_SIZES 8
+
+typedef struct Size
+{
+	int w, h;
+} Size;
+
+//
+// plays RWG against the built-in AI with a tracker on the left, so paddles,
+// ball, colours and score all change
+//
+static void make_states(const PongConfig* config, PongMatch* states)
+{
+	const PongController* tracker = pong_controller_find("tracker");
+	PongAIState ai;
+	PongMatch match;
+
+	pong_sim_init(&match, config);
+	pong_sim_seed(&match, 1, 0);
+	pong_ai_init(&ai, 1, 1, 1);
+
+	for (int i = 0; i < STATE_COUNT; i++)
+	{
+		PongInput input = tracker->think(&ai, &match);
+
+		if (!match.gameOn)
+		{
+			input |= PONG_INPUT_MODE_3;
+		}
+		else if (!match.ballInPlay)
+		{
+			input |= PONG_INPUT_SERVE;
+		}
+		pong_sim_step(&match, input);
+		states[i] = match;
+	}
+}
+
+//
+// draws frames frames at one size, returns draw calls per frame or -1 if the renderer couldn't be made
+//
+static double bench_size(Size size, int frames, int scanlines, double* fps)
+{
+	static PongMatch states[STATE_COUNT];
+	PongConfig config;
+	SDL_Surface* surface;
+	SDL_Renderer* renderer;
+	PongRenderer view;
+	Uint64 start, elapsed;
+	int drawCalls;
+
+	pong_config_default(&config);
+	make_states(&config, states);
+
+	surface = SDL_CreateRGBSurface(0, size.w, size.h, 32, 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000);
+	if (!surface)
+	{
+		return -1.0;
+	}
+	renderer = SDL_CreateSoftwareRenderer(surface);
+	if (!renderer)
+	{
+		SDL_FreeSurface(surface);
+		return -1.0;
+	}
+	pong_render_init(&view, renderer);
+
+	// one untimed pass grows the vertex buffer, like the first frames of a game
+	for (int i = 1; i < STATE_COUNT; i++)
+	{
+		pong_render_frame(&view, &states[i - 1], &states[i], 0.5, scanlines);
+	}
+	view.drawCalls = 0;
+
+	start = SDL_GetPerformanceCounter();
+	for (int f = 0; f < frames; f++)
+	{
+		int i = f % (STATE_COUNT - 1) + 1;
+
+		pong_render_frame(&view, &states[i - 1], &states[i], 0.5, scanlines);
+		SDL_RenderPresent(renderer);
+	}
+	elapsed = SDL_GetPerformanceCounter() - start;
+
+	*fps = elapsed > 0 ? frames * (double)SDL_GetPerformanceFrequency() / elapsed : 0.0;
+	drawCalls = view.drawCalls;
+
+	pong_render_destroy(&view);
+	SDL_DestroyRenderer(renderer);
+	SDL_FreeSurface(surface);
+
+	return (double)drawCalls / frames;
+}
+
+int main(int argc, char** argv)
+{
+	Size sizes[MAX_SIZES] = { { 640, 480 }, { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+	int sizeCount = 4;
+	int customSizes = 0;
+	int frames = 2000;
+	int scanlines = 1;
+	double maxDrawCalls = 0.0;	// 0 = don't check
+	int failed = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		Size size;
+
+		if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+		{
+			frames = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc && customSizes < MAX_SIZES
+			&& sscanf(argv[i + 1], "%dx%d", &size.w, &size.h) == 2 && size.w > 0 && size.h > 0)
+		{
+			sizes[customSizes++] = size;
+			sizeCount = customSizes;
+			i++;
+		}
+		else if (strcmp(argv[i], "--no-scanlines") == 0)
+		{
+			scanlines = -1;
+		}
+		else if (strcmp(argv[i], "--max-draw-calls") == 0 && i + 1 < argc)
+		{
+			maxDrawCalls = atof(argv[++i]);
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s [--frames N] [--size WxH ...] [--no-scanlines] [--max-draw-calls N]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (frames <= 0)
+	{
+		fprintf(stderr, "*** Frame count must be positive\n");
+		return 1;
+	}
+
+	// the software renderer draws into memory, no video subsystem needed
+	if (SDL_Init(0) < 0)
+	{
+		fprintf(stderr, "*** Failed to initialize SDL: %s\n", SDL_GetError());
+		return 1;
+	}
+
+	printf("software renderer, %d frames per size, scanlines %s\n\n", frames, scanlines == 1 ? "on" : "off");
+	printf("size            fps   ms/frame  draws/frame\n");
+	for (int i = 0; i < sizeCount; i++)
+	{
+		double fps = 0.0;
+		double draws = bench_size(sizes[i], frames, scanlines, &fps);
+
+		if (draws < 0.0)
+		{
+			fprintf(stderr, "*** Failed to create a %dx%d software renderer: %s\n", sizes[i].w, sizes[i].h, SDL_GetError());
+			failed = 1;
+			continue;
+		}
+		printf("%4dx%-4d  %9.0f  %9.3f  %11.2f\n", sizes[i].w, sizes[i].h, fps, fps > 0.0 ? 1000.0 / fps : 0.0, draws);
+
+		if (maxDrawCalls > 0.0 && draws > maxDrawCalls)
+		{
+			printf("*** %.2f draw calls per frame, more than the allowed %.2f\n", draws, maxDrawCalls);
+			failed = 1;
+		}
+	}
+
+	SDL_Quit();
+	return failed;
+}
@@ -0,0 +1,155 @@
+/*
+	Program: PONG
+	Tool: replay
+
+	Plays recordings made with PONG --record back headless, as fast as the
+	simulation goes, and checks that each one still ends on the score it
+	was recorded with. A physics change that alters any recorded match
+	shows up here as a MISMATCH. To watch one instead, run PONG --replay FILE.
+
+	Recordings keep the whole match state every --check-every ticks and a
+	checksum of it after every tick. The first checkpoint this build plays
+	differently is printed side by side with the recording, and the ticks
+	since the one before are stepped again against the checksums to name
+	the exact tick the drift started. Recordings without checksums only
+	pin it down to the checkpoint, which is then an upper bound.
+
+	usage: replay [--repeat N] FILE ...
+*/
+
+#include <stdio.h>  // standard input/output
+#include <stdlib.h> // atoi()
+#include <string.h> // strcmp()
+
+#include "pong_replay.h"
+#include "pong_thread.h" // pong_clock_seconds()
+
+// the recorded state and this build's, differences marked with a *
+static void print_states(const int32_t* recorded, const int32_t* played)
+{
+	printf("  %-20s %12s %12s\n", "", "recorded", "played");
+	for (int i = 0; i < PONG_SIM_STATE_FIELDS; i++)
+	{
+		printf("%c %-20s %12d %12d\n", recorded[i] != played[i] ? '*' : ' ', pong_sim_state_names[i], (int)recorded[i], (int)played[i]);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int repeat = 1;		// plays each file this many times, for steadier timings
+	int files = 0;
+	int failed = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+		{
+			repeat = atoi(argv[++i]);
+		}
+		else if (argv[i][0] == '-')
+		{
+			fprintf(stderr, "usage: %s [--repeat N] FILE ...\n", argv[0]);
+			return 1;
+		}
+	}
+	if (repeat < 1)
+	{
+		fprintf(stderr, "*** Repeat count must be positive\n");
+		return 1;
+	}
+
+	for (int i = 1; i < argc; i++)
+	{
+		PongReplay replay;
+		PongMatch match;
+		PongReplayCheck check;
+		double start, elapsed;
+		int result = 0;
+
+		if (strcmp(argv[i], "--repeat") == 0)
+		{
+			i++;
+			continue;
+		}
+		files++;
+
+		if (pong_replay_load(&replay, argv[i]) != 0)
+		{
+			printf("%s: *** not a readable recording\n", argv[i]);
+			failed++;
+			continue;
+		}
+
+		start = pong_clock_seconds();
+		for (int r = 0; r < repeat; r++)
+		{
+			pong_replay_verify(&replay, &match, &check);
+			result |= check.checkpoint >= 0 || check.tick == 0 || !check.scoreMatched;
+		}
+		elapsed = pong_clock_seconds() - start;
+
+		if (check.checkpoint < 0 && check.tick == 0)
+		{
+			int32_t recorded[PONG_SIM_STATE_FIELDS];
+			int32_t played[PONG_SIM_STATE_FIELDS];
+
+			printf("%s: %d ticks, MISMATCH: differs before the first tick\n", argv[i], replay.tickCount);
+			pong_replay_start_state(&replay, recorded);
+			pong_sim_state(&match, played);
+			print_states(recorded, played);
+		}
+		else if (check.checkpoint >= 0)
+		{
+			int32_t recorded[PONG_SIM_STATE_FIELDS];
+			int32_t played[PONG_SIM_STATE_FIELDS];
+			int tick = (check.checkpoint + 1) * replay.checkEvery;
+
+			if (check.tick >= 0)
+			{
+				printf("%s: %d ticks, MISMATCH: first differs after tick %d, state at checkpoint tick %d (%d of %d checkpoints matched)\n", argv[i],
+					replay.tickCount, check.tick, tick, check.checked, replay.checkCount);
+			}
+			else
+			{
+				printf("%s: %d ticks, MISMATCH: drifted after tick %d, by tick %d (%d of %d checkpoints matched)\n", argv[i], replay.tickCount,
+					tick - replay.checkEvery, tick, check.checked, replay.checkCount);
+				if (replay.checkEvery > 1)
+				{
+					printf("  tick %d is only an upper bound: the recording has no checksums this build can compare per tick\n", tick);
+				}
+			}
+			pong_replay_checkpoint(&replay, check.checkpoint, recorded);
+			pong_sim_state(&match, played);
+			print_states(recorded, played);
+		}
+		else
+		{
+			printf("%s: %d ticks, %d-%d, recorded %d-%d, %d checkpoints, %s", argv[i], replay.tickCount,
+				match.p1Score, match.p2Score, replay.p1Score, replay.p2Score, check.checked, result == 0 ? "OK" : "MISMATCH");
+			if (elapsed > 0.0 && replay.tickRate > 0)
+			{
+				printf(" (%.0fx real time)", (double)replay.tickCount * repeat / replay.tickRate / elapsed);
+			}
+			printf("\n");
+		}
+
+		if (result != 0)
+		{
+			failed++;
+		}
+		pong_replay_free(&replay);
+	}
+
+	if (files == 0)
+	{
+		fprintf(stderr, "usage: %s [--repeat N] FILE ...\n", argv[0]);
+		return 1;
+	}
+	if (failed > 0)
+	{
+		printf("%d of %d recordings failed\n", failed, files);
+		return 1;
+	}
+
+	return 0;
+}
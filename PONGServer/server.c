@@ -0,0 +1,595 @@
+/*
+	Program: PONG
+	Tool: server
+
+	Dedicated server hosting many matches at once, for Linux. One worker
+	thread per core, each pinned to its core with its own pool of matches
+	(pong_server), its own UDP socket on the shared port (SO_REUSEPORT, so
+	the kernel keeps every client on one worker) and one epoll loop that
+	waits on that socket and a timerfd ticking at the tick rate. A worker
+	never touches another worker's matches, so nothing is locked.
+
+	Every tick a worker plays all its matches and sends each player the
+	new state, batched through sendmmsg; packets come in through recvmmsg.
+	Once a second the main thread prints what the workers are doing.
+	PONGLoadGen drives it with simulated players.
+
+	usage: server [--port N] [--threads N] [--capacity N] [--seconds N]
+	              [--seed N] [--tick-rate N] [--profile FILE]
+*/
+
+#define _GNU_SOURCE // recvmmsg(), sendmmsg(), CPU_SET()
+
+#include <errno.h>  // EAGAIN
+#include <sched.h>  // sched_setaffinity()
+#include <signal.h> // signal()
+#include <stdio.h>  // standard input/output
+#include <stdlib.h> // atoi(), calloc()
+#include <string.h> // strcmp(), memcpy()
+#include <time.h>   // time()
+
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "pong_server.h"
+#include "pong_profile.h"
+#include "pong_thread.h"
+
+#define BATCH 64			// packets per recvmmsg / sendmmsg
+#define MAX_CATCH_UP 4		// ticks played back to back after a stall, any more are skipped
+#define SOCKET_BUFFER (4 * 1024 * 1024)
+
+typedef struct Server Server;
+
+typedef struct Worker
+{
+	Server* server;
+	int index;
+	int socket;
+	int timer;
+	int epoll;
+	PongThread* thread;
+	PongServerPool pool;
+
+	// packets waiting for the next sendmmsg
+	struct mmsghdr out[BATCH];
+	struct iovec outParts[BATCH];
+	struct sockaddr_in outAddresses[BATCH];
+	unsigned char outData[BATCH][PONG_SERVER_MAX_PACKET];
+	int outCount;
+
+	// written by the worker only, read by the main thread once a second
+	volatile long ticks;
+	volatile long skipped;		// ticks dropped after a stall
+	volatile long packetsIn;
+	volatile long packetsOut;
+	volatile long sendFailed;
+	volatile long started;		// matches
+	volatile long ended;
+	volatile long live;
+	volatile long tickMicros;	// time spent playing ticks and sending states
+	volatile long worstTickMicros;
+	char padding[64];
+} Worker;
+
+struct Server
+{
+	int port;
+	int threads;
+	int capacity;				// matches per worker
+	PongConfig config;
+	unsigned int seed;
+	volatile int stop;
+	Worker* workers;
+};
+
+static volatile int interrupted = 0;
+
+static void on_interrupt(int signal)
+{
+	(void)signal;
+	interrupted = 1;
+}
+
+//
+// sending
+//
+static void flush(Worker* w)
+{
+	int sent = 0;
+
+	while (sent < w->outCount)
+	{
+		int n = sendmmsg(w->socket, w->out + sent, w->outCount - sent, 0);
+
+		if (n <= 0)
+		{
+			// a full send buffer drops the rest, the next tick sends newer states anyway
+			w->sendFailed += w->outCount - sent;
+			break;
+		}
+		sent += n;
+	}
+	w->packetsOut += sent;
+	w->outCount = 0;
+}
+
+// sent with the next flush
+static void queue(Worker* w, const unsigned char* address, const unsigned char* packet, int size)
+{
+	int i;
+
+	if (w->outCount == BATCH)
+	{
+		flush(w);
+	}
+	i = w->outCount++;
+	memcpy(&w->outAddresses[i], address, sizeof(w->outAddresses[i]));
+	memcpy(w->outData[i], packet, size);
+	w->outParts[i].iov_base = w->outData[i];
+	w->outParts[i].iov_len = size;
+	memset(&w->out[i].msg_hdr, 0, sizeof(w->out[i].msg_hdr));
+	w->out[i].msg_hdr.msg_name = &w->outAddresses[i];
+	w->out[i].msg_hdr.msg_namelen = sizeof(w->outAddresses[i]);
+	w->out[i].msg_hdr.msg_iov = &w->outParts[i];
+	w->out[i].msg_hdr.msg_iovlen = 1;
+}
+
+static void send_state(Worker* w, const PongServerMatch* m, int player, int flags)
+{
+	unsigned char packet[PONG_SERVER_MAX_PACKET];
+
+	queue(w, m->peers[player - 1].address, packet, pong_server_write_state(packet, m, player, flags));
+}
+
+// tells whoever is still connected that the match is over and frees it
+static void end_match(Worker* w, PongServerMatch* m)
+{
+	int flags = pong_server_flags(m) | PONG_SERVER_OVER;
+
+	for (int p = 1; p <= 2; p++)
+	{
+		if (m->peers[p - 1].connected)
+		{
+			send_state(w, m, p, flags & ~PONG_SERVER_WAITING);
+		}
+	}
+	pong_server_release(&w->pool, m);
+	w->ended++;
+}
+
+//
+// receiving
+//
+
+// the packet came from the player it claims to be from
+static int from_player(const PongServerMatch* m, int player, const struct sockaddr_in* from)
+{
+	return m->peers[player - 1].connected && memcmp(m->peers[player - 1].address, from, sizeof(*from)) == 0;
+}
+
+static void handle(Worker* w, const unsigned char* data, int size, const struct sockaddr_in* from, double now)
+{
+	PongServerPacket packet;
+	PongServerMatch* m;
+	int player;
+
+	switch (pong_server_read(&packet, data, size)) {
+	case PONG_SERVER_JOIN:
+		{
+			int live = w->pool.live;
+
+			m = pong_server_join(&w->pool, (const unsigned char*)from, packet.mode, &player, now);
+			if (m)
+			{
+				unsigned char reply[PONG_SERVER_MAX_PACKET];
+
+				queue(w, (const unsigned char*)from, reply, pong_server_write_welcome(reply, m->id, player));
+				w->started += w->pool.live - live;
+			}
+		}
+		break;
+	case PONG_SERVER_INPUT:
+		m = pong_server_find(&w->pool, packet.match);
+		if (m && from_player(m, packet.player, from))
+		{
+			pong_server_input(m, packet.player, packet.keys, packet.clientTime, now);
+		}
+		break;
+	case PONG_SERVER_LEAVE:
+		m = pong_server_find(&w->pool, packet.match);
+		if (m && from_player(m, packet.player, from))
+		{
+			m->peers[packet.player - 1].connected = 0;
+			end_match(w, m);
+		}
+		break;
+	}
+}
+
+static void receive_all(Worker* w)
+{
+	struct mmsghdr in[BATCH];
+	struct iovec parts[BATCH];
+	struct sockaddr_in addresses[BATCH];
+	unsigned char data[BATCH][PONG_SERVER_MAX_PACKET];
+	double now = pong_clock_seconds();
+	int n;
+
+	do
+	{
+		for (int i = 0; i < BATCH; i++)
+		{
+			parts[i].iov_base = data[i];
+			parts[i].iov_len = sizeof(data[i]);
+			memset(&in[i].msg_hdr, 0, sizeof(in[i].msg_hdr));
+			in[i].msg_hdr.msg_name = &addresses[i];
+			in[i].msg_hdr.msg_namelen = sizeof(addresses[i]);
+			in[i].msg_hdr.msg_iov = &parts[i];
+			in[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		n = recvmmsg(w->socket, in, BATCH, MSG_DONTWAIT, NULL);
+		for (int i = 0; i < n; i++)
+		{
+			if (in[i].msg_hdr.msg_namelen == sizeof(addresses[i]))
+			{
+				// addresses are compared byte for byte, sin_zero included
+				memset(addresses[i].sin_zero, 0, sizeof(addresses[i].sin_zero));
+				handle(w, data[i], (int)in[i].msg_len, &addresses[i], now);
+			}
+		}
+		if (n > 0)
+		{
+			w->packetsIn += n;
+		}
+	} while (n == BATCH);
+
+	flush(w);
+}
+
+//
+// ticking
+//
+static void tick_all(Worker* w)
+{
+	double start = pong_clock_seconds();
+	long micros;
+
+	for (int i = 0; i < w->pool.capacity; i++)
+	{
+		PongServerMatch* m = &w->pool.matches[i];
+		int flags;
+		int gone = 0;
+
+		if (!m->live)
+		{
+			continue;
+		}
+
+		// a player who stopped sending has left, and the match ends with them
+		for (int p = 0; p < 2; p++)
+		{
+			if (m->peers[p].connected && start - m->peers[p].lastHeard > PONG_SERVER_TIMEOUT)
+			{
+				m->peers[p].connected = 0;
+				gone = 1;
+			}
+		}
+		if (gone)
+		{
+			end_match(w, m);
+			continue;
+		}
+
+		pong_server_tick(m);
+		flags = pong_server_flags(m);
+		for (int p = 1; p <= 2; p++)
+		{
+			if (m->peers[p - 1].connected)
+			{
+				send_state(w, m, p, flags);
+			}
+		}
+		if (flags & PONG_SERVER_OVER)
+		{
+			pong_server_release(&w->pool, m);
+			w->ended++;
+		}
+	}
+	flush(w);
+
+	w->ticks++;
+	w->live = w->pool.live;
+	micros = (long)((pong_clock_seconds() - start) * 1e6);
+	w->tickMicros += micros;
+	if (micros > w->worstTickMicros)
+	{
+		w->worstTickMicros = micros;
+	}
+}
+
+static int run_worker(void* data)
+{
+	Worker* w = (Worker*)data;
+	struct epoll_event events[2];
+	cpu_set_t cpus;
+
+	// one worker per core, and it stays there
+	CPU_ZERO(&cpus);
+	CPU_SET(w->index % pong_cpu_count(), &cpus);
+	sched_setaffinity(0, sizeof(cpus), &cpus);
+
+	while (!w->server->stop)
+	{
+		int n = epoll_wait(w->epoll, events, 2, 100);
+
+		for (int i = 0; i < n; i++)
+		{
+			if (events[i].data.fd == w->timer)
+			{
+				uint64_t expirations = 0;
+
+				if (read(w->timer, &expirations, sizeof(expirations)) == sizeof(expirations))
+				{
+					uint64_t play = expirations < MAX_CATCH_UP ? expirations : MAX_CATCH_UP;
+
+					w->skipped += (long)(expirations - play);
+					for (uint64_t t = 0; t < play; t++)
+					{
+						tick_all(w);
+					}
+				}
+			}
+			else
+			{
+				receive_all(w);
+			}
+		}
+	}
+	return 0;
+}
+
+// socket, timer and epoll for one worker, -1 on failure
+static int open_worker(Server* s, Worker* w)
+{
+	struct sockaddr_in address;
+	struct itimerspec interval;
+	struct epoll_event event;
+	int on = 1;
+	int buffer = SOCKET_BUFFER;
+	long long nanos = 1000000000LL / s->config.tickRate;
+
+	w->socket = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, IPPROTO_UDP);
+	w->timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+	w->epoll = epoll_create1(0);
+	if (w->socket < 0 || w->timer < 0 || w->epoll < 0)
+	{
+		return -1;
+	}
+
+	// every worker binds the same port, the kernel spreads clients over them
+	setsockopt(w->socket, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+	setsockopt(w->socket, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+	setsockopt(w->socket, SOL_SOCKET, SO_SNDBUF, &buffer, sizeof(buffer));
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons((unsigned short)s->port);
+	if (bind(w->socket, (struct sockaddr*)&address, sizeof(address)) != 0)
+	{
+		return -1;
+	}
+
+	memset(&interval, 0, sizeof(interval));
+	interval.it_interval.tv_sec = (time_t)(nanos / 1000000000LL);
+	interval.it_interval.tv_nsec = (long)(nanos % 1000000000LL);
+	interval.it_value = interval.it_interval;
+	if (timerfd_settime(w->timer, 0, &interval, NULL) != 0)
+	{
+		return -1;
+	}
+
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.fd = w->socket;
+	if (epoll_ctl(w->epoll, EPOLL_CTL_ADD, w->socket, &event) != 0)
+	{
+		return -1;
+	}
+	event.data.fd = w->timer;
+	if (epoll_ctl(w->epoll, EPOLL_CTL_ADD, w->timer, &event) != 0)
+	{
+		return -1;
+	}
+
+	// pools on different workers play on different streams of the seed
+	return pong_server_pool_init(&w->pool, &s->config, s->seed, (uint64_t)w->index << 32, s->capacity);
+}
+
+static void close_worker(Worker* w)
+{
+	if (w->socket >= 0)
+	{
+		close(w->socket);
+	}
+	if (w->timer >= 0)
+	{
+		close(w->timer);
+	}
+	if (w->epoll >= 0)
+	{
+		close(w->epoll);
+	}
+	pong_server_pool_free(&w->pool);
+}
+
+int main(int argc, char** argv)
+{
+	Server s;
+	int seconds = 0;				// 0 = until interrupted
+	int tickRate = 60;
+	const char* profileFile = NULL;
+	long lastTicks = 0, lastIn = 0, lastOut = 0, lastMicros = 0;
+	double start, next;
+
+	memset(&s, 0, sizeof(s));
+	s.port = 7777;
+	s.threads = pong_cpu_count();
+	s.capacity = 4096;
+	s.seed = (unsigned int)time(NULL);
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--port") == 0 && i + 1 < argc)
+		{
+			s.port = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			s.threads = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--capacity") == 0 && i + 1 < argc)
+		{
+			s.capacity = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+		{
+			seconds = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+		{
+			s.seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc)
+		{
+			tickRate = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+		{
+			profileFile = argv[++i];
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s [--port N] [--threads N] [--capacity N] [--seconds N] [--seed N] [--tick-rate N] [--profile FILE]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (s.port <= 0 || s.port > 65535 || s.threads <= 0 || s.capacity <= 0 || s.capacity > PONG_SERVER_MAX_POOL || seconds < 0 || tickRate <= 0)
+	{
+		fprintf(stderr, "*** --port, --threads, --tick-rate and --capacity (up to %d) must be positive\n", PONG_SERVER_MAX_POOL);
+		return 1;
+	}
+
+	pong_config_default(&s.config);
+	if (profileFile)
+	{
+		int badLine;
+
+		if (pong_profile_load(&s.config, profileFile, &badLine) != 0)
+		{
+			if (badLine < 0)
+			{
+				fprintf(stderr, "*** %s: the paddles or the ball don't fit on the screen\n", profileFile);
+			}
+			else
+			{
+				fprintf(stderr, "*** Failed to read profile %s (line %d)\n", profileFile, badLine);
+			}
+			return 1;
+		}
+	}
+	s.config.tickRate = tickRate;
+
+	s.workers = (Worker*)calloc(s.threads, sizeof(Worker));
+	if (!s.workers)
+	{
+		fprintf(stderr, "*** Out of memory\n");
+		return 1;
+	}
+	for (int i = 0; i < s.threads; i++)
+	{
+		Worker* w = &s.workers[i];
+
+		w->server = &s;
+		w->index = i;
+		w->socket = w->timer = w->epoll = -1;
+		if (open_worker(&s, w) != 0)
+		{
+			fprintf(stderr, "*** Worker %d failed to open port %d\n", i, s.port);
+			return 1;
+		}
+	}
+	for (int i = 0; i < s.threads; i++)
+	{
+		s.workers[i].thread = pong_thread_create(run_worker, &s.workers[i]);
+		if (!s.workers[i].thread)
+		{
+			fprintf(stderr, "*** Failed to start worker %d\n", i);
+			s.stop = 1;
+			return 1;
+		}
+	}
+
+	signal(SIGINT, on_interrupt);
+	printf("serving on port %d, %d workers of %d matches, %d ticks per second, seed %u\n", s.port, s.threads, s.capacity, tickRate, s.seed);
+	fflush(stdout);
+
+	// a line a second until told to stop
+	start = pong_clock_seconds();
+	next = start + 1.0;
+	while (!interrupted && (seconds == 0 || pong_clock_seconds() - start < seconds))
+	{
+		long ticks = 0, in = 0, out = 0, micros = 0, live = 0, worst = 0, skipped = 0, failed = 0;
+
+		pong_sleep_ms(10);
+		if (pong_clock_seconds() < next)
+		{
+			continue;
+		}
+		next += 1.0;
+
+		for (int i = 0; i < s.threads; i++)
+		{
+			Worker* w = &s.workers[i];
+
+			ticks += w->ticks;
+			in += w->packetsIn;
+			out += w->packetsOut;
+			micros += w->tickMicros;
+			live += w->live;
+			skipped += w->skipped;
+			failed += w->sendFailed;
+			if (w->worstTickMicros > worst)
+			{
+				worst = w->worstTickMicros;
+			}
+		}
+		printf("%ld matches, %.1f ticks/s per worker, tick %.2f ms avg %.2f ms worst, %ld in/s, %ld out/s, %ld skipped, %ld send failures\n",
+			live, (double)(ticks - lastTicks) / s.threads, ticks > lastTicks ? (micros - lastMicros) / 1000.0 / (ticks - lastTicks) : 0.0,
+			worst / 1000.0, in - lastIn, out - lastOut, skipped, failed);
+		fflush(stdout);
+		lastTicks = ticks;
+		lastIn = in;
+		lastOut = out;
+		lastMicros = micros;
+	}
+
+	s.stop = 1;
+	for (int i = 0; i < s.threads; i++)
+	{
+		long started, ended;
+
+		pong_thread_join(s.workers[i].thread);
+		started = s.workers[i].started;
+		ended = s.workers[i].ended;
+		printf("worker %d: %ld matches started, %ld ended\n", i, started, ended);
+		close_worker(&s.workers[i]);
+	}
+	free(s.workers);
+
+	return 0;
+}
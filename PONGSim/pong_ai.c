@@ -0,0 +1,402 @@
+/*
+	Program: PONG
+	Module: pong_ai
+*/
+
+#include "pong_ai.h"
+
+#include <string.h> // strcmp()
+
+// the keys and state that belong to the paddle an AI is driving
+typedef struct Side
+{
+	PongInput up, down, right;
+	const PongRect* paddle;
+	const PongPoint* center;
+	int color;
+	int rightLock;
+	int towards;			// ballDirX when the ball is heading at this paddle
+} Side;
+
+static Side side_of(const PongAIState* ai, const PongMatch* m)
+{
+	Side s;
+
+	if (ai->player == 1)
+	{
+		s.up = PONG_INPUT_P1_UP;
+		s.down = PONG_INPUT_P1_DOWN;
+		s.right = PONG_INPUT_P1_RIGHT;
+		s.paddle = &m->p1;
+		s.center = &m->p1Center;
+		s.color = m->p1ColorSetting;
+		s.rightLock = m->p1DColorSwitchLock;
+		s.towards = -1;
+	}
+	else
+	{
+		s.up = PONG_INPUT_P2_UP;
+		s.down = PONG_INPUT_P2_DOWN;
+		s.right = PONG_INPUT_P2_RIGHT;
+		s.paddle = &m->p2;
+		s.center = &m->p2Center;
+		s.color = m->p2ColorSetting;
+		s.rightLock = m->p2RColorSwitchLock;
+		s.towards = 1;
+	}
+
+	return s;
+}
+
+// steps the paddle colour towards the ball's, one key press every other frame
+static PongInput match_color(const Side* s, const PongMatch* m)
+{
+	if (m->RWGMode == 1 && s->color != m->ballColorSetting && s->rightLock == 0)
+	{
+		return s->right;
+	}
+	return 0;
+}
+
+// moves towards y, with a dead zone of one paddle step so it doesn't jitter
+static PongInput move_towards(const Side* s, const PongMatch* m, int y)
+{
+	PongFixed step = pong_tick_speed(&m->config, PONG_FIXED(m->config.paddleSpeed));
+
+	if (y > s->center->y + step)
+	{
+		return s->down;
+	}
+	if (y < s->center->y - step)
+	{
+		return s->up;
+	}
+	return 0;
+}
+
+//
+// chase: the AI from pong_sim_step, mirrored for player 1
+//
+static PongInput think_chase(PongAIState* ai, const PongMatch* m)
+{
+	const PongConfig* c = &m->config;
+	Side s = side_of(ai, m);
+	PongInput input = 0;
+	PongFixed detect = PONG_FIXED(c->scrWidth / c->aiDetectRange);
+	PongFixed half = PONG_FIXED(c->scrWidth / 2);
+	int onMySide = ai->player == 1 ? m->ballCenter.x < PONG_FIXED(c->scrWidth) - detect : m->ballCenter.x > detect;
+	int onMyHalf = ai->player == 1 ? m->ballCenter.x < half : m->ballCenter.x > half;
+
+	if (onMySide && m->ballDirX == s.towards) // if ball on AI side and headed towards AI
+	{
+		input |= move_towards(&s, m, m->ballCenter.y);
+	}
+	if (onMyHalf && m->ballDirX == s.towards)
+	{
+		input |= match_color(&s, m);
+	}
+
+	return input;
+}
+
+//
+// tracker: follows the ball everywhere
+//
+static PongInput think_tracker(PongAIState* ai, const PongMatch* m)
+{
+	Side s = side_of(ai, m);
+
+	return move_towards(&s, m, m->ballCenter.y) | match_color(&s, m);
+}
+
+//
+// random: mashes keys
+//
+static PongInput think_random(PongAIState* ai, const PongMatch* m)
+{
+	Side s = side_of(ai, m);
+	int choice = pong_rng_below(&ai->rng, 24);
+
+	if (choice < 4)
+	{
+		return s.up;
+	}
+	if (choice < 8)
+	{
+		return s.down;
+	}
+	if (choice == 8)
+	{
+		return s.right;
+	}
+	return 0;
+}
+
+//
+// intercept: works out where the ball will meet the paddle, in closed form
+//
+
+// ticks until the ball first overlaps the paddle's column, counting the
+// speed up pong_sim_step applies after the first move following a hit
+static int ticks_to_paddle(const Side* s, const PongMatch* m)
+{
+	const PongConfig* c = &m->config;
+	PongFixed speed = m->ballSpeedX;
+	PongFixed faster = speed + pong_tick_speed(c, c->speedUpStep);
+	PongFixed gap;	// still to travel, the + 1 is the smallest overlap
+
+	if (s->towards == 1)
+	{
+		gap = s->paddle->x + 1 - (m->ball.x + m->ball.w);
+	}
+	else
+	{
+		gap = m->ball.x + 1 - (s->paddle->x + s->paddle->w);
+	}
+
+	if (gap <= 0 || speed <= 0)
+	{
+		return 0;
+	}
+	if (m->ballHits >= c->hitsPerSpeedUp && speed < pong_tick_speed(c, PONG_FIXED(c->ballSpeedCapX)) && gap > speed)
+	{
+		return 1 + (gap - speed + faster - 1) / faster;	// one move at speed, the rest faster
+	}
+	return (gap + speed - 1) / speed;
+}
+
+// ball.y after ticks moves at speedY, bouncing the way pong_sim_step does.
+// classic: a ball that would leave [0, bottom] is put on the wall and turned
+// round, so after the first bounce the path repeats every
+// 2 * (bottom / |speedY| + 1) ticks. swept: walls reflect it exactly, a
+// plain fold with period 2 * bottom
+static PongFixed fold_y(PongFixed y, PongFixed speedY, PongFixed bottom, int ticks, int physics)
+{
+	PongFixed step = speedY < 0 ? -speedY : speedY;
+	int first, leg, phase;
+
+	if (step == 0 || bottom <= 0)
+	{
+		return y;
+	}
+
+	if (physics == PONG_PHYSICS_SWEPT)
+	{
+		long long travel = (long long)y + (long long)speedY * ticks;
+		PongFixed folded = (PongFixed)(((travel % (2 * bottom)) + 2 * bottom) % (2 * bottom));
+
+		return folded <= bottom ? folded : 2 * bottom - folded;
+	}
+
+	first = (speedY > 0 ? bottom - y : y) / step + 1;	// ticks until the first wall
+	if (ticks < first)
+	{
+		return y + ticks * speedY;
+	}
+
+	leg = bottom / step + 1;							// ticks from one wall to the other
+	phase = (ticks - first) % (2 * leg);
+	if (phase < leg)
+	{
+		// leaving the wall it first hit
+		return speedY > 0 ? bottom - phase * step : phase * step;
+	}
+	phase -= leg;
+	return speedY > 0 ? phase * step : bottom - phase * step;
+}
+
+// paddle centre y that meets the ball's centre, or the middle of the
+// screen when the ball isn't coming this way
+static PongFixed intercept_y(const Side* s, const PongMatch* m)
+{
+	const PongConfig* c = &m->config;
+	int ticks;
+
+	if (!m->ballInPlay || m->ballDirX != s->towards)
+	{
+		return PONG_FIXED(c->scrHeight / 2);
+	}
+
+	ticks = ticks_to_paddle(s, m);
+	return fold_y(m->ball.y, m->ballSpeedY, PONG_FIXED(c->scrHeight) - m->ball.h, ticks, c->physics) + PONG_FIXED(c->ballSize / 2);
+}
+
+// the ball only changes velocity on a hit, a wall, a serve or a point, so
+// the intercept is worked out then and followed until the next change.
+// reactionDelay (in 1/60 s) passes before it notices a change, and each
+// approach is aimed up to aimError pixels off
+static PongInput intercept(PongAIState* ai, const PongMatch* m, int reactionDelay, int aimError)
+{
+	Side s = side_of(ai, m);
+
+	if (m->ballSpeedX != ai->seenSpeedX || m->ballSpeedY != ai->seenSpeedY
+		|| m->ballDirX != ai->seenDirX || m->ballInPlay != ai->seenInPlay)
+	{
+		if (m->ballDirX != ai->seenDirX || m->ballInPlay != ai->seenInPlay)
+		{
+			ai->aimError = aimError > 0 ? PONG_FIXED(pong_rng_below(&ai->rng, 2 * aimError + 1) - aimError) : 0;
+		}
+		ai->seenSpeedX = m->ballSpeedX;
+		ai->seenSpeedY = m->ballSpeedY;
+		ai->seenDirX = m->ballDirX;
+		ai->seenInPlay = m->ballInPlay;
+		if (ai->reactIn < 0)
+		{
+			ai->reactIn = reactionDelay * m->config.tickRate / 60;	// a change while it's still reacting doesn't restart the wait
+		}
+	}
+
+	if (ai->reactIn == 0)
+	{
+		ai->target = intercept_y(&s, m) + ai->aimError;
+	}
+	if (ai->reactIn >= 0)
+	{
+		ai->reactIn--;
+	}
+
+	return move_towards(&s, m, ai->target) | match_color(&s, m);
+}
+
+static PongInput think_intercept(PongAIState* ai, const PongMatch* m)
+{
+	return intercept(ai, m, 0, 0);
+}
+
+static PongInput think_intercept_hard(PongAIState* ai, const PongMatch* m)
+{
+	return intercept(ai, m, 6, 32);
+}
+
+static PongInput think_intercept_medium(PongAIState* ai, const PongMatch* m)
+{
+	return intercept(ai, m, 12, 38);
+}
+
+static PongInput think_intercept_easy(PongAIState* ai, const PongMatch* m)
+{
+	return intercept(ai, m, 20, 50);
+}
+
+//
+// idle: never moves, the floor every other controller should beat
+//
+static PongInput think_idle(PongAIState* ai, const PongMatch* m)
+{
+	(void)ai;
+	(void)m;
+	return 0;
+}
+
+const PongController pong_controllers[] = {
+	{ "chase", "original AI: chases the ball once it crosses the detect range", think_chase },
+	{ "tracker", "follows the ball all the time", think_tracker },
+	{ "random", "presses random keys", think_random },
+	{ "idle", "never moves", think_idle },
+	{ "intercept", "solves where the ball will cross its paddle, reacts at once", think_intercept },
+	{ "intercept-hard", "intercept, 6 ticks to react and up to 32 pixels off", think_intercept_hard },
+	{ "intercept-medium", "intercept, 12 ticks to react and up to 38 pixels off", think_intercept_medium },
+	{ "intercept-easy", "intercept, 20 ticks to react and up to 50 pixels off", think_intercept_easy }
+};
+
+const int pong_controller_count = sizeof(pong_controllers) / sizeof(pong_controllers[0]);
+
+const PongController* pong_controller_find(const char* name)
+{
+	for (int i = 0; i < pong_controller_count; i++)
+	{
+		if (strcmp(pong_controllers[i].name, name) == 0)
+		{
+			return &pong_controllers[i];
+		}
+	}
+	return NULL;
+}
+
+void pong_ai_init(PongAIState* ai, int player, uint64_t seed, uint64_t stream)
+{
+	memset(ai, 0, sizeof(*ai));
+	ai->player = player;
+	ai->seenInPlay = -1;	// so the first think works out a target
+	ai->reactIn = -1;
+	pong_rng_seed(&ai->rng, seed, stream);
+}
+
+void pong_ai_play(const PongConfig* config, const PongController* p1, const PongController* p2, int RWGMode, uint64_t seed, uint64_t stream, int maxFrames, PongMatchResult* result)
+{
+	pong_ai_play_rallies(config, p1, p2, RWGMode, seed, stream, maxFrames, result, NULL, NULL);
+}
+
+void pong_ai_play_rallies(const PongConfig* config, const PongController* p1, const PongController* p2, int RWGMode, uint64_t seed, uint64_t stream, int maxFrames, PongMatchResult* result,
+	PongRallyFn onRally, void* user)
+{
+	PongMatch match;
+	PongAIState ai1, ai2;
+	PongStepFn step;
+	PongRallyTracker tracker;
+	PongRally ended;
+	int rally = 0;
+	unsigned int events;
+
+	memset(result, 0, sizeof(*result));
+	pong_rally_track_reset(&tracker);
+
+	pong_sim_init(&match, config);
+	// three streams per game: the match and each controller
+	pong_sim_seed(&match, seed, stream * 3);
+	pong_ai_init(&ai1, 1, seed, stream * 3 + 1);
+	pong_ai_init(&ai2, 2, seed, stream * 3 + 2);
+
+	// two player mode, both paddles are driven through their keys, unless
+	// the built-in AI has P2
+	if (p2)
+	{
+		pong_sim_step(&match, RWGMode ? PONG_INPUT_MODE_4 : PONG_INPUT_MODE_2);
+	}
+	else
+	{
+		pong_sim_step(&match, RWGMode ? PONG_INPUT_MODE_3 : PONG_INPUT_MODE_1);
+	}
+	step = pong_sim_step_fn(&match);
+
+	while (match.gameOn && result->frames < maxFrames)
+	{
+		PongInput input = p1->think(&ai1, &match) | (p2 ? p2->think(&ai2, &match) : 0);
+
+		if (!match.ballInPlay)
+		{
+			input |= PONG_INPUT_SERVE;
+		}
+
+		events = step(&match, input);
+		result->frames++;
+
+		if (onRally && pong_rally_track(&tracker, &match, events, &ended))
+		{
+			ended.match = (uint32_t)stream;
+			onRally(user, &ended);
+		}
+
+		if (events & (PONG_EVENT_HIT_P1 | PONG_EVENT_HIT_P2))
+		{
+			result->hits++;
+			rally++;
+		}
+		if (events & PONG_EVENT_SCORE)
+		{
+			result->rallies++;
+			if (rally > result->longestRally)
+			{
+				result->longestRally = rally;
+			}
+			rally = 0;
+		}
+	}
+
+	result->p1Score = match.p1Score;
+	result->p2Score = match.p2Score;
+	if (!match.gameOn)
+	{
+		result->winner = match.p1Score >= config->winScore ? 1 : 2;
+	}
+}
@@ -0,0 +1,81 @@
+/*
+	Program: PONG
+	Module: pong_ai
+
+	Computer players that drive a paddle by pressing keys, the same way a
+	person would. Unlike the AI built into pong_sim_step they can play
+	either side, so two of them can face each other in a two player match.
+*/
+
+#ifndef PONG_AI_H
+#define PONG_AI_H
+
+#include "pong_sim.h"
+#include "pong_rally.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// per-paddle memory, zeroed by pong_ai_init
+typedef struct PongAIState
+{
+	int player;				// 1 or 2
+	PongRng rng;			// for controllers that make random choices
+
+	// intercept controllers: the ball velocity last seen, and where the
+	// paddle is headed because of it
+	int seenSpeedX, seenSpeedY, seenDirX, seenInPlay;
+	PongFixed target;		// paddle centre y
+	PongFixed aimError;		// drawn once per approach
+	int reactIn;			// ticks until it acts on a velocity change, -1 when up to date
+} PongAIState;
+
+// returns the held keys (PONG_INPUT_P1_* or PONG_INPUT_P2_*, depending on player) for this frame
+typedef PongInput (*PongAIThink)(PongAIState* ai, const PongMatch* match);
+
+typedef struct PongController
+{
+	const char* name;
+	const char* description;
+	PongAIThink think;
+} PongController;
+
+// every controller, in a fixed order
+extern const PongController pong_controllers[];
+extern const int pong_controller_count;
+
+// NULL if there is no controller with that name
+const PongController* pong_controller_find(const char* name);
+
+void pong_ai_init(PongAIState* ai, int player, uint64_t seed, uint64_t stream);
+
+typedef struct PongMatchResult
+{
+	int winner;				// 1 or 2, 0 if maxFrames ran out first
+	int p1Score;
+	int p2Score;
+	int frames;
+	int rallies;			// points played
+	int hits;				// paddle hits over all rallies
+	int longestRally;		// most paddle hits in one rally
+} PongMatchResult;
+
+// plays one headless game to winScore between two controllers, serving
+// as soon as the ball is dead. p2 can be NULL to play against the AI built
+// into pong_sim instead. The same seed and stream always give the same
+// game, different streams of one seed give independent games
+void pong_ai_play(const PongConfig* config, const PongController* p1, const PongController* p2, int RWGMode, uint64_t seed, uint64_t stream, int maxFrames, PongMatchResult* result);
+
+// called with each rally as it ends, match set to the game's stream
+typedef void (*PongRallyFn)(void* user, const PongRally* rally);
+
+// pong_ai_play, handing every rally to onRally as well
+void pong_ai_play_rallies(const PongConfig* config, const PongController* p1, const PongController* p2, int RWGMode, uint64_t seed, uint64_t stream, int maxFrames, PongMatchResult* result,
+	PongRallyFn onRally, void* user);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
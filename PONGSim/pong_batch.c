@@ -0,0 +1,374 @@
+/*
+	Program: PONG
+	Module: pong_batch
+
+	Structure-of-arrays storage and the per-instruction-set kernels. The
+	kernel body lives in pong_batch_kernel.h and is expanded here once for
+	plain C and once for the widest vector instructions the compiler is
+	allowed to use (-mavx2 or /arch:AVX2 for AVX2, SSE2 on any x64 build).
+	Define PONG_BATCH_NO_SIMD to build the plain C kernel only.
+*/
+
+#include "pong_batch.h"
+
+#include <stdlib.h> // malloc()
+#include <string.h> // memset()
+
+#if !defined(PONG_BATCH_NO_SIMD)
+#if defined(__AVX2__)
+#define PONG_BATCH_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PONG_BATCH_SSE2
+#include <emmintrin.h>
+#endif
+#endif
+
+// number of int arrays carved out of batch->memory, each generator takes the room of four ints
+#define RNG_INTS (sizeof(PongRng) / sizeof(int))
+#define BATCH_ARRAYS (29 + RNG_INTS)
+
+static int* carve(char** cursor, int capacity)
+{
+	int* array = (int*)*cursor;
+	*cursor += capacity * sizeof(int);
+	return array;
+}
+
+int pong_batch_create(PongBatch* batch, const PongConfig* config, int count)
+{
+	PongMatch match;
+	char* cursor;
+	int capacity = (count + PONG_BATCH_ALIGN - 1) / PONG_BATCH_ALIGN * PONG_BATCH_ALIGN;
+	int i;
+
+	memset(batch, 0, sizeof(*batch));
+	batch->memory = malloc(BATCH_ARRAYS * capacity * sizeof(int) + 64);
+	if (!batch->memory)
+	{
+		return -1;
+	}
+	memset(batch->memory, 0, BATCH_ARRAYS * capacity * sizeof(int) + 64);
+
+	batch->config = *config;
+	pong_tick_config(config, &batch->tick);
+	batch->count = count;
+	batch->capacity = capacity;
+
+	// 64 byte alignment for the first array, capacity keeps the rest aligned for AVX2
+	cursor = (char*)batch->memory + (64 - ((size_t)batch->memory & 63));
+
+	batch->input = (PongInput*)carve(&cursor, capacity);
+	batch->events = (unsigned int*)carve(&cursor, capacity);
+	batch->p1Y = carve(&cursor, capacity);
+	batch->p2Y = carve(&cursor, capacity);
+	batch->ballX = carve(&cursor, capacity);
+	batch->ballY = carve(&cursor, capacity);
+	batch->p1CenterY = carve(&cursor, capacity);
+	batch->p2CenterY = carve(&cursor, capacity);
+	batch->ballCenterX = carve(&cursor, capacity);
+	batch->ballCenterY = carve(&cursor, capacity);
+	batch->ballInPlay = carve(&cursor, capacity);
+	batch->gameOn = carve(&cursor, capacity);
+	batch->RWGMode = carve(&cursor, capacity);
+	batch->multiplayer = carve(&cursor, capacity);
+	batch->p1AColorSwitchLock = carve(&cursor, capacity);
+	batch->p1DColorSwitchLock = carve(&cursor, capacity);
+	batch->p2LColorSwitchLock = carve(&cursor, capacity);
+	batch->p2RColorSwitchLock = carve(&cursor, capacity);
+	batch->p1Score = carve(&cursor, capacity);
+	batch->p2Score = carve(&cursor, capacity);
+	batch->p1ColorSetting = carve(&cursor, capacity);
+	batch->p2ColorSetting = carve(&cursor, capacity);
+	batch->ballColorSetting = carve(&cursor, capacity);
+	batch->ballSpeedX = carve(&cursor, capacity);
+	batch->ballSpeedY = carve(&cursor, capacity);
+	batch->ballDirX = carve(&cursor, capacity);
+	batch->aiMovement = carve(&cursor, capacity);
+	batch->ballHits = carve(&cursor, capacity);
+	batch->lastPoint = carve(&cursor, capacity);
+	batch->rng = (PongRng*)carve(&cursor, capacity * RNG_INTS);
+
+	pong_sim_init(&match, config);
+	for (i = 0; i < capacity; i++)
+	{
+		pong_batch_load(batch, i, &match);
+	}
+
+	return 0;
+}
+
+void pong_batch_destroy(PongBatch* batch)
+{
+	free(batch->memory);
+	memset(batch, 0, sizeof(*batch));
+}
+
+void pong_batch_load(PongBatch* batch, int lane, const PongMatch* match)
+{
+	batch->p1Y[lane] = match->p1.y;
+	batch->p2Y[lane] = match->p2.y;
+	batch->ballX[lane] = match->ball.x;
+	batch->ballY[lane] = match->ball.y;
+
+	batch->p1CenterY[lane] = match->p1Center.y;
+	batch->p2CenterY[lane] = match->p2Center.y;
+	batch->ballCenterX[lane] = match->ballCenter.x;
+	batch->ballCenterY[lane] = match->ballCenter.y;
+
+	batch->ballInPlay[lane] = match->ballInPlay;
+	batch->gameOn[lane] = match->gameOn;
+	batch->RWGMode[lane] = match->RWGMode;
+	batch->multiplayer[lane] = match->multiplayer;
+
+	batch->p1AColorSwitchLock[lane] = match->p1AColorSwitchLock;
+	batch->p1DColorSwitchLock[lane] = match->p1DColorSwitchLock;
+	batch->p2LColorSwitchLock[lane] = match->p2LColorSwitchLock;
+	batch->p2RColorSwitchLock[lane] = match->p2RColorSwitchLock;
+
+	batch->p1Score[lane] = match->p1Score;
+	batch->p2Score[lane] = match->p2Score;
+
+	batch->p1ColorSetting[lane] = match->p1ColorSetting;
+	batch->p2ColorSetting[lane] = match->p2ColorSetting;
+	batch->ballColorSetting[lane] = match->ballColorSetting;
+
+	batch->ballSpeedX[lane] = match->ballSpeedX;
+	batch->ballSpeedY[lane] = match->ballSpeedY;
+	batch->ballDirX[lane] = match->ballDirX;
+
+	batch->aiMovement[lane] = match->aiMovement;
+	batch->ballHits[lane] = match->ballHits;
+	batch->lastPoint[lane] = match->lastPoint;
+
+	batch->rng[lane] = match->rng;
+}
+
+void pong_batch_store(const PongBatch* batch, int lane, PongMatch* match)
+{
+	const PongConfig* c = &batch->config;
+
+	match->config = *c;
+	pong_tick_config(c, &match->tick);
+
+	match->p1.x = PONG_FIXED(c->paddleW); // paddle is away from the wall
+	match->p1.y = batch->p1Y[lane];
+	match->p1.w = PONG_FIXED(c->paddleW);
+	match->p1.h = PONG_FIXED(c->paddleH);
+
+	match->p2.x = PONG_FIXED(c->scrWidth - (c->paddleW * 2)); // paddle is away from the wall
+	match->p2.y = batch->p2Y[lane];
+	match->p2.w = PONG_FIXED(c->paddleW);
+	match->p2.h = PONG_FIXED(c->paddleH);
+
+	match->ball.x = batch->ballX[lane];
+	match->ball.y = batch->ballY[lane];
+	match->ball.w = PONG_FIXED(c->ballSize);
+	match->ball.h = PONG_FIXED(c->ballSize);
+
+	match->p1Center.x = match->p1.x + PONG_FIXED(c->paddleW / 2);
+	match->p1Center.y = batch->p1CenterY[lane];
+	match->p2Center.x = match->p2.x + PONG_FIXED(c->paddleW / 2);
+	match->p2Center.y = batch->p2CenterY[lane];
+	match->ballCenter.x = batch->ballCenterX[lane];
+	match->ballCenter.y = batch->ballCenterY[lane];
+
+	match->ballInPlay = batch->ballInPlay[lane];
+	match->gameOn = batch->gameOn[lane];
+	match->RWGMode = batch->RWGMode[lane];
+	match->multiplayer = batch->multiplayer[lane];
+
+	match->p1AColorSwitchLock = batch->p1AColorSwitchLock[lane];
+	match->p1DColorSwitchLock = batch->p1DColorSwitchLock[lane];
+	match->p2LColorSwitchLock = batch->p2LColorSwitchLock[lane];
+	match->p2RColorSwitchLock = batch->p2RColorSwitchLock[lane];
+
+	match->p1Score = batch->p1Score[lane];
+	match->p2Score = batch->p2Score[lane];
+
+	match->p1ColorSetting = batch->p1ColorSetting[lane];
+	match->p2ColorSetting = batch->p2ColorSetting[lane];
+	match->ballColorSetting = batch->ballColorSetting[lane];
+
+	match->ballSpeedX = batch->ballSpeedX[lane];
+	match->ballSpeedY = batch->ballSpeedY[lane];
+	match->ballDirX = batch->ballDirX[lane];
+
+	match->aiMovement = batch->aiMovement[lane];
+	match->ballHits = batch->ballHits[lane];
+	match->lastPoint = batch->lastPoint[lane];
+
+	match->rng = batch->rng[lane];
+}
+
+//
+// scalar fix-ups shared by every kernel
+//
+
+// RWG paddle hits pick a new ball colour, lanes in skip are redone by batch_step_pending
+static void batch_draw_colors(PongBatch* b, int first, int lanes, unsigned int skip)
+{
+	int k;
+
+	for (k = 0; k < lanes; k++)
+	{
+		int i = first + k;
+
+		if ((skip & (1u << k)) == 0 && b->RWGMode[i] == 1 && (b->events[i] & (PONG_EVENT_HIT_P1 | PONG_EVENT_HIT_P2)))
+		{
+			int color = pong_rng_below(&b->rng[i], 3);
+
+			// a point in the same frame resets the colour, but the draw still happened
+			if ((b->events[i] & PONG_EVENT_SCORE) == 0)
+			{
+				b->ballColorSetting[i] = color;
+			}
+		}
+	}
+}
+
+// lanes with a command this frame run the whole frame through pong_sim_step instead
+static void batch_step_pending(PongBatch* b, int first, int lanes, unsigned int commands, PongMatch* pending)
+{
+	int k;
+
+	for (k = 0; k < lanes; k++)
+	{
+		if (commands & (1u << k))
+		{
+			b->events[first + k] = pong_sim_step(&pending[k], b->input[first + k]);
+			pong_batch_load(b, first + k, &pending[k]);
+		}
+	}
+}
+
+//
+// plain C, one lane at a time, masks are 0 or -1
+//
+#define V int
+#define V_LANES 1
+#define V_SET1(a) ((int)(a))
+#define V_LOAD(p) (*(p))
+#define V_STORE(p, a) (*(p) = (a))
+#define V_ADD(a, b) ((a) + (b))
+#define V_SUB(a, b) ((a) - (b))
+#define V_AND(a, b) ((a) & (b))
+#define V_OR(a, b) ((a) | (b))
+#define V_ANDNOT(a, b) (~(a) & (b))
+#define V_CMPEQ(a, b) (-((a) == (b)))
+#define V_CMPGT(a, b) (-((a) > (b)))
+#define V_SELECT(m, a, b) (((m) & (a)) | (~(m) & (b)))
+#define V_ANY(m) ((m) != 0)
+#define PONG_BATCH_KERNEL batch_kernel_scalar
+#define PONG_BATCH_STEP batch_step_scalar
+#include "pong_batch_kernel.h"
+#undef V
+#undef V_LANES
+#undef V_SET1
+#undef V_LOAD
+#undef V_STORE
+#undef V_ADD
+#undef V_SUB
+#undef V_AND
+#undef V_OR
+#undef V_ANDNOT
+#undef V_CMPEQ
+#undef V_CMPGT
+#undef V_SELECT
+#undef V_ANY
+#undef PONG_BATCH_KERNEL
+#undef PONG_BATCH_STEP
+
+#if defined(PONG_BATCH_AVX2)
+//
+// AVX2, eight lanes
+//
+#define V __m256i
+#define V_LANES 8
+#define V_SET1(a) _mm256_set1_epi32(a)
+#define V_LOAD(p) _mm256_load_si256((const __m256i*)(p))
+#define V_STORE(p, a) _mm256_store_si256((__m256i*)(p), a)
+#define V_ADD(a, b) _mm256_add_epi32(a, b)
+#define V_SUB(a, b) _mm256_sub_epi32(a, b)
+#define V_AND(a, b) _mm256_and_si256(a, b)
+#define V_OR(a, b) _mm256_or_si256(a, b)
+#define V_ANDNOT(a, b) _mm256_andnot_si256(a, b)
+#define V_CMPEQ(a, b) _mm256_cmpeq_epi32(a, b)
+#define V_CMPGT(a, b) _mm256_cmpgt_epi32(a, b)
+#define V_SELECT(m, a, b) _mm256_blendv_epi8(b, a, m)
+#define V_ANY(m) (_mm256_movemask_epi8(m) != 0)
+#define PONG_BATCH_KERNEL batch_kernel_simd
+#define PONG_BATCH_STEP batch_step_simd
+#include "pong_batch_kernel.h"
+
+#elif defined(PONG_BATCH_SSE2)
+//
+// SSE2, four lanes
+//
+#define V __m128i
+#define V_LANES 4
+#define V_SET1(a) _mm_set1_epi32(a)
+#define V_LOAD(p) _mm_load_si128((const __m128i*)(p))
+#define V_STORE(p, a) _mm_store_si128((__m128i*)(p), a)
+#define V_ADD(a, b) _mm_add_epi32(a, b)
+#define V_SUB(a, b) _mm_sub_epi32(a, b)
+#define V_AND(a, b) _mm_and_si128(a, b)
+#define V_OR(a, b) _mm_or_si128(a, b)
+#define V_ANDNOT(a, b) _mm_andnot_si128(a, b)
+#define V_CMPEQ(a, b) _mm_cmpeq_epi32(a, b)
+#define V_CMPGT(a, b) _mm_cmpgt_epi32(a, b)
+#define V_SELECT(m, a, b) _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b))
+#define V_ANY(m) (_mm_movemask_epi8(m) != 0)
+#define PONG_BATCH_KERNEL batch_kernel_simd
+#define PONG_BATCH_STEP batch_step_simd
+#include "pong_batch_kernel.h"
+#endif
+
+// the kernels only know classic physics, anything else steps one match at a time
+static void batch_step_each(PongBatch* b)
+{
+	PongMatch match;
+	int i;
+
+	for (i = 0; i < b->count; i++)
+	{
+		pong_batch_store(b, i, &match);
+		b->events[i] = pong_sim_step(&match, b->input[i]);
+		pong_batch_load(b, i, &match);
+	}
+}
+
+void pong_batch_step(PongBatch* batch)
+{
+	if (batch->config.physics != PONG_PHYSICS_CLASSIC)
+	{
+		batch_step_each(batch);
+		return;
+	}
+#if defined(PONG_BATCH_AVX2) || defined(PONG_BATCH_SSE2)
+	batch_step_simd(batch);
+#else
+	batch_step_scalar(batch);
+#endif
+}
+
+void pong_batch_step_scalar(PongBatch* batch)
+{
+	if (batch->config.physics != PONG_PHYSICS_CLASSIC)
+	{
+		batch_step_each(batch);
+		return;
+	}
+	batch_step_scalar(batch);
+}
+
+const char* pong_batch_kernel_name(void)
+{
+#if defined(PONG_BATCH_AVX2)
+	return "avx2";
+#elif defined(PONG_BATCH_SSE2)
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
@@ -0,0 +1,100 @@
+/*
+	Program: PONG
+	Module: pong_batch
+
+	Steps many independent matches together. Match state is kept as a
+	structure of arrays (one int array per PongMatch field) so the update can
+	run several matches per instruction with SSE2 or AVX2, with a plain C
+	fallback. Every lane plays out bit for bit the same as pong_sim_step on
+	the equivalent PongMatch. Batches with swept physics are stepped one
+	match at a time through pong_sim_step.
+*/
+
+#ifndef PONG_BATCH_H
+#define PONG_BATCH_H
+
+#include "pong_sim.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// lanes are padded to a multiple of this so every kernel can load whole vectors
+#define PONG_BATCH_ALIGN 8
+
+typedef struct PongBatch
+{
+	PongConfig config;		// shared by every match in the batch
+	PongTickConfig tick;	// from config, the same speeds pong_sim_step uses
+	int count;				// matches in use
+	int capacity;			// count rounded up to PONG_BATCH_ALIGN, padding lanes stay in the menu
+
+	// per-frame input and output, filled in by the caller / by pong_batch_step
+	PongInput* input;
+	unsigned int* events;
+
+	// match state, one entry per lane. Paddle x, sizes and paddle centre x
+	// never change during a match and come from config instead
+	int* p1Y;
+	int* p2Y;
+	int* ballX;
+	int* ballY;
+
+	int* p1CenterY;
+	int* p2CenterY;
+	int* ballCenterX;
+	int* ballCenterY;
+
+	int* ballInPlay;
+	int* gameOn;
+	int* RWGMode;
+	int* multiplayer;
+
+	int* p1AColorSwitchLock;
+	int* p1DColorSwitchLock;
+	int* p2LColorSwitchLock;
+	int* p2RColorSwitchLock;
+
+	int* p1Score;
+	int* p2Score;
+
+	int* p1ColorSetting;
+	int* p2ColorSetting;
+	int* ballColorSetting;
+
+	int* ballSpeedX;
+	int* ballSpeedY;
+	int* ballDirX;
+
+	int* aiMovement;
+	int* ballHits;
+	int* lastPoint;
+
+	PongRng* rng;
+
+	void* memory;			// one allocation behind all of the arrays
+} PongBatch;
+
+// allocates a batch of count matches, all initialised with pong_sim_init.
+// returns 0 on success, -1 when out of memory
+int pong_batch_create(PongBatch* batch, const PongConfig* config, int count);
+void pong_batch_destroy(PongBatch* batch);
+
+// copies a match into / out of a lane. The match must use the batch's config
+void pong_batch_load(PongBatch* batch, int lane, const PongMatch* match);
+void pong_batch_store(const PongBatch* batch, int lane, PongMatch* match);
+
+// advances every match by one frame using batch->input, writes batch->events
+void pong_batch_step(PongBatch* batch);
+
+// same, always through the plain C kernel
+void pong_batch_step_scalar(PongBatch* batch);
+
+// "avx2", "sse2" or "scalar", whichever pong_batch_step was built with
+const char* pong_batch_kernel_name(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,289 @@
+/*
+	Program: PONG
+	Module: pong_batch
+
+	Branch-free update for V_LANES matches at a time. Included once per
+	instruction set by pong_batch.c, which first defines:
+
+		V, V_LANES                  vector type and how many ints it holds
+		V_SET1, V_LOAD, V_STORE     broadcast, aligned load / store
+		V_ADD, V_SUB                lane-wise int arithmetic
+		V_AND, V_OR, V_ANDNOT       bitwise, V_ANDNOT(a, b) = ~a & b
+		V_CMPEQ, V_CMPGT            signed compares giving all-ones / zero lanes
+		V_SELECT(m, a, b)           a where m is set, b elsewhere
+		V_ANY(m)                    non-zero if any lane of m is set
+		PONG_BATCH_KERNEL           name of the generated lane function
+		PONG_BATCH_STEP             name of the generated step function
+
+	Every condition in pong_sim_step becomes a lane mask, and every
+	assignment a select on that mask, in the same order as the scalar code.
+	Lanes hold the same 16.16 fixed point values as PongMatch, and speeds
+	and the AI's detect line come from the batch's PongTickConfig, as
+	pong_sim_step's do.
+	Commands (serve, mode select, menu) and RWG colour draws are rare and
+	are left to the scalar code in pong_batch.c.
+*/
+
+// lanes where the held key bit is down
+#define V_BIT(in, bit) V_CMPEQ(V_AND(in, V_SET1(bit)), V_SET1(bit))
+
+// edge-triggered colour switch, see color_switch() in pong_sim.c
+#define V_COLOR_SWITCH(mask, held, lock, setting, step) \
+	{ \
+		V fire = V_AND(V_AND(mask, held), V_CMPEQ(lock, zero)); \
+		V release = V_AND(V_ANDNOT(held, mask), V_CMPEQ(lock, one)); \
+		lock = V_SELECT(fire, one, V_SELECT(release, zero, lock)); \
+		setting = V_ADD(setting, V_AND(fire, V_SET1(step))); \
+		setting = V_SELECT(V_AND(fire, V_CMPGT(zero, setting)), V_SET1(PONG_COLOR_COUNT - 1), setting); \
+		setting = V_SELECT(V_AND(fire, V_CMPGT(setting, V_SET1(PONG_COLOR_COUNT - 1))), zero, setting); \
+	}
+
+// steps lanes [i, i + V_LANES) and returns non-zero if any of them hit a paddle in RWG mode
+static int PONG_BATCH_KERNEL(PongBatch* b, int i)
+{
+	const PongConfig* c = &b->config;
+	const PongTickConfig* t = &b->tick;
+
+	const V zero = V_SET1(0);
+	const V one = V_SET1(1);
+	const V minusOne = V_SET1(-1);
+	const V paddleSpeed = V_SET1(t->paddleSpeed);
+	const V negPaddleSpeed = V_SET1(-t->paddleSpeed);
+	const V paddleMaxY = V_SET1(PONG_FIXED(c->scrHeight - c->paddleH));
+	const V ballMaxY = V_SET1(PONG_FIXED(c->scrHeight - c->ballSize));
+	const V paddleHalfH = V_SET1(PONG_FIXED(c->paddleH / 2));
+	const V ballHalf = V_SET1(PONG_FIXED(c->ballSize / 2));
+	const V ballSize = V_SET1(PONG_FIXED(c->ballSize));
+	const V paddleH = V_SET1(PONG_FIXED(c->paddleH));
+	const V p1X = V_SET1(PONG_FIXED(c->paddleW));
+	const V p2X = V_SET1(PONG_FIXED(c->scrWidth - c->paddleW * 2));
+	const V paddleW = V_SET1(PONG_FIXED(c->paddleW));
+	const V capX = V_SET1(t->ballSpeedCapX);
+	const V capY = V_SET1(t->ballSpeedCapY);
+	const V negCapY = V_SET1(-t->ballSpeedCapY);
+	const V speedUpStep = V_SET1(t->speedUpStep);
+	const V spinStep = V_SET1(t->spinStep);
+	const V solid = V_SET1((c->paddleW > 0 && c->paddleH > 0 && c->ballSize > 0) ? -1 : 0);
+
+	V input = V_LOAD((const int*)b->input + i);
+	V active = V_CMPEQ(V_LOAD(b->gameOn + i), one);
+	V human, ai, chase, aiDown, aiUp, rwg, inPlay, speedUp;
+	V keyP1Up, keyP1Down, keyP2Up, keyP2Down;
+	V hit1, hit2, hit, up, down, p1Point, p2Point, point, win, wallTop, wallBottom;
+	V events;
+
+	V p1Y, p2Y, ballX, ballY, p1CenterY, p2CenterY, ballCenterX, ballCenterY;
+	V gameOn, ballInPlay, multiplayer, p1Score, p2Score;
+	V p1Color, p2Color, ballColor, ballSpeedX, ballSpeedY, ballDirX;
+	V aiMovement, ballHits, lastPoint;
+	V p1ALock, p1DLock, p2LLock, p2RLock;
+
+	if (!V_ANY(active))
+	{
+		V_STORE((int*)b->events + i, zero);
+		return 0;
+	}
+
+	p1Y = V_LOAD(b->p1Y + i);
+	p2Y = V_LOAD(b->p2Y + i);
+	ballX = V_LOAD(b->ballX + i);
+	ballY = V_LOAD(b->ballY + i);
+	p1CenterY = V_LOAD(b->p1CenterY + i);
+	p2CenterY = V_LOAD(b->p2CenterY + i);
+	ballCenterX = V_LOAD(b->ballCenterX + i);
+	ballCenterY = V_LOAD(b->ballCenterY + i);
+	gameOn = V_LOAD(b->gameOn + i);
+	ballInPlay = V_LOAD(b->ballInPlay + i);
+	multiplayer = V_LOAD(b->multiplayer + i);
+	p1Score = V_LOAD(b->p1Score + i);
+	p2Score = V_LOAD(b->p2Score + i);
+	p1Color = V_LOAD(b->p1ColorSetting + i);
+	p2Color = V_LOAD(b->p2ColorSetting + i);
+	ballColor = V_LOAD(b->ballColorSetting + i);
+	ballSpeedX = V_LOAD(b->ballSpeedX + i);
+	ballSpeedY = V_LOAD(b->ballSpeedY + i);
+	ballDirX = V_LOAD(b->ballDirX + i);
+	aiMovement = V_LOAD(b->aiMovement + i);
+	ballHits = V_LOAD(b->ballHits + i);
+	lastPoint = V_LOAD(b->lastPoint + i);
+	p1ALock = V_LOAD(b->p1AColorSwitchLock + i);
+	p1DLock = V_LOAD(b->p1DColorSwitchLock + i);
+	p2LLock = V_LOAD(b->p2LColorSwitchLock + i);
+	p2RLock = V_LOAD(b->p2RColorSwitchLock + i);
+
+	keyP1Up = V_BIT(input, PONG_INPUT_P1_UP);
+	keyP1Down = V_BIT(input, PONG_INPUT_P1_DOWN);
+	keyP2Up = V_BIT(input, PONG_INPUT_P2_UP);
+	keyP2Down = V_BIT(input, PONG_INPUT_P2_DOWN);
+
+	// player 1 controls
+	p1Y = V_ADD(p1Y, V_AND(V_AND(active, keyP1Up), negPaddleSpeed));
+	p1Y = V_ADD(p1Y, V_AND(V_AND(active, keyP1Down), paddleSpeed));
+
+	// player 2 controls
+	human = V_AND(active, V_CMPEQ(multiplayer, one));
+	p2Y = V_ADD(p2Y, V_AND(V_AND(human, keyP2Up), negPaddleSpeed));
+	p2Y = V_ADD(p2Y, V_AND(V_AND(human, keyP2Down), paddleSpeed));
+
+	// AI controls
+	ai = V_ANDNOT(human, active);
+	chase = V_AND(ai, V_AND(V_CMPGT(ballCenterX, V_SET1(t->aiDetectX)), V_CMPEQ(ballDirX, one)));
+	aiDown = V_AND(chase, V_CMPGT(ballCenterY, V_ADD(p2CenterY, paddleSpeed)));
+	aiUp = V_AND(V_ANDNOT(aiDown, chase), V_CMPGT(V_SUB(p2CenterY, paddleSpeed), ballCenterY));
+	p2Y = V_ADD(p2Y, V_AND(aiDown, paddleSpeed));
+	p2Y = V_ADD(p2Y, V_AND(aiUp, negPaddleSpeed));
+	aiMovement = V_SELECT(aiDown, one, aiMovement);
+	aiMovement = V_SELECT(aiUp, minusOne, aiMovement);
+	aiMovement = V_SELECT(V_ANDNOT(chase, ai), zero, aiMovement);
+
+	// RWG controls
+	rwg = V_AND(active, V_CMPEQ(V_LOAD(b->RWGMode + i), one));
+	V_COLOR_SWITCH(rwg, V_BIT(input, PONG_INPUT_P1_LEFT), p1ALock, p1Color, -1);
+	V_COLOR_SWITCH(rwg, V_BIT(input, PONG_INPUT_P1_RIGHT), p1DLock, p1Color, 1);
+	V_COLOR_SWITCH(V_AND(rwg, human), V_BIT(input, PONG_INPUT_P2_LEFT), p2LLock, p2Color, -1);
+	V_COLOR_SWITCH(V_AND(rwg, human), V_BIT(input, PONG_INPUT_P2_RIGHT), p2RLock, p2Color, 1);
+	p2Color = V_SELECT(V_AND(V_AND(rwg, ai), V_AND(V_CMPGT(ballDirX, zero), V_CMPGT(ballCenterX, V_SET1(t->halfWidth)))), ballColor, p2Color);
+
+	// ball movement, ballDirX is always 1 or -1
+	inPlay = V_ANDNOT(V_CMPEQ(ballInPlay, zero), active);
+	ballX = V_ADD(ballX, V_AND(inPlay, V_SELECT(V_CMPEQ(ballDirX, minusOne), V_SUB(zero, ballSpeedX), ballSpeedX)));
+	ballY = V_ADD(ballY, V_AND(inPlay, ballSpeedY));
+	speedUp = V_ANDNOT(V_CMPGT(V_SET1(c->hitsPerSpeedUp), ballHits), active);
+	ballHits = V_SELECT(speedUp, zero, ballHits);
+	ballSpeedX = V_ADD(ballSpeedX, V_AND(V_AND(speedUp, V_CMPGT(capX, ballSpeedX)), speedUpStep));
+
+	// paddle boundary collision
+	p1Y = V_SELECT(V_AND(active, V_CMPGT(zero, p1Y)), zero, p1Y);
+	p1Y = V_SELECT(V_AND(active, V_CMPGT(p1Y, paddleMaxY)), paddleMaxY, p1Y);
+	p2Y = V_SELECT(V_AND(active, V_CMPGT(zero, p2Y)), zero, p2Y);
+	p2Y = V_SELECT(V_AND(active, V_CMPGT(p2Y, paddleMaxY)), paddleMaxY, p2Y);
+
+	// ball boundary collision
+	wallTop = V_AND(active, V_CMPGT(zero, ballY));
+	ballY = V_SELECT(wallTop, zero, ballY);
+	ballSpeedY = V_SELECT(wallTop, V_SUB(zero, ballSpeedY), ballSpeedY);
+	wallBottom = V_AND(active, V_CMPGT(ballY, ballMaxY));
+	ballY = V_SELECT(wallBottom, ballMaxY, ballY);
+	ballSpeedY = V_SELECT(wallBottom, V_SUB(zero, ballSpeedY), ballSpeedY);
+
+	// centres
+	p1CenterY = V_SELECT(active, V_ADD(p1Y, paddleHalfH), p1CenterY);
+	p2CenterY = V_SELECT(active, V_ADD(p2Y, paddleHalfH), p2CenterY);
+	ballCenterX = V_SELECT(active, V_ADD(ballX, ballHalf), ballCenterX);
+	ballCenterY = V_SELECT(active, V_ADD(ballY, ballHalf), ballCenterY);
+
+	// ball and paddle collision: rectangles overlap when each starts before the other ends
+	hit1 = V_AND(V_AND(active, solid), V_AND(V_CMPGT(V_ADD(ballX, ballSize), p1X), V_CMPGT(V_ADD(p1X, paddleW), ballX)));
+	hit1 = V_AND(hit1, V_AND(V_CMPGT(V_ADD(ballY, ballSize), p1Y), V_CMPGT(V_ADD(p1Y, paddleH), ballY)));
+	hit1 = V_AND(hit1, V_AND(V_CMPEQ(ballDirX, minusOne), V_CMPEQ(p1Color, ballColor)));
+
+	hit2 = V_ANDNOT(hit1, V_AND(active, solid));
+	hit2 = V_AND(hit2, V_AND(V_CMPGT(V_ADD(ballX, ballSize), p2X), V_CMPGT(V_ADD(p2X, paddleW), ballX)));
+	hit2 = V_AND(hit2, V_AND(V_CMPGT(V_ADD(ballY, ballSize), p2Y), V_CMPGT(V_ADD(p2Y, paddleH), ballY)));
+	hit2 = V_AND(hit2, V_AND(V_CMPEQ(ballDirX, one), V_CMPEQ(p2Color, ballColor)));
+
+	up = V_AND(hit1, V_AND(keyP1Up, V_CMPGT(ballSpeedY, negCapY)));
+	down = V_AND(V_ANDNOT(up, hit1), V_AND(keyP1Down, V_CMPGT(capY, ballSpeedY)));
+	{
+		V humanRaw = V_CMPEQ(multiplayer, one);
+		V up2 = V_AND(hit2, V_OR(V_AND(keyP2Up, V_CMPGT(ballSpeedY, negCapY)), V_AND(humanRaw, V_CMPEQ(aiMovement, minusOne))));
+		V down2 = V_AND(V_ANDNOT(up2, hit2), V_OR(V_AND(keyP2Down, V_CMPGT(capY, ballSpeedY)), V_AND(humanRaw, V_CMPEQ(aiMovement, one))));
+
+		up = V_OR(up, up2);
+		down = V_OR(down, down2);
+	}
+	hit = V_OR(hit1, hit2);
+	ballDirX = V_SELECT(hit, V_SUB(zero, ballDirX), ballDirX);
+	ballHits = V_ADD(ballHits, V_AND(hit, one));
+	ballSpeedY = V_SUB(ballSpeedY, V_AND(up, spinStep));
+	ballSpeedY = V_ADD(ballSpeedY, V_AND(down, spinStep));
+
+	// ball out of bounds
+	p1Point = V_AND(active, V_CMPGT(ballX, V_SET1(t->width)));
+	p2Point = V_ANDNOT(p1Point, V_AND(active, V_CMPGT(V_SUB(zero, ballSize), ballX)));
+	point = V_OR(p1Point, p2Point);
+	p1Score = V_ADD(p1Score, V_AND(p1Point, one));
+	p2Score = V_ADD(p2Score, V_AND(p2Point, one));
+	lastPoint = V_SELECT(p1Point, one, lastPoint);
+	lastPoint = V_SELECT(p2Point, V_SET1(2), lastPoint);
+	ballInPlay = V_SELECT(point, zero, ballInPlay);
+	p1Color = V_SELECT(point, zero, p1Color);
+	p2Color = V_SELECT(point, zero, p2Color);
+	ballColor = V_SELECT(point, zero, ballColor);
+	ballX = V_SELECT(point, V_SET1(PONG_FIXED((c->scrWidth - c->ballSize) / 2)), ballX);
+	ballY = V_SELECT(point, V_SET1(PONG_FIXED((c->scrHeight - c->ballSize) / 2)), ballY);
+	ballSpeedX = V_SELECT(point, zero, ballSpeedX);
+	ballSpeedY = V_SELECT(point, zero, ballSpeedY);
+
+	// win score reached
+	win = V_ANDNOT(V_AND(V_CMPGT(V_SET1(c->winScore), p1Score), V_CMPGT(V_SET1(c->winScore), p2Score)), point);
+	gameOn = V_SELECT(win, zero, gameOn);
+
+	events = V_AND(wallTop, V_SET1(PONG_EVENT_WALL_TOP));
+	events = V_OR(events, V_AND(wallBottom, V_SET1(PONG_EVENT_WALL_BOTTOM)));
+	events = V_OR(events, V_AND(hit1, V_SET1(PONG_EVENT_HIT_P1)));
+	events = V_OR(events, V_AND(hit2, V_SET1(PONG_EVENT_HIT_P2)));
+	events = V_OR(events, V_AND(point, V_SET1(PONG_EVENT_SCORE)));
+	events = V_OR(events, V_AND(win, V_SET1(PONG_EVENT_WIN)));
+
+	V_STORE(b->p1Y + i, p1Y);
+	V_STORE(b->p2Y + i, p2Y);
+	V_STORE(b->ballX + i, ballX);
+	V_STORE(b->ballY + i, ballY);
+	V_STORE(b->p1CenterY + i, p1CenterY);
+	V_STORE(b->p2CenterY + i, p2CenterY);
+	V_STORE(b->ballCenterX + i, ballCenterX);
+	V_STORE(b->ballCenterY + i, ballCenterY);
+	V_STORE(b->gameOn + i, gameOn);
+	V_STORE(b->ballInPlay + i, ballInPlay);
+	V_STORE(b->p1Score + i, p1Score);
+	V_STORE(b->p2Score + i, p2Score);
+	V_STORE(b->p1ColorSetting + i, p1Color);
+	V_STORE(b->p2ColorSetting + i, p2Color);
+	V_STORE(b->ballColorSetting + i, ballColor);
+	V_STORE(b->ballSpeedX + i, ballSpeedX);
+	V_STORE(b->ballSpeedY + i, ballSpeedY);
+	V_STORE(b->ballDirX + i, ballDirX);
+	V_STORE(b->aiMovement + i, aiMovement);
+	V_STORE(b->ballHits + i, ballHits);
+	V_STORE(b->lastPoint + i, lastPoint);
+	V_STORE(b->p1AColorSwitchLock + i, p1ALock);
+	V_STORE(b->p1DColorSwitchLock + i, p1DLock);
+	V_STORE(b->p2LColorSwitchLock + i, p2LLock);
+	V_STORE(b->p2RColorSwitchLock + i, p2RLock);
+	V_STORE((int*)b->events + i, events);
+
+	return V_ANY(V_AND(hit, rwg));
+}
+
+static void PONG_BATCH_STEP(PongBatch* b)
+{
+	int i, k;
+
+	for (i = 0; i < b->capacity; i += V_LANES)
+	{
+		PongMatch pending[V_LANES];
+		unsigned int commands = 0;	// bit k set when lane i + k has a command this frame
+
+		for (k = 0; k < V_LANES; k++)
+		{
+			if (b->input[i + k] & ~PONG_INPUT_HELD_MASK)
+			{
+				commands |= 1u << k;
+				pong_batch_store(b, i + k, &pending[k]);
+			}
+		}
+
+		if (PONG_BATCH_KERNEL(b, i))
+		{
+			batch_draw_colors(b, i, V_LANES, commands);
+		}
+		if (commands)
+		{
+			batch_step_pending(b, i, V_LANES, commands, pending);
+		}
+	}
+}
+
+#undef V_BIT
+#undef V_COLOR_SWITCH
@@ -0,0 +1,295 @@
+/*
+	Program: PONG
+	Module: pong_env
+*/
+
+#include "pong_env.h"
+
+#include <stdlib.h> // calloc()
+#include <string.h> // memset()
+
+#define ENVS_PER_JOB 256	// small enough to balance across workers, big enough to not notice the queue
+
+// brightness of each colour setting in the picture, by luma
+static const unsigned char pixelColors[PONG_COLOR_COUNT] = { 255, 76, 150 };
+#define PIXEL_HALF_LINE 128
+
+void pong_env_settings_default(PongEnvSettings* settings)
+{
+	memset(settings, 0, sizeof(*settings));
+	pong_config_default(&settings->config);
+	settings->maxFrames = PONG_ENV_MAX_FRAMES;
+	settings->threads = 1;
+}
+
+int pong_env_create(PongEnv* env, const PongEnvSettings* settings, int count)
+{
+	memset(env, 0, sizeof(*env));
+	if (count <= 0 || settings->pixelWidth < 0 || settings->pixelHeight < 0)
+	{
+		return -1;
+	}
+
+	env->slots = (PongEnvSlot*)calloc(count, sizeof(PongEnvSlot));
+	if (!env->slots)
+	{
+		return -1;
+	}
+	env->settings = *settings;
+	env->count = count;
+	env->step = pong_sim_step;
+
+	// started once: RL training steps far too often to start threads each time
+	if (settings->threads > 1)
+	{
+		env->pool = pong_jobs_pool_create(settings->threads);
+		if (!env->pool)
+		{
+			free(env->slots);
+			memset(env, 0, sizeof(*env));
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+void pong_env_destroy(PongEnv* env)
+{
+	pong_jobs_pool_destroy(env->pool);
+	free(env->slots);
+	memset(env, 0, sizeof(*env));
+}
+
+void pong_env_set_buffers(PongEnv* env, float* observations, float* rewards, unsigned char* dones, unsigned char* pixels)
+{
+	env->observations = observations;
+	env->rewards = rewards;
+	env->dones = dones;
+	env->pixels = pixels;
+}
+
+//
+// a new game in slot i, on the next pair of random streams
+//
+static void start_episode(PongEnv* env, int i)
+{
+	const PongEnvSettings* s = &env->settings;
+	PongEnvSlot* slot = &env->slots[i];
+	uint64_t stream = ((uint64_t)i << 32 | slot->episode) * 2;
+	PongInput mode;
+
+	// against a controller both paddles are driven through their keys
+	if (s->opponent)
+	{
+		mode = s->RWGMode ? PONG_INPUT_MODE_4 : PONG_INPUT_MODE_2;
+	}
+	else
+	{
+		mode = s->RWGMode ? PONG_INPUT_MODE_3 : PONG_INPUT_MODE_1;
+	}
+
+	pong_sim_init(&slot->match, &s->config);
+	pong_sim_seed(&slot->match, env->seed, stream);
+	pong_ai_init(&slot->opponent, 2, env->seed, stream + 1);
+	pong_sim_step(&slot->match, mode | PONG_INPUT_SERVE);
+
+	slot->p1LastY = slot->match.p1.y;
+	slot->p2LastY = slot->match.p2.y;
+	slot->frames = 0;
+	slot->episode++;
+}
+
+//
+// the features of slot i, see PONG_ENV_BALL_X and on
+//
+static void write_observation(const PongEnv* env, int i)
+{
+	const PongEnvSlot* slot = &env->slots[i];
+	const PongMatch* m = &slot->match;
+	const PongConfig* c = &m->config;
+	float* obs = env->observations + (size_t)i * PONG_ENV_FEATURES;
+	float width = (float)PONG_FIXED(c->scrWidth);
+	float height = (float)PONG_FIXED(c->scrHeight);
+	float capX = (float)pong_tick_speed(c, PONG_FIXED(c->ballSpeedCapX));
+	float capY = (float)pong_tick_speed(c, PONG_FIXED(c->ballSpeedCapY));
+	float paddleSpeed = (float)pong_tick_speed(c, PONG_FIXED(c->paddleSpeed));
+
+	obs[PONG_ENV_BALL_X] = m->ballCenter.x / width;
+	obs[PONG_ENV_BALL_Y] = m->ballCenter.y / height;
+	obs[PONG_ENV_BALL_VX] = (float)(m->ballSpeedX * m->ballDirX) / capX;
+	obs[PONG_ENV_BALL_VY] = (float)m->ballSpeedY / capY;
+	obs[PONG_ENV_P1_Y] = m->p1Center.y / height;
+	obs[PONG_ENV_P1_VY] = (float)(m->p1.y - slot->p1LastY) / paddleSpeed;
+	obs[PONG_ENV_P2_Y] = m->p2Center.y / height;
+	obs[PONG_ENV_P2_VY] = (float)(m->p2.y - slot->p2LastY) / paddleSpeed;
+	obs[PONG_ENV_BALL_IN_PLAY] = (float)m->ballInPlay;
+	obs[PONG_ENV_P1_COLOR] = (float)m->p1ColorSetting;
+	obs[PONG_ENV_P2_COLOR] = (float)m->p2ColorSetting;
+	obs[PONG_ENV_BALL_COLOR] = (float)m->ballColorSetting;
+}
+
+//
+// fills the picture cells a playfield rectangle touches, so nothing
+// shrinks away however small the picture is
+//
+static void fill_cells(unsigned char* pixels, int pw, int ph, const PongConfig* c, const PongRect* rect, unsigned char value)
+{
+	int x0 = (int)((int64_t)rect->x * pw / PONG_FIXED(c->scrWidth));
+	int x1 = (int)(((int64_t)(rect->x + rect->w) * pw + PONG_FIXED(c->scrWidth) - 1) / PONG_FIXED(c->scrWidth));
+	int y0 = (int)((int64_t)rect->y * ph / PONG_FIXED(c->scrHeight));
+	int y1 = (int)(((int64_t)(rect->y + rect->h) * ph + PONG_FIXED(c->scrHeight) - 1) / PONG_FIXED(c->scrHeight));
+
+	x0 = x0 < 0 ? 0 : x0;
+	y0 = y0 < 0 ? 0 : y0;
+	x1 = x1 > pw ? pw : x1;
+	y1 = y1 > ph ? ph : y1;
+	for (int y = y0; y < y1; y++)
+	{
+		memset(pixels + (size_t)y * pw + x0, value, x1 > x0 ? x1 - x0 : 0);
+	}
+}
+
+//
+// slot i's picture: black, the half line, paddles and ball in their colours' brightness
+//
+static void write_pixels(const PongEnv* env, int i)
+{
+	const PongMatch* m = &env->slots[i].match;
+	const PongConfig* c = &m->config;
+	int pw = env->settings.pixelWidth;
+	int ph = env->settings.pixelHeight;
+	unsigned char* pixels = env->pixels + (size_t)i * pw * ph;
+	PongRect halfLine;
+
+	halfLine.x = PONG_FIXED(c->scrWidth / 2);
+	halfLine.y = 0;
+	halfLine.w = PONG_FIXED_ONE;
+	halfLine.h = PONG_FIXED(c->scrHeight);
+
+	memset(pixels, 0, (size_t)pw * ph);
+	fill_cells(pixels, pw, ph, c, &halfLine, PIXEL_HALF_LINE);
+	fill_cells(pixels, pw, ph, c, &m->p1, pixelColors[m->p1ColorSetting]);
+	fill_cells(pixels, pw, ph, c, &m->p2, pixelColors[m->p2ColorSetting]);
+	if (m->ballInPlay)
+	{
+		fill_cells(pixels, pw, ph, c, &m->ball, pixelColors[m->ballColorSetting]);
+	}
+}
+
+static void write_outputs(const PongEnv* env, int i)
+{
+	write_observation(env, i);
+	if (env->pixels && env->settings.pixelWidth > 0 && env->settings.pixelHeight > 0)
+	{
+		write_pixels(env, i);
+	}
+}
+
+static void reset_job(void* user, int job, int worker)
+{
+	PongEnv* env = (PongEnv*)user;
+	int end = (job + 1) * ENVS_PER_JOB < env->count ? (job + 1) * ENVS_PER_JOB : env->count;
+
+	(void)worker;
+	for (int i = job * ENVS_PER_JOB; i < end; i++)
+	{
+		env->slots[i].episode = 0;
+		start_episode(env, i);
+		env->rewards[i] = 0.0f;
+		if (env->dones)
+		{
+			env->dones[i] = PONG_ENV_RUNNING;
+		}
+		write_outputs(env, i);
+	}
+}
+
+static void step_job(void* user, int job, int worker)
+{
+	static const PongInput actionKeys[PONG_ENV_ACTIONS] = {
+		0, PONG_INPUT_P1_UP, PONG_INPUT_P1_DOWN, PONG_INPUT_P1_LEFT, PONG_INPUT_P1_RIGHT
+	};
+	PongEnv* env = (PongEnv*)user;
+	const PongEnvSettings* s = &env->settings;
+	int end = (job + 1) * ENVS_PER_JOB < env->count ? (job + 1) * ENVS_PER_JOB : env->count;
+
+	(void)worker;
+	for (int i = job * ENVS_PER_JOB; i < end; i++)
+	{
+		PongEnvSlot* slot = &env->slots[i];
+		PongMatch* m = &slot->match;
+		int action = env->actions[i];
+		PongInput input = action >= 0 && action < PONG_ENV_ACTIONS ? actionKeys[action] : 0;
+		unsigned int events;
+		float reward = 0.0f;
+		int done = PONG_ENV_RUNNING;
+
+		if (s->opponent)
+		{
+			input |= s->opponent->think(&slot->opponent, m);
+		}
+		if (!m->ballInPlay)
+		{
+			input |= PONG_INPUT_SERVE;
+		}
+
+		slot->p1LastY = m->p1.y;
+		slot->p2LastY = m->p2.y;
+		events = env->step(m, input);
+		slot->frames++;
+
+		if (events & PONG_EVENT_SCORE)
+		{
+			reward = m->lastPoint == 1 ? 1.0f : -1.0f;
+		}
+		if (events & PONG_EVENT_WIN)
+		{
+			done = PONG_ENV_GAME_OVER;
+		}
+		else if (s->maxFrames > 0 && slot->frames >= s->maxFrames)
+		{
+			done = PONG_ENV_CUT_OFF;
+		}
+		if (done != PONG_ENV_RUNNING)
+		{
+			start_episode(env, i);
+		}
+
+		env->rewards[i] = reward;
+		env->dones[i] = (unsigned char)done;
+		write_outputs(env, i);
+	}
+}
+
+// runs fn over every env, in jobs of ENVS_PER_JOB, on the env's pool
+static void run(PongEnv* env, PongJobFn fn)
+{
+	int jobs = (env->count + ENVS_PER_JOB - 1) / ENVS_PER_JOB;
+
+	if (env->pool && jobs > 1)
+	{
+		pong_jobs_pool_run(env->pool, jobs, fn, env);
+	}
+	else
+	{
+		for (int job = 0; job < jobs; job++)
+		{
+			fn(env, job, 0);
+		}
+	}
+}
+
+void pong_env_reset(PongEnv* env, uint64_t seed)
+{
+	env->seed = seed;
+	run(env, reset_job);
+	env->step = pong_sim_step_fn(&env->slots[0].match);
+}
+
+void pong_env_step(PongEnv* env, const int* actions)
+{
+	env->actions = actions;
+	run(env, step_job);
+	env->actions = NULL;
+}
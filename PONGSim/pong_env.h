@@ -0,0 +1,126 @@
+/*
+	Program: PONG
+	Module: pong_env
+
+	Many matches side by side as environments for training a paddle agent.
+	The agent plays P1 against the AI built into pong_sim or one of the
+	pong_ai controllers. Every step takes one action per environment and
+	writes observations, rewards and episode ends straight into buffers
+	the caller owns. Those can be numpy arrays, a shared memory segment or
+	anything else that is contiguous, and nothing is copied out afterwards.
+
+	An episode is one game to config.winScore. A finished environment
+	starts its next episode on the same step, so the observation written
+	with done set is already the first one of the new game. Dead balls are
+	served straight away.
+
+	Plain C types only, so it can be driven through ctypes or cffi as is.
+*/
+
+#ifndef PONG_ENV_H
+#define PONG_ENV_H
+
+#include "pong_sim.h"
+#include "pong_ai.h"
+#include "pong_jobs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// actions for P1
+#define PONG_ENV_NOOP 0
+#define PONG_ENV_UP 1
+#define PONG_ENV_DOWN 2
+#define PONG_ENV_COLOR_LEFT 3		// RWG colour switch, does nothing in classic games
+#define PONG_ENV_COLOR_RIGHT 4
+#define PONG_ENV_ACTIONS 5
+
+// observation features, floats in this order. Positions are centres, 0 to
+// 1 across the playfield. Ball speeds are shares of the speed caps, paddle
+// speeds of the paddle speed, so all of them stay within -1 to 1
+#define PONG_ENV_BALL_X 0
+#define PONG_ENV_BALL_Y 1
+#define PONG_ENV_BALL_VX 2			// positive towards P2
+#define PONG_ENV_BALL_VY 3			// positive downwards
+#define PONG_ENV_P1_Y 4
+#define PONG_ENV_P1_VY 5			// movement during the last step
+#define PONG_ENV_P2_Y 6
+#define PONG_ENV_P2_VY 7
+#define PONG_ENV_BALL_IN_PLAY 8		// 0 or 1
+#define PONG_ENV_P1_COLOR 9			// colour settings, 0 to PONG_COLOR_COUNT - 1
+#define PONG_ENV_P2_COLOR 10
+#define PONG_ENV_BALL_COLOR 11
+#define PONG_ENV_FEATURES 12
+
+// dones
+#define PONG_ENV_RUNNING 0
+#define PONG_ENV_GAME_OVER 1		// someone reached winScore
+#define PONG_ENV_CUT_OFF 2			// maxFrames ran out first
+
+#define PONG_ENV_MAX_FRAMES 36000	// ten minutes at 60 ticks per second
+
+typedef struct PongEnvSettings
+{
+	PongConfig config;
+	int RWGMode;
+	const PongController* opponent;	// plays P2, NULL for the AI built into pong_sim
+	int maxFrames;					// steps before an episode is cut off, 0 for never
+	int pixelWidth;					// size of the greyscale picture of each env, 0 for none
+	int pixelHeight;
+	int threads;					// pong_jobs workers for reset and step, 1 for the calling thread only
+} PongEnvSettings;
+
+// one environment
+typedef struct PongEnvSlot
+{
+	PongMatch match;
+	PongAIState opponent;
+	PongFixed p1LastY;				// paddle tops before the last step
+	PongFixed p2LastY;
+	int frames;						// steps into the episode
+	uint32_t episode;				// episodes started, picks the random streams
+} PongEnvSlot;
+
+typedef struct PongEnv
+{
+	PongEnvSettings settings;
+	int count;
+	uint64_t seed;
+	PongEnvSlot* slots;
+	PongStepFn step;				// pong_sim_step specialised for the settings' mode
+	PongJobPool* pool;				// the settings' threads, kept from create to destroy. NULL for one
+
+	// the caller's buffers, count entries each, see pong_env_set_buffers
+	float* observations;			// PONG_ENV_FEATURES per env
+	float* rewards;
+	unsigned char* dones;			// PONG_ENV_*
+	unsigned char* pixels;			// pixelWidth * pixelHeight per env, row by row
+
+	const int* actions;				// during pong_env_step
+} PongEnv;
+
+// classic rules against the built-in AI, PONG_ENV_MAX_FRAMES, no pixels, one thread
+void pong_env_settings_default(PongEnvSettings* settings);
+
+// returns 0 on success, -1 when out of memory or the pixel size is negative
+int pong_env_create(PongEnv* env, const PongEnvSettings* settings, int count);
+void pong_env_destroy(PongEnv* env);
+
+// where reset and step write. observations and rewards are required,
+// dones too for step. pixels can be NULL, even with a pixel size set
+void pong_env_set_buffers(PongEnv* env, float* observations, float* rewards, unsigned char* dones, unsigned char* pixels);
+
+// starts a new game in every env. The same seed always replays the same
+// episodes for the same actions. rewards and dones are cleared
+void pong_env_reset(PongEnv* env, uint64_t seed);
+
+// one frame in every env, actions[i] (PONG_ENV_*) for env i. rewards get
+// +1 for a point won and -1 for a point lost
+void pong_env_step(PongEnv* env, const int* actions);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
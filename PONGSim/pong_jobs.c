@@ -0,0 +1,268 @@
+/*
+	Program: PONG
+	Module: pong_jobs
+*/
+
+#include "pong_jobs.h"
+#include "pong_thread.h"
+
+#include <stdlib.h> // calloc()
+
+// a worker's remaining jobs [begin, end), padded so workers don't share cache lines
+typedef struct JobQueue
+{
+	PongSpinLock lock;
+	int begin;
+	int end;
+	char padding[64 - sizeof(PongSpinLock) - 2 * sizeof(int)];
+} JobQueue;
+
+typedef struct JobWorker
+{
+	PongJobPool* pool;
+	int index;
+} JobWorker;
+
+struct PongJobPool
+{
+	JobQueue* queues;
+	int threads;			// workers, started or not
+	int started;			// of them, the calling thread included
+	PongJobFn fn;			// this run's
+	void* user;
+
+	JobWorker* workers;
+	PongThread** handles;
+	PongSemaphore** wake;	// one per worker, posted to start a run
+	PongSemaphore* done;	// posted by each started worker at the end of a run
+	volatile int quit;
+};
+
+// takes the next job from the front of the worker's own queue, -1 if it is empty
+static int take_own(JobQueue* queue)
+{
+	int job = -1;
+
+	pong_spin_lock(&queue->lock);
+	if (queue->begin < queue->end)
+	{
+		job = queue->begin++;
+	}
+	pong_spin_unlock(&queue->lock);
+
+	return job;
+}
+
+// moves the back half of another worker's queue into ours, 0 if every queue is empty
+static int steal(PongJobPool* pool, int index)
+{
+	for (int k = 1; k < pool->threads; k++)
+	{
+		JobQueue* victim = &pool->queues[(index + k) % pool->threads];
+		int begin = 0, end = 0;
+
+		pong_spin_lock(&victim->lock);
+		if (victim->begin < victim->end)
+		{
+			end = victim->end;
+			begin = end - (end - victim->begin + 1) / 2;
+			victim->end = begin;
+		}
+		pong_spin_unlock(&victim->lock);
+
+		if (begin < end)
+		{
+			JobQueue* own = &pool->queues[index];
+
+			pong_spin_lock(&own->lock);
+			own->begin = begin;
+			own->end = end;
+			pong_spin_unlock(&own->lock);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+// works through the run's jobs, stealing when its own slice runs out
+static void work(JobWorker* worker)
+{
+	PongJobPool* pool = worker->pool;
+
+	for (;;)
+	{
+		int job = take_own(&pool->queues[worker->index]);
+
+		if (job < 0)
+		{
+			if (!steal(pool, worker->index))
+			{
+				break;
+			}
+			continue;
+		}
+		pool->fn(pool->user, job, worker->index);
+	}
+}
+
+static int worker_main(void* data)
+{
+	JobWorker* worker = (JobWorker*)data;
+	PongJobPool* pool = worker->pool;
+
+	for (;;)
+	{
+		pong_semaphore_wait(pool->wake[worker->index]);
+		if (pool->quit)
+		{
+			break;
+		}
+		work(worker);
+		pong_semaphore_post(pool->done);
+	}
+
+	return 0;
+}
+
+PongJobPool* pong_jobs_pool_create(int threads)
+{
+	PongJobPool* pool = (PongJobPool*)calloc(1, sizeof(PongJobPool));
+
+	if (threads < 1)
+	{
+		threads = 1;
+	}
+	if (!pool)
+	{
+		return NULL;
+	}
+	pool->threads = threads;
+	pool->started = 1;
+	pool->queues = (JobQueue*)calloc(threads, sizeof(JobQueue));
+	pool->workers = (JobWorker*)calloc(threads, sizeof(JobWorker));
+	pool->handles = (PongThread**)calloc(threads, sizeof(PongThread*));
+	pool->wake = (PongSemaphore**)calloc(threads, sizeof(PongSemaphore*));
+	pool->done = pong_semaphore_create(0);
+	if (!pool->queues || !pool->workers || !pool->handles || !pool->wake || !pool->done)
+	{
+		pong_jobs_pool_destroy(pool);
+		return NULL;
+	}
+
+	for (int i = 0; i < threads; i++)
+	{
+		pool->workers[i].pool = pool;
+		pool->workers[i].index = i;
+	}
+	for (int i = 1; i < threads; i++)
+	{
+		// a worker that doesn't start keeps an empty slice, see pong_jobs_pool_run
+		pool->wake[i] = pong_semaphore_create(0);
+		if (pool->wake[i])
+		{
+			pool->handles[i] = pong_thread_create(worker_main, &pool->workers[i]);
+		}
+		if (pool->handles[i])
+		{
+			pool->started++;
+		}
+	}
+
+	return pool;
+}
+
+void pong_jobs_pool_destroy(PongJobPool* pool)
+{
+	if (!pool)
+	{
+		return;
+	}
+
+	pool->quit = 1;
+	for (int i = 1; i < pool->threads && pool->handles; i++)
+	{
+		if (pool->handles[i])
+		{
+			pong_semaphore_post(pool->wake[i]);
+			pong_thread_join(pool->handles[i]);
+		}
+	}
+	for (int i = 1; i < pool->threads && pool->wake; i++)
+	{
+		if (pool->wake[i])
+		{
+			pong_semaphore_destroy(pool->wake[i]);
+		}
+	}
+	if (pool->done)
+	{
+		pong_semaphore_destroy(pool->done);
+	}
+	free(pool->queues);
+	free(pool->workers);
+	free(pool->handles);
+	free(pool->wake);
+	free(pool);
+}
+
+int pong_jobs_pool_threads(const PongJobPool* pool)
+{
+	return pool->started;
+}
+
+void pong_jobs_pool_run(PongJobPool* pool, int count, PongJobFn fn, void* user)
+{
+	int slice = 0;
+
+	pool->fn = fn;
+	pool->user = user;
+
+	// even slices to start with, only for workers that are running
+	for (int i = 0; i < pool->threads; i++)
+	{
+		JobQueue* queue = &pool->queues[i];
+
+		queue->begin = queue->end = 0;
+		if (i == 0 || pool->handles[i])
+		{
+			queue->begin = (int)((long long)count * slice / pool->started);
+			queue->end = (int)((long long)count * (slice + 1) / pool->started);
+			slice++;
+		}
+	}
+
+	// the semaphores order the writes above before the workers read them
+	for (int i = 1; i < pool->threads; i++)
+	{
+		if (pool->handles[i])
+		{
+			pong_semaphore_post(pool->wake[i]);
+		}
+	}
+
+	work(&pool->workers[0]);
+
+	for (int i = 1; i < pool->started; i++)
+	{
+		pong_semaphore_wait(pool->done);
+	}
+}
+
+int pong_jobs_run(int count, int threads, PongJobFn fn, void* user)
+{
+	PongJobPool* pool = pong_jobs_pool_create(threads);
+	int result;
+
+	if (!pool)
+	{
+		return -1;
+	}
+
+	// the jobs still get done if some threads didn't start, the others steal their slices
+	result = pong_jobs_pool_threads(pool) == pool->threads ? 0 : -1;
+	pong_jobs_pool_run(pool, count, fn, user);
+	pong_jobs_pool_destroy(pool);
+
+	return result;
+}
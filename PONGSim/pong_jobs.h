@@ -0,0 +1,51 @@
+/*
+	Program: PONG
+	Module: pong_jobs
+
+	Runs a fixed set of independent jobs (matches, usually) on a pool of
+	threads. Each worker starts with an even slice of the job indices and
+	steals half of another worker's remaining slice when its own runs out,
+	so uneven job lengths still keep every core busy.
+
+	pong_jobs_run starts and joins its threads each time. Code that runs
+	small batches of jobs over and over, like a training environment's
+	step, keeps a PongJobPool instead: its workers sleep on a semaphore
+	between runs.
+*/
+
+#ifndef PONG_JOBS_H
+#define PONG_JOBS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// called once per job index, worker is 0..threads-1 and is stable for the calling thread
+typedef void (*PongJobFn)(void* user, int job, int worker);
+
+// runs fn for jobs 0..count-1 on the given number of threads (the calling
+// thread is worker 0) and returns once all of them are done. Returns -1 if
+// some threads could not be started, the jobs still all run on the others
+int pong_jobs_run(int count, int threads, PongJobFn fn, void* user);
+
+typedef struct PongJobPool PongJobPool;
+
+// starts threads - 1 workers that wait for pong_jobs_pool_run, the calling
+// thread of each run is worker 0. NULL when out of memory. Workers that
+// could not be started are left out, see pong_jobs_pool_threads
+PongJobPool* pong_jobs_pool_create(int threads);
+
+// stops and joins the workers
+void pong_jobs_pool_destroy(PongJobPool* pool);
+
+// workers that are running, the calling thread included
+int pong_jobs_pool_threads(const PongJobPool* pool);
+
+// pong_jobs_run on the pool's workers. One run at a time per pool
+void pong_jobs_pool_run(PongJobPool* pool, int count, PongJobFn fn, void* user);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,245 @@
+/*
+	Program: PONG
+	Module: pong_net
+*/
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L // getaddrinfo()
+#endif
+
+#include "pong_net.h"
+#include "pong_thread.h" // pong_clock_seconds()
+
+#include <stdlib.h> // malloc()
+#include <string.h> // memcpy(), memset()
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+
+typedef int socklen_t;
+
+static int start_sockets(void)
+{
+	static int started = 0;
+	WSADATA data;
+
+	if (!started && WSAStartup(MAKEWORD(2, 2), &data) == 0)
+	{
+		started = 1;
+	}
+	return started ? 0 : -1;
+}
+
+static int set_nonblocking(SOCKET s)
+{
+	u_long on = 1;
+	return ioctlsocket(s, FIONBIO, &on) == 0 ? 0 : -1;
+}
+
+static void close_socket(SOCKET s)
+{
+	closesocket(s);
+}
+
+#else
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+typedef int SOCKET;
+#define INVALID_SOCKET (-1)
+
+static int start_sockets(void)
+{
+	return 0;
+}
+
+static int set_nonblocking(SOCKET s)
+{
+	int flags = fcntl(s, F_GETFL, 0);
+	return flags >= 0 && fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0 ? 0 : -1;
+}
+
+static void close_socket(SOCKET s)
+{
+	close(s);
+}
+
+#endif
+
+int pong_net_open(PongNet* net, int port, const PongNetFaults* faults)
+{
+	struct sockaddr_in address;
+	SOCKET s;
+
+	memset(net, 0, sizeof(*net));
+	net->socket = -1;
+	if (faults)
+	{
+		net->faults = *faults;
+	}
+	pong_rng_seed(&net->rng, (uint64_t)port, (uint64_t)(pong_clock_seconds() * 1000.0));
+
+	if (start_sockets() != 0)
+	{
+		return -1;
+	}
+	s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (s == INVALID_SOCKET)
+	{
+		return -1;
+	}
+
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons((unsigned short)port);
+	if (bind(s, (struct sockaddr*)&address, sizeof(address)) != 0 || set_nonblocking(s) != 0)
+	{
+		close_socket(s);
+		return -1;
+	}
+
+	if (net->faults.latencyMs > 0 || net->faults.jitterMs > 0)
+	{
+		net->delayed = (PongNetPacket*)malloc(PONG_NET_MAX_DELAYED * sizeof(PongNetPacket));
+		if (!net->delayed)
+		{
+			close_socket(s);
+			return -1;
+		}
+	}
+	net->socket = (long long)s;
+
+	return 0;
+}
+
+void pong_net_close(PongNet* net)
+{
+	if (net->socket != -1)
+	{
+		close_socket((SOCKET)net->socket);
+	}
+	free(net->delayed);
+	net->delayed = NULL;
+	net->socket = -1;
+}
+
+int pong_net_port(const PongNet* net)
+{
+	struct sockaddr_in address;
+	socklen_t size = sizeof(address);
+
+	if (getsockname((SOCKET)net->socket, (struct sockaddr*)&address, &size) != 0)
+	{
+		return 0;
+	}
+	return ntohs(address.sin_port);
+}
+
+int pong_net_set_peer(PongNet* net, const char* host, int port)
+{
+	struct addrinfo hints, *found = NULL;
+	struct sockaddr_in address;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	if (getaddrinfo(host, NULL, &hints, &found) != 0 || !found)
+	{
+		return -1;
+	}
+	memcpy(&address, found->ai_addr, sizeof(address));
+	freeaddrinfo(found);
+
+	address.sin_port = htons((unsigned short)port);
+	memcpy(net->peer, &address, sizeof(address));
+	net->hasPeer = 1;
+
+	return 0;
+}
+
+static void send_now(PongNet* net, const void* data, int size)
+{
+	sendto((SOCKET)net->socket, (const char*)data, size, 0, (const struct sockaddr*)net->peer, sizeof(struct sockaddr_in));
+	net->sent++;
+}
+
+void pong_net_send(PongNet* net, const void* data, int size)
+{
+	const PongNetFaults* f = &net->faults;
+	PongNetPacket* packet;
+
+	if (!net->hasPeer || size > PONG_NET_MAX_PACKET)
+	{
+		return;
+	}
+	if (f->lossPercent > 0 && pong_rng_below(&net->rng, 100) < f->lossPercent)
+	{
+		net->dropped++;
+		return;
+	}
+	if (!net->delayed)
+	{
+		send_now(net, data, size);
+		return;
+	}
+	if (net->delayedCount == PONG_NET_MAX_DELAYED)
+	{
+		net->dropped++;
+		return;
+	}
+
+	packet = &net->delayed[net->delayedCount++];
+	packet->due = pong_clock_seconds() + (f->latencyMs + (f->jitterMs > 0 ? pong_rng_below(&net->rng, f->jitterMs + 1) : 0)) / 1000.0;
+	packet->size = size;
+	memcpy(packet->data, data, size);
+}
+
+void pong_net_flush(PongNet* net)
+{
+	double now = pong_clock_seconds();
+	int i = 0;
+
+	while (i < net->delayedCount)
+	{
+		PongNetPacket* packet = &net->delayed[i];
+
+		if (packet->due <= now)
+		{
+			send_now(net, packet->data, packet->size);
+			*packet = net->delayed[--net->delayedCount]; // order doesn't matter, jitter reorders anyway
+		}
+		else
+		{
+			i++;
+		}
+	}
+}
+
+int pong_net_receive(PongNet* net, void* buffer, int size)
+{
+	struct sockaddr_in from;
+	socklen_t fromSize = sizeof(from);
+	int got = (int)recvfrom((SOCKET)net->socket, (char*)buffer, size, 0, (struct sockaddr*)&from, &fromSize);
+
+	if (got <= 0)
+	{
+		return 0; // nothing waiting, or an ICMP error from a peer that isn't up yet
+	}
+	if (!net->hasPeer)
+	{
+		memcpy(net->peer, &from, sizeof(from));
+		net->hasPeer = 1;
+	}
+	net->received++;
+
+	return got;
+}
@@ -0,0 +1,81 @@
+/*
+	Program: PONG
+	Module: pong_net
+
+	One non-blocking UDP socket talking to one peer, with faults that can
+	be switched on for testing: every outgoing packet can be held back by a
+	fixed latency plus random jitter (so packets also arrive out of order),
+	or dropped. Two copies of the game on one machine can then play over
+	loopback as if they were far apart. Winsock on Windows, BSD sockets
+	everywhere else.
+*/
+
+#ifndef PONG_NET_H
+#define PONG_NET_H
+
+#include "pong_rng.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PONG_NET_MAX_PACKET 512
+#define PONG_NET_MAX_DELAYED 256	// packets held back at once, more are dropped
+
+// what happens to packets on the way out
+typedef struct PongNetFaults
+{
+	int latencyMs;			// added to every packet
+	int jitterMs;			// plus 0..jitterMs more, packets can overtake each other
+	int lossPercent;		// 0..100
+} PongNetFaults;
+
+typedef struct PongNetPacket
+{
+	double due;				// pong_clock_seconds() when it goes out
+	int size;
+	unsigned char data[PONG_NET_MAX_PACKET];
+} PongNetPacket;
+
+typedef struct PongNet
+{
+	long long socket;		// SOCKET or int, -1 when closed
+	unsigned char peer[16];	// struct sockaddr_in
+	int hasPeer;
+
+	PongNetFaults faults;
+	PongRng rng;			// decides drops and jitter
+	PongNetPacket* delayed;	// PONG_NET_MAX_DELAYED, only with latency or jitter
+	int delayedCount;
+
+	// counters
+	int sent;
+	int dropped;
+	int received;
+} PongNet;
+
+// binds to port on every interface (0 = any free port). -1 on failure
+int pong_net_open(PongNet* net, int port, const PongNetFaults* faults);
+void pong_net_close(PongNet* net);
+
+// the port the socket ended up on
+int pong_net_port(const PongNet* net);
+
+// sends to host:port from now on. host is a name or dotted address, -1 if it doesn't resolve
+int pong_net_set_peer(PongNet* net, const char* host, int port);
+
+// queues or sends a packet to the peer, through the faults
+void pong_net_send(PongNet* net, const void* data, int size);
+
+// sends the held back packets that are due, call often
+void pong_net_flush(PongNet* net);
+
+// the next waiting packet, or 0 if there is none. Without a peer the
+// sender of the first packet becomes the peer
+int pong_net_receive(PongNet* net, void* buffer, int size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,163 @@
+/*
+	Program: PONG
+	Module: pong_profile
+*/
+
+#include "pong_profile.h"
+
+#include <limits.h> // INT_MAX
+#include <stddef.h> // offsetof()
+#include <stdio.h>  // fopen(), sscanf()
+#include <string.h> // strcmp(), strchr()
+
+typedef struct ProfileField
+{
+	const char* name;
+	size_t offset;
+	int min, max;
+} ProfileField;
+
+// sizes and speeds in pixels. PongFixed holds up to 32767; with these a
+// position plus the fastest ball still fits, at 60 ticks a second or more
+#define MAX_PIXELS 8191
+
+// the score shows as two digits
+#define MAX_SCORE 99
+
+// in PongConfig order. speedUpStep and spinStep are PongFixed, so 65536 is one pixel
+static const ProfileField fields[] = {
+	{ "scrWidth", offsetof(PongConfig, scrWidth), 1, MAX_PIXELS },
+	{ "scrHeight", offsetof(PongConfig, scrHeight), 1, MAX_PIXELS },
+	{ "paddleW", offsetof(PongConfig, paddleW), 1, MAX_PIXELS },
+	{ "paddleH", offsetof(PongConfig, paddleH), 1, MAX_PIXELS },
+	{ "ballSize", offsetof(PongConfig, ballSize), 1, MAX_PIXELS },
+	{ "paddleSpeed", offsetof(PongConfig, paddleSpeed), 1, MAX_PIXELS },
+	{ "ballSpeedCapX", offsetof(PongConfig, ballSpeedCapX), 1, MAX_PIXELS },
+	{ "ballSpeedCapY", offsetof(PongConfig, ballSpeedCapY), 1, MAX_PIXELS },
+	{ "hitsPerSpeedUp", offsetof(PongConfig, hitsPerSpeedUp), 1, INT_MAX },
+	{ "aiDetectRange", offsetof(PongConfig, aiDetectRange), 2, MAX_PIXELS },
+	{ "winScore", offsetof(PongConfig, winScore), 1, MAX_SCORE },
+	{ "physics", offsetof(PongConfig, physics), PONG_PHYSICS_CLASSIC, PONG_PHYSICS_SWEPT },
+	{ "speedUpStep", offsetof(PongConfig, speedUpStep), 0, PONG_FIXED(MAX_PIXELS) },
+	{ "spinStep", offsetof(PongConfig, spinStep), 0, PONG_FIXED(MAX_PIXELS) }
+};
+
+#define FIELD_COUNT (int)(sizeof(fields) / sizeof(fields[0]))
+
+// 0 on success, -1 for a line that isn't a known "name = value" in range
+static int parse_line(PongConfig* config, const char* line)
+{
+	char name[32];
+	char extra;
+	int value;
+	const char* p = line;
+
+	while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+	{
+		p++;
+	}
+	if (*p == '\0' || *p == '#')
+	{
+		return 0;
+	}
+
+	if (sscanf(p, "%31[A-Za-z] = %d %c", name, &value, &extra) != 2)
+	{
+		return -1;
+	}
+	for (int i = 0; i < FIELD_COUNT; i++)
+	{
+		if (strcmp(fields[i].name, name) == 0)
+		{
+			if (value < fields[i].min || value > fields[i].max)
+			{
+				return -1;
+			}
+			*(int*)((char*)config + fields[i].offset) = value;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+// non-zero if the paddles and the ball fit on the screen: both paddles
+// with room between them, and a ball that can pass a paddle
+static int sizes_fit(const PongConfig* c)
+{
+	return c->paddleH < c->scrHeight && c->ballSize < c->scrHeight
+		&& c->paddleW * 4 < c->scrWidth && c->ballSize < c->scrWidth - c->paddleW * 4;
+}
+
+int pong_profile_load(PongConfig* config, const char* path, int* badLine)
+{
+	FILE* file = fopen(path, "r");
+	PongConfig loaded = *config;
+	char line[256];
+	int number = 0;
+
+	*badLine = 0;
+	if (!file)
+	{
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), file))
+	{
+		number++;
+		// a line too long for the buffer is no field anyone wrote
+		if (!strchr(line, '\n') && !feof(file))
+		{
+			*badLine = number;
+			break;
+		}
+		if (parse_line(&loaded, line) != 0)
+		{
+			*badLine = number;
+			break;
+		}
+	}
+	fclose(file);
+
+	// all or nothing
+	if (*badLine)
+	{
+		return -1;
+	}
+	if (!sizes_fit(&loaded))
+	{
+		*badLine = -1;
+		return -1;
+	}
+	*config = loaded;
+
+	return 0;
+}
+
+int pong_profile_save(const PongConfig* config, const char* path, const char* comment)
+{
+	FILE* file = fopen(path, "w");
+	int failed;
+
+	if (!file)
+	{
+		return -1;
+	}
+
+	// every line of the comment gets its own #
+	while (comment && *comment)
+	{
+		const char* end = strchr(comment, '\n');
+		int length = end ? (int)(end - comment) : (int)strlen(comment);
+
+		fprintf(file, "# %.*s\n", length, comment);
+		comment += length + (end ? 1 : 0);
+	}
+
+	for (int i = 0; i < FIELD_COUNT; i++)
+	{
+		fprintf(file, "%s = %d\n", fields[i].name, *(const int*)((const char*)config + fields[i].offset));
+	}
+
+	failed = ferror(file);
+	return fclose(file) != 0 || failed ? -1 : 0;
+}
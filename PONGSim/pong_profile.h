@@ -0,0 +1,37 @@
+/*
+	Program: PONG
+	Module: pong_profile
+
+	Balance settings as a text file, one "name = value" line per PongConfig
+	field, with # comments. Written by the tuner and loaded by the game with
+	--profile, and easy enough to edit by hand. Fields left out keep the
+	value they had before loading.
+
+	The tick rate isn't part of a profile: every speed is already scaled to
+	it, so it stays the player's choice.
+*/
+
+#ifndef PONG_PROFILE_H
+#define PONG_PROFILE_H
+
+#include "pong_sim.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// reads a profile over config. Returns 0 on success, -1 if the file can't
+// be read, a line is unknown, malformed or out of range, or the sizes don't
+// fit together; badLine gets that line's number, 0 when the file couldn't
+// be opened and -1 when the sizes don't fit
+int pong_profile_load(PongConfig* config, const char* path, int* badLine);
+
+// writes every field, after comment (one or more lines, can be NULL) as #
+// lines. Returns -1 if the file can't be written
+int pong_profile_save(const PongConfig* config, const char* path, const char* comment);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
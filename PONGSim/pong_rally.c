@@ -0,0 +1,428 @@
+/*
+	Program: PONG
+	Module: pong_rally
+*/
+
+#include "pong_rally.h"
+
+#include <stddef.h> // offsetof()
+#include <stdlib.h> // calloc(), malloc()
+#include <string.h> // memcmp(), memcpy(), memset(), strcmp()
+
+#define COLUMN_SIZE 24		// bytes per column in the header
+#define NAME_SIZE 20
+#define MAX_COLUMNS 32		// in a file, see PongRallyReader
+
+// PongRallyChunk columns in file order. New columns go on the end, older
+// files leave them zero
+typedef struct Column
+{
+	const char* name;
+	char type;				// 'i' signed, 'u' unsigned
+	int width;				// bytes
+	size_t offset;			// of the array in PongRallyChunk
+} Column;
+
+static const Column columns[] = {
+	{ "match", 'u', 4, offsetof(PongRallyChunk, match) },
+	{ "serve_dir", 'i', 1, offsetof(PongRallyChunk, serveDir) },
+	{ "serve_speed_y", 'i', 4, offsetof(PongRallyChunk, serveSpeedY) },
+	{ "hits", 'i', 4, offsetof(PongRallyChunk, hits) },
+	{ "peak_speed_x", 'i', 4, offsetof(PongRallyChunk, peakSpeedX) },
+	{ "p1_switches", 'u', 2, offsetof(PongRallyChunk, p1Switches) },
+	{ "p2_switches", 'u', 2, offsetof(PongRallyChunk, p2Switches) },
+	{ "scorer", 'u', 1, offsetof(PongRallyChunk, scorer) },
+	{ "ticks", 'u', 4, offsetof(PongRallyChunk, ticks) }
+};
+
+#define COLUMN_COUNT (int)(sizeof(columns) / sizeof(columns[0]))
+#define HEADER_SIZE ((16 + COLUMN_COUNT * COLUMN_SIZE + 7) & ~7)
+
+//
+// little-endian fields
+//
+static unsigned int get_u16(const unsigned char* p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static unsigned int get_u32(const unsigned char* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static void put_u16(unsigned char* p, unsigned int value)
+{
+	p[0] = (unsigned char)value;
+	p[1] = (unsigned char)(value >> 8);
+}
+
+static void put_u32(unsigned char* p, unsigned int value)
+{
+	put_u16(p, value & 0xffff);
+	put_u16(p + 2, value >> 16);
+}
+
+// bytes a column of rows takes in a chunk, padded so the next one is aligned
+static size_t column_bytes(int rows, int width)
+{
+	return ((size_t)rows * width + 7) & ~(size_t)7;
+}
+
+//
+// tracking
+//
+void pong_rally_track_reset(PongRallyTracker* tracker)
+{
+	memset(tracker, 0, sizeof(*tracker));
+}
+
+int pong_rally_track(PongRallyTracker* tracker, const PongMatch* match, unsigned int events, PongRally* rally)
+{
+	PongRally* r = &tracker->rally;
+
+	if (events & PONG_EVENT_SERVE)
+	{
+		memset(r, 0, sizeof(*r));
+		r->serveDir = match->ballDirX;
+		r->serveSpeedY = match->ballSpeedY;
+		tracker->live = 1;
+		tracker->p1Color = match->p1ColorSetting;
+		tracker->p2Color = match->p2ColorSetting;
+	}
+	if (!tracker->live)
+	{
+		return 0;
+	}
+
+	r->ticks++;
+	r->hits += ((events & PONG_EVENT_HIT_P1) != 0) + ((events & PONG_EVENT_HIT_P2) != 0);
+	if (match->ballSpeedX > r->peakSpeedX)
+	{
+		r->peakSpeedX = match->ballSpeedX;
+	}
+	if (match->p1ColorSetting != tracker->p1Color)
+	{
+		r->p1Switches++;
+		tracker->p1Color = match->p1ColorSetting;
+	}
+	if (match->p2ColorSetting != tracker->p2Color)
+	{
+		r->p2Switches++;
+		tracker->p2Color = match->p2ColorSetting;
+	}
+
+	if (events & PONG_EVENT_SCORE)
+	{
+		r->scorer = match->lastPoint;
+	}
+	else if (!(events & PONG_EVENT_MENU))
+	{
+		return 0;
+	}
+	tracker->live = 0;
+	*rally = *r;
+	return 1;
+}
+
+//
+// chunks
+//
+int pong_rally_chunk_add(PongRallyChunk* chunk, const PongRally* rally)
+{
+	int i = chunk->count++;
+
+	chunk->match[i] = rally->match;
+	chunk->serveDir[i] = (int8_t)rally->serveDir;
+	chunk->serveSpeedY[i] = rally->serveSpeedY;
+	chunk->hits[i] = rally->hits;
+	chunk->peakSpeedX[i] = rally->peakSpeedX;
+	chunk->p1Switches[i] = (uint16_t)(rally->p1Switches < 65535 ? rally->p1Switches : 65535);
+	chunk->p2Switches[i] = (uint16_t)(rally->p2Switches < 65535 ? rally->p2Switches : 65535);
+	chunk->scorer[i] = (uint8_t)rally->scorer;
+	chunk->ticks[i] = (uint32_t)rally->ticks;
+
+	return chunk->count == PONG_RALLY_CHUNK_ROWS;
+}
+
+void pong_rally_chunk_get(const PongRallyChunk* chunk, int i, PongRally* rally)
+{
+	rally->match = chunk->match[i];
+	rally->serveDir = chunk->serveDir[i];
+	rally->serveSpeedY = chunk->serveSpeedY[i];
+	rally->hits = chunk->hits[i];
+	rally->peakSpeedX = chunk->peakSpeedX[i];
+	rally->p1Switches = chunk->p1Switches[i];
+	rally->p2Switches = chunk->p2Switches[i];
+	rally->scorer = chunk->scorer[i];
+	rally->ticks = (int)chunk->ticks[i];
+}
+
+// the largest a chunk gets in the file, with the columns this version writes
+static size_t max_chunk_bytes(void)
+{
+	size_t size = 8;
+
+	for (int c = 0; c < COLUMN_COUNT; c++)
+	{
+		size += column_bytes(PONG_RALLY_CHUNK_ROWS, columns[c].width);
+	}
+	return size;
+}
+
+//
+// writing
+//
+int pong_rally_writer_open(PongRallyWriter* writer, const char* path)
+{
+	unsigned char header[HEADER_SIZE];
+
+	memset(writer, 0, sizeof(*writer));
+	memset(header, 0, sizeof(header));
+
+	memcpy(header, "PRLY", 4);
+	put_u32(header + 4, PONG_RALLY_VERSION);
+	put_u32(header + 8, COLUMN_COUNT);
+	put_u32(header + 12, HEADER_SIZE);
+	for (int c = 0; c < COLUMN_COUNT; c++)
+	{
+		unsigned char* p = header + 16 + c * COLUMN_SIZE;
+
+		memcpy(p, columns[c].name, strlen(columns[c].name));
+		p[NAME_SIZE] = (unsigned char)columns[c].type;
+		p[NAME_SIZE + 1] = (unsigned char)columns[c].width;
+	}
+
+	writer->chunk = (PongRallyChunk*)calloc(1, sizeof(PongRallyChunk));
+	writer->bytes = (unsigned char*)malloc(max_chunk_bytes());
+	writer->file = writer->chunk && writer->bytes ? fopen(path, "wb") : NULL;
+	if (!writer->file || fwrite(header, sizeof(header), 1, writer->file) != 1)
+	{
+		if (writer->file)
+		{
+			fclose(writer->file);
+		}
+		free(writer->chunk);
+		free(writer->bytes);
+		memset(writer, 0, sizeof(*writer));
+		return -1;
+	}
+
+	return 0;
+}
+
+void pong_rally_writer_add(PongRallyWriter* writer, const PongRally* rally)
+{
+	if (pong_rally_chunk_add(writer->chunk, rally))
+	{
+		pong_rally_writer_write(writer, writer->chunk);
+	}
+}
+
+int pong_rally_writer_write(PongRallyWriter* writer, PongRallyChunk* chunk)
+{
+	int rows = chunk->count;
+	unsigned char* p = writer->bytes;
+
+	if (rows == 0)
+	{
+		return writer->failed ? -1 : 0;
+	}
+
+	put_u32(p, rows);
+	put_u32(p + 4, 0);
+	p += 8;
+	for (int c = 0; c < COLUMN_COUNT; c++)
+	{
+		const char* array = (const char*)chunk + columns[c].offset;
+		size_t size = column_bytes(rows, columns[c].width);
+
+		memset(p, 0, size);
+		switch (columns[c].width) {
+		case 1:
+			memcpy(p, array, rows);
+			break;
+		case 2:
+			for (int i = 0; i < rows; i++)
+			{
+				put_u16(p + i * 2, ((const uint16_t*)array)[i]);
+			}
+			break;
+		case 4:
+			for (int i = 0; i < rows; i++)
+			{
+				put_u32(p + i * 4, ((const uint32_t*)array)[i]);
+			}
+			break;
+		}
+		p += size;
+	}
+
+	if (fwrite(writer->bytes, p - writer->bytes, 1, writer->file) != 1)
+	{
+		writer->failed = 1;
+	}
+	writer->rows += rows;
+	chunk->count = 0;
+
+	return writer->failed ? -1 : 0;
+}
+
+int pong_rally_writer_close(PongRallyWriter* writer)
+{
+	int result;
+
+	pong_rally_writer_write(writer, writer->chunk);
+	result = writer->failed ? -1 : 0;
+	if (fclose(writer->file) != 0)
+	{
+		result = -1;
+	}
+	free(writer->chunk);
+	free(writer->bytes);
+	memset(writer, 0, sizeof(*writer));
+
+	return result;
+}
+
+//
+// reading
+//
+int pong_rally_reader_open(PongRallyReader* reader, const char* path)
+{
+	unsigned char fixed[16];
+	unsigned char column[COLUMN_SIZE];
+	unsigned int headerSize;
+	size_t chunkBytes = 8;
+
+	memset(reader, 0, sizeof(*reader));
+	reader->file = fopen(path, "rb");
+	if (!reader->file)
+	{
+		return -1;
+	}
+	if (fread(fixed, sizeof(fixed), 1, reader->file) != 1 || memcmp(fixed, "PRLY", 4) != 0
+		|| get_u32(fixed + 4) != PONG_RALLY_VERSION || get_u32(fixed + 8) > MAX_COLUMNS)
+	{
+		pong_rally_reader_close(reader);
+		return -1;
+	}
+	reader->columns = (int)get_u32(fixed + 8);
+	headerSize = get_u32(fixed + 12);
+	if (headerSize < 16 + (unsigned int)reader->columns * COLUMN_SIZE)
+	{
+		pong_rally_reader_close(reader);
+		return -1;
+	}
+
+	for (int c = 0; c < reader->columns; c++)
+	{
+		char name[NAME_SIZE + 1];
+
+		if (fread(column, sizeof(column), 1, reader->file) != 1)
+		{
+			pong_rally_reader_close(reader);
+			return -1;
+		}
+		memcpy(name, column, NAME_SIZE);
+		name[NAME_SIZE] = 0;
+		reader->widths[c] = column[NAME_SIZE + 1];
+		if (reader->widths[c] != 1 && reader->widths[c] != 2 && reader->widths[c] != 4 && reader->widths[c] != 8)
+		{
+			pong_rally_reader_close(reader);
+			return -1;
+		}
+		chunkBytes += column_bytes(PONG_RALLY_CHUNK_ROWS, reader->widths[c]);
+
+		reader->known[c] = -1;
+		for (int k = 0; k < COLUMN_COUNT; k++)
+		{
+			if (strcmp(name, columns[k].name) == 0 && reader->widths[c] == columns[k].width)
+			{
+				reader->known[c] = k;
+			}
+		}
+	}
+
+	reader->bytes = (unsigned char*)malloc(chunkBytes);
+	if (!reader->bytes || fseek(reader->file, headerSize, SEEK_SET) != 0)
+	{
+		pong_rally_reader_close(reader);
+		return -1;
+	}
+
+	return 0;
+}
+
+int pong_rally_reader_next(PongRallyReader* reader, PongRallyChunk* chunk)
+{
+	unsigned char head[8];
+	size_t size = 0;
+	const unsigned char* p = reader->bytes;
+	int rows;
+	size_t got;
+
+	chunk->count = 0;
+	got = fread(head, 1, sizeof(head), reader->file);
+	if (got == 0)
+	{
+		return 0;
+	}
+	rows = (int)get_u32(head);
+	if (got != sizeof(head) || rows <= 0 || rows > PONG_RALLY_CHUNK_ROWS)
+	{
+		return -1;
+	}
+
+	for (int c = 0; c < reader->columns; c++)
+	{
+		size += column_bytes(rows, reader->widths[c]);
+	}
+	if (fread(reader->bytes, size, 1, reader->file) != 1)
+	{
+		return -1;
+	}
+
+	memset(chunk, 0, sizeof(*chunk));
+	for (int c = 0; c < reader->columns; c++)
+	{
+		int k = reader->known[c];
+
+		if (k >= 0)
+		{
+			char* array = (char*)chunk + columns[k].offset;
+
+			switch (columns[k].width) {
+			case 1:
+				memcpy(array, p, rows);
+				break;
+			case 2:
+				for (int i = 0; i < rows; i++)
+				{
+					((uint16_t*)array)[i] = (uint16_t)get_u16(p + i * 2);
+				}
+				break;
+			case 4:
+				for (int i = 0; i < rows; i++)
+				{
+					((uint32_t*)array)[i] = get_u32(p + i * 4);
+				}
+				break;
+			}
+		}
+		p += column_bytes(rows, reader->widths[c]);
+	}
+	chunk->count = rows;
+
+	return rows;
+}
+
+void pong_rally_reader_close(PongRallyReader* reader)
+{
+	if (reader->file)
+	{
+		fclose(reader->file);
+	}
+	free(reader->bytes);
+	memset(reader, 0, sizeof(*reader));
+}
@@ -0,0 +1,140 @@
+/*
+	Program: PONG
+	Module: pong_rally
+
+	Per-rally records, from the serve to the point, and a column-chunked
+	file to keep hundreds of millions of them in. A tracker watches a match
+	tick by tick and hands back a record each time a rally ends; records
+	are gathered a column at a time in chunks and written a whole chunk at
+	once, so reading back one column of every rally never touches the rest.
+
+	File layout, all little-endian:
+
+		 0  "PRLY"
+		 4  u32 version (PONG_RALLY_VERSION)
+		 8  u32 column count
+		12  u32 header size, where the first chunk starts
+		16  24 bytes per column: name (NUL padded, 20 bytes), type ('i' or
+		    'u'), width in bytes (1, 2 or 4), 2 bytes zero
+		..  chunks, to the end of the file:
+		        u32 row count, u32 zero
+		        each column in header order: rows values of its width,
+		        zero padded to a multiple of 8 bytes
+
+	Every column of a chunk is a plain array that starts 8-byte aligned,
+	so a mapped file can be viewed in place, e.g. one numpy.frombuffer per
+	column per chunk. Rows from different threads may be interleaved chunk
+	by chunk; the match column tells the games apart.
+*/
+
+#ifndef PONG_RALLY_H
+#define PONG_RALLY_H
+
+#include <stdio.h>  // FILE
+
+#include "pong_sim.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PONG_RALLY_VERSION 1
+#define PONG_RALLY_CHUNK_ROWS 65536
+
+// one rally, as it is written
+typedef struct PongRally
+{
+	uint32_t match;			// caller's game number, e.g. the stream it was played on
+	int serveDir;			// ballDirX as served: 1 towards P2, -1 towards P1
+	PongFixed serveSpeedY;	// ballSpeedY as served
+	int hits;				// paddle hits
+	PongFixed peakSpeedX;	// fastest ballSpeedX in the rally
+	int p1Switches;			// RWG paddle colour changes
+	int p2Switches;
+	int scorer;				// 1 or 2, 0 if the game was left mid-rally
+	int ticks;				// from the serve to the point, both included
+} PongRally;
+
+// follows one match. Zero it, or pong_rally_track_reset, before the first tick
+typedef struct PongRallyTracker
+{
+	int live;				// a rally has been served and not finished
+	PongRally rally;		// so far
+	int p1Color;			// colour settings last tick, to count switches
+	int p2Color;
+} PongRallyTracker;
+
+void pong_rally_track_reset(PongRallyTracker* tracker);
+
+// call after every pong_sim_step with the events it returned. Returns 1 and
+// fills in *rally (match left 0) when a rally ended on this tick
+int pong_rally_track(PongRallyTracker* tracker, const PongMatch* match, unsigned int events, PongRally* rally);
+
+// up to PONG_RALLY_CHUNK_ROWS rallies, a column each. About 1.6 MB, allocate it
+typedef struct PongRallyChunk
+{
+	int count;
+	uint32_t match[PONG_RALLY_CHUNK_ROWS];
+	int8_t serveDir[PONG_RALLY_CHUNK_ROWS];
+	int32_t serveSpeedY[PONG_RALLY_CHUNK_ROWS];
+	int32_t hits[PONG_RALLY_CHUNK_ROWS];
+	int32_t peakSpeedX[PONG_RALLY_CHUNK_ROWS];
+	uint16_t p1Switches[PONG_RALLY_CHUNK_ROWS];		// saturate at 65535
+	uint16_t p2Switches[PONG_RALLY_CHUNK_ROWS];
+	uint8_t scorer[PONG_RALLY_CHUNK_ROWS];
+	uint32_t ticks[PONG_RALLY_CHUNK_ROWS];
+} PongRallyChunk;
+
+// appends a row, returns non-zero once the chunk is full
+int pong_rally_chunk_add(PongRallyChunk* chunk, const PongRally* rally);
+
+typedef struct PongRallyWriter
+{
+	FILE* file;
+	PongRallyChunk* chunk;	// pong_rally_writer_add's rows, not yet written
+	unsigned char* bytes;	// one chunk encoded
+	long long rows;			// written so far
+	int failed;
+} PongRallyWriter;
+
+// starts a new file, -1 if it can't be written
+int pong_rally_writer_open(PongRallyWriter* writer, const char* path);
+
+// buffers one rally, writing a chunk each time enough have been added
+void pong_rally_writer_add(PongRallyWriter* writer, const PongRally* rally);
+
+// writes a chunk filled by the caller, e.g. one per thread, and empties it.
+// Not thread safe: hold a lock around it. -1 if writing failed
+int pong_rally_writer_write(PongRallyWriter* writer, PongRallyChunk* chunk);
+
+// writes whatever is buffered and closes the file. -1 if any write failed
+int pong_rally_writer_close(PongRallyWriter* writer);
+
+// reads a file back a chunk at a time
+typedef struct PongRallyReader
+{
+	FILE* file;
+	unsigned char* bytes;
+	int columns;			// in the file, columns this version doesn't know are skipped
+	int widths[32];
+	int known[32];			// index into this version's columns, -1 if unknown
+} PongRallyReader;
+
+// -1 if it can't be read or isn't a rally file
+int pong_rally_reader_open(PongRallyReader* reader, const char* path);
+
+// fills chunk with the next chunk's rows and returns how many, 0 at the end
+// of the file, -1 if it is cut short or damaged. Columns the file doesn't
+// have are left zero
+int pong_rally_reader_next(PongRallyReader* reader, PongRallyChunk* chunk);
+
+void pong_rally_reader_close(PongRallyReader* reader);
+
+// row i of a chunk as a record
+void pong_rally_chunk_get(const PongRallyChunk* chunk, int i, PongRally* rally);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
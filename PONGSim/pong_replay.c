@@ -0,0 +1,496 @@
+/*
+	Program: PONG
+	Module: pong_replay
+*/
+
+#include "pong_replay.h"
+
+#include <stdlib.h> // malloc(), realloc()
+#include <string.h> // memcmp(), memset()
+
+#define HEADER_FIXED 48		// bytes before the config fields
+
+// PongConfig fields in file order. New fields go on the end, older files
+// leave them at their defaults
+static const size_t configFields[] = {
+	offsetof(PongConfig, scrWidth),
+	offsetof(PongConfig, scrHeight),
+	offsetof(PongConfig, paddleW),
+	offsetof(PongConfig, paddleH),
+	offsetof(PongConfig, ballSize),
+	offsetof(PongConfig, paddleSpeed),
+	offsetof(PongConfig, ballSpeedCapX),
+	offsetof(PongConfig, ballSpeedCapY),
+	offsetof(PongConfig, hitsPerSpeedUp),
+	offsetof(PongConfig, aiDetectRange),
+	offsetof(PongConfig, winScore),
+	offsetof(PongConfig, physics),
+	offsetof(PongConfig, tickRate),
+	offsetof(PongConfig, speedUpStep),
+	offsetof(PongConfig, spinStep)
+};
+
+#define CONFIG_FIELD_COUNT (int)(sizeof(configFields) / sizeof(configFields[0]))
+
+//
+// little-endian fields
+//
+static unsigned int get_u16(const unsigned char* p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static unsigned int get_u32(const unsigned char* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static uint64_t get_u64(const unsigned char* p)
+{
+	return get_u32(p) | ((uint64_t)get_u32(p + 4) << 32);
+}
+
+static void put_u16(unsigned char* p, unsigned int value)
+{
+	p[0] = (unsigned char)value;
+	p[1] = (unsigned char)(value >> 8);
+}
+
+static void put_u32(unsigned char* p, unsigned int value)
+{
+	put_u16(p, value & 0xffff);
+	put_u16(p + 2, value >> 16);
+}
+
+static void put_u64(unsigned char* p, uint64_t value)
+{
+	put_u32(p, (unsigned int)value);
+	put_u32(p + 4, (unsigned int)(value >> 32));
+}
+
+int pong_replay_parse(PongReplay* replay, const void* data, size_t size)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	unsigned int headerSize, fieldCount;
+
+	memset(replay, 0, sizeof(*replay));
+	if (size < HEADER_FIXED || memcmp(p, "PREC", 4) != 0 || get_u32(p + 4) != PONG_REPLAY_VERSION)
+	{
+		return -1;
+	}
+
+	headerSize = get_u32(p + 8);
+	fieldCount = get_u32(p + 44);
+	if (fieldCount > (size - HEADER_FIXED) / 4 || headerSize < HEADER_FIXED + fieldCount * 4 || headerSize > size)
+	{
+		return -1;
+	}
+
+	replay->tickRate = (int)get_u32(p + 12);
+	replay->seed = get_u64(p + 16);
+	replay->stream = get_u64(p + 24);
+	replay->tickCount = (int)get_u32(p + 32);
+	replay->p1Score = (int)get_u32(p + 36);
+	replay->p2Score = (int)get_u32(p + 40);
+	if (replay->tickCount < 0 || (size - headerSize) / 2 < (size_t)replay->tickCount)
+	{
+		return -1;
+	}
+
+	pong_config_default(&replay->config);
+	for (int i = 0; i < (int)fieldCount && i < CONFIG_FIELD_COUNT; i++)
+	{
+		*(int*)((char*)&replay->config + configFields[i]) = (int)get_u32(p + HEADER_FIXED + i * 4);
+	}
+
+	replay->inputs = p + headerSize;
+
+	// checkpoints, if they are there and in a layout this build knows
+	{
+		size_t at = headerSize + (size_t)replay->tickCount * 2;
+		unsigned int every, fields, count;
+
+		if (size - at >= 12)
+		{
+			every = get_u32(p + at);
+			fields = get_u32(p + at + 4);
+			count = get_u32(p + at + 8);
+			if (every > 0 && fields == PONG_SIM_STATE_FIELDS && count <= (unsigned int)replay->tickCount / every
+				&& (size - at - 12) / (fields * 4) >= count)
+			{
+				replay->checkEvery = (int)every;
+				replay->checkCount = (int)count;
+				replay->checks = p + at + 12;
+			}
+
+			// checksums follow the checkpoints, whatever their layout
+			if (fields == 0 || (size - at - 12) / 4 / fields >= count)
+			{
+				at += 12 + (size_t)count * fields * 4;
+				if (size - at >= 4 && get_u32(p + at) == (unsigned int)replay->tickCount + 1
+					&& (size - at - 4) / 4 >= (size_t)replay->tickCount + 1)
+				{
+					replay->sums = p + at + 4;
+
+					// the seeded state after them, recordings from before it was kept stop here
+					at += 4 + ((size_t)replay->tickCount + 1) * 4;
+					if ((size - at) / 4 >= PONG_SIM_STATE_FIELDS)
+					{
+						replay->start = p + at;
+					}
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+
+int pong_replay_load(PongReplay* replay, const char* path)
+{
+	FILE* file = fopen(path, "rb");
+	void* memory;
+	long size;
+
+	memset(replay, 0, sizeof(*replay));
+	if (!file)
+	{
+		return -1;
+	}
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	memory = malloc(size > 0 ? size : 1);
+	if (!memory || size < 0 || fread(memory, 1, size, file) != (size_t)size || pong_replay_parse(replay, memory, size) != 0)
+	{
+		free(memory);
+		fclose(file);
+		return -1;
+	}
+	fclose(file);
+	replay->memory = memory;
+
+	return 0;
+}
+
+void pong_replay_free(PongReplay* replay)
+{
+	free(replay->memory);
+	memset(replay, 0, sizeof(*replay));
+}
+
+PongInput pong_replay_input(const PongReplay* replay, int tick)
+{
+	return get_u16(replay->inputs + tick * 2);
+}
+
+int pong_replay_run(const PongReplay* replay, PongMatch* match)
+{
+	pong_sim_init(match, &replay->config);
+	pong_sim_seed(match, replay->seed, replay->stream);
+
+	for (int tick = 0; tick < replay->tickCount; tick++)
+	{
+		pong_sim_step(match, pong_replay_input(replay, tick));
+	}
+
+	return match->p1Score == replay->p1Score && match->p2Score == replay->p2Score ? 0 : -1;
+}
+
+static void get_state(const unsigned char* p, int32_t fields[PONG_SIM_STATE_FIELDS])
+{
+	for (int i = 0; i < PONG_SIM_STATE_FIELDS; i++)
+	{
+		fields[i] = (int32_t)get_u32(p + i * 4);
+	}
+}
+
+void pong_replay_checkpoint(const PongReplay* replay, int n, int32_t fields[PONG_SIM_STATE_FIELDS])
+{
+	get_state(replay->checks + (size_t)n * PONG_SIM_STATE_FIELDS * 4, fields);
+}
+
+void pong_replay_start_state(const PongReplay* replay, int32_t fields[PONG_SIM_STATE_FIELDS])
+{
+	get_state(replay->start, fields);
+}
+
+uint32_t pong_replay_sum(const PongReplay* replay, int tick)
+{
+	return get_u32(replay->sums + (size_t)tick * 4);
+}
+
+//
+// steps from's copy on from tick start to end, returning the first tick
+// whose checksum isn't the recorded one. -1 without checksums, or with
+// ones from a build that hashes differently: start's has to match first
+//
+static int first_drift(const PongReplay* replay, const PongMatch* from, int start, int end)
+{
+	PongMatch match = *from;
+
+	if (!replay->sums || pong_sim_checksum(&match) != pong_replay_sum(replay, start))
+	{
+		return -1;
+	}
+	for (int tick = start; tick < end; tick++)
+	{
+		pong_sim_step(&match, pong_replay_input(replay, tick));
+		if (pong_sim_checksum(&match) != pong_replay_sum(replay, tick + 1))
+		{
+			return tick + 1;
+		}
+	}
+	return -1;
+}
+
+void pong_replay_verify(const PongReplay* replay, PongMatch* match, PongReplayCheck* check)
+{
+	PongMatch last;		// at the last checkpoint that matched, or the start
+	int lastTick = 0;
+	int next = 0;		// checkpoint
+
+	memset(check, 0, sizeof(*check));
+	check->checkpoint = -1;
+	check->tick = -1;
+	pong_sim_init(match, &replay->config);
+	pong_sim_seed(match, replay->seed, replay->stream);
+	last = *match;
+
+	// drift before the first tick, e.g. a change to pong_sim_init
+	if (replay->start)
+	{
+		int32_t recorded[PONG_SIM_STATE_FIELDS];
+		int32_t state[PONG_SIM_STATE_FIELDS];
+
+		pong_replay_start_state(replay, recorded);
+		pong_sim_state(match, state);
+		if (memcmp(recorded, state, sizeof(state)) != 0)
+		{
+			check->tick = 0;
+			return;
+		}
+	}
+
+	for (int tick = 0; tick < replay->tickCount; tick++)
+	{
+		pong_sim_step(match, pong_replay_input(replay, tick));
+
+		if (next < replay->checkCount && tick + 1 == (next + 1) * replay->checkEvery)
+		{
+			int32_t recorded[PONG_SIM_STATE_FIELDS];
+			int32_t state[PONG_SIM_STATE_FIELDS];
+
+			pong_replay_checkpoint(replay, next, recorded);
+			pong_sim_state(match, state);
+			if (memcmp(recorded, state, sizeof(state)) != 0)
+			{
+				check->checkpoint = next;
+				check->tick = first_drift(replay, &last, lastTick, tick + 1);
+				return;
+			}
+			check->checked++;
+			next++;
+			last = *match;
+			lastTick = tick + 1;
+		}
+	}
+
+	check->scoreMatched = match->p1Score == replay->p1Score && match->p2Score == replay->p2Score;
+}
+
+int pong_recorder_open(PongRecorder* recorder, const char* path, const PongConfig* config, uint64_t seed, uint64_t stream, int tickRate, int checkEvery)
+{
+	unsigned char header[HEADER_FIXED + CONFIG_FIELD_COUNT * 4];
+
+	memset(recorder, 0, sizeof(*recorder));
+	memset(header, 0, sizeof(header));
+
+	memcpy(header, "PREC", 4);
+	put_u32(header + 4, PONG_REPLAY_VERSION);
+	put_u32(header + 8, sizeof(header));
+	put_u32(header + 12, tickRate);
+	put_u64(header + 16, seed);
+	put_u64(header + 24, stream);
+	put_u32(header + 44, CONFIG_FIELD_COUNT);
+	for (int i = 0; i < CONFIG_FIELD_COUNT; i++)
+	{
+		put_u32(header + HEADER_FIXED + i * 4, *(const int*)((const char*)config + configFields[i]));
+	}
+
+	recorder->checkEvery = checkEvery > 0 ? checkEvery : 0;
+	if (recorder->checkEvery)
+	{
+		PongMatch match;
+
+		// the seeded match's checksum, as pong_replay_run starts from
+		pong_sim_init(&match, config);
+		pong_sim_seed(&match, seed, stream);
+		pong_sim_state(&match, recorder->start);
+		recorder->sums = (uint32_t*)malloc(1024 * sizeof(uint32_t));
+		if (recorder->sums)
+		{
+			recorder->sums[0] = pong_sim_checksum(&match);
+			recorder->sumCount = 1;
+			recorder->sumCapacity = 1024;
+		}
+	}
+	recorder->file = fopen(path, "wb");
+	if (!recorder->file)
+	{
+		free(recorder->sums);
+		recorder->sums = NULL;
+		return -1;
+	}
+	if (fwrite(header, sizeof(header), 1, recorder->file) != 1)
+	{
+		fclose(recorder->file);
+		recorder->file = NULL;
+		free(recorder->sums);
+		recorder->sums = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+void pong_recorder_add(PongRecorder* recorder, PongInput input)
+{
+	unsigned char bytes[2];
+
+	put_u16(bytes, input); // every PONG_INPUT_* bit fits in 16
+	fwrite(bytes, 2, 1, recorder->file);
+	recorder->tickCount++;
+}
+
+void pong_recorder_state(PongRecorder* recorder, const PongMatch* match)
+{
+	if (recorder->sums)
+	{
+		if (recorder->sumCount == recorder->sumCapacity)
+		{
+			uint32_t* sums = (uint32_t*)realloc(recorder->sums, (size_t)recorder->sumCapacity * 2 * sizeof(uint32_t));
+
+			// out of memory: no checksums at all, they have to cover every tick
+			if (!sums)
+			{
+				free(recorder->sums);
+				recorder->sums = NULL;
+			}
+			else
+			{
+				recorder->sums = sums;
+				recorder->sumCapacity *= 2;
+			}
+		}
+		if (recorder->sums)
+		{
+			recorder->sums[recorder->sumCount++] = pong_sim_checksum(match);
+		}
+	}
+
+	if (recorder->checkEvery == 0 || recorder->tickCount % recorder->checkEvery != 0)
+	{
+		return;
+	}
+	if (recorder->checkCount == recorder->checkCapacity)
+	{
+		int capacity = recorder->checkCapacity ? recorder->checkCapacity * 2 : 64;
+		int32_t* checks = (int32_t*)realloc(recorder->checks, (size_t)capacity * PONG_SIM_STATE_FIELDS * sizeof(int32_t));
+
+		// out of memory: stop taking checkpoints, the ones so far still count
+		if (!checks)
+		{
+			recorder->checkEvery = 0;
+			return;
+		}
+		recorder->checks = checks;
+		recorder->checkCapacity = capacity;
+	}
+	pong_sim_state(match, recorder->checks + (size_t)recorder->checkCount * PONG_SIM_STATE_FIELDS);
+	recorder->checkCount++;
+}
+
+// the checkpoints, straight after the inputs
+static int write_checkpoints(PongRecorder* recorder)
+{
+	unsigned char bytes[PONG_SIM_STATE_FIELDS * 4];
+
+	put_u32(bytes, recorder->checkCount ? recorder->checkEvery : 0);
+	put_u32(bytes + 4, PONG_SIM_STATE_FIELDS);
+	put_u32(bytes + 8, recorder->checkCount);
+	if (fwrite(bytes, 12, 1, recorder->file) != 1)
+	{
+		return -1;
+	}
+	for (int n = 0; n < recorder->checkCount; n++)
+	{
+		for (int i = 0; i < PONG_SIM_STATE_FIELDS; i++)
+		{
+			put_u32(bytes + i * 4, (unsigned int)recorder->checks[n * PONG_SIM_STATE_FIELDS + i]);
+		}
+		if (fwrite(bytes, sizeof(bytes), 1, recorder->file) != 1)
+		{
+			return -1;
+		}
+	}
+	return 0;
+}
+
+// the checksums and the seeded state, straight after the checkpoints
+static int write_sums(PongRecorder* recorder)
+{
+	unsigned char bytes[PONG_SIM_STATE_FIELDS * 4];
+	int count = recorder->sums && recorder->sumCount == recorder->tickCount + 1 ? recorder->sumCount : 0;
+
+	put_u32(bytes, count);
+	if (fwrite(bytes, 4, 1, recorder->file) != 1)
+	{
+		return -1;
+	}
+	for (int i = 0; i < count; i++)
+	{
+		put_u32(bytes, recorder->sums[i]);
+		if (fwrite(bytes, 4, 1, recorder->file) != 1)
+		{
+			return -1;
+		}
+	}
+	if (count > 0)
+	{
+		for (int i = 0; i < PONG_SIM_STATE_FIELDS; i++)
+		{
+			put_u32(bytes + i * 4, (unsigned int)recorder->start[i]);
+		}
+		if (fwrite(bytes, sizeof(bytes), 1, recorder->file) != 1)
+		{
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int pong_recorder_close(PongRecorder* recorder, const PongMatch* match)
+{
+	unsigned char footer[12];
+	int result = write_checkpoints(recorder) == 0 && write_sums(recorder) == 0 ? 0 : -1;
+
+	// tick count and final score sit together in the header
+	put_u32(footer, recorder->tickCount);
+	put_u32(footer + 4, match->p1Score);
+	put_u32(footer + 8, match->p2Score);
+	if (fseek(recorder->file, 32, SEEK_SET) != 0 || fwrite(footer, sizeof(footer), 1, recorder->file) != 1)
+	{
+		result = -1;
+	}
+	if (fclose(recorder->file) != 0)
+	{
+		result = -1;
+	}
+	free(recorder->checks);
+	free(recorder->sums);
+	memset(recorder, 0, sizeof(*recorder));
+
+	return result;
+}
@@ -0,0 +1,154 @@
+/*
+	Program: PONG
+	Module: pong_replay
+
+	Recordings of a session: the config, the seed and the input bitmask of
+	every tick. The simulation is deterministic, so that is enough to play a
+	match back exactly, at any speed.
+
+	File layout, all little-endian, fixed offsets so a mapped file can be
+	read in place:
+
+		 0  "PREC"
+		 4  u32 version (PONG_REPLAY_VERSION)
+		 8  u32 header size, where the inputs start
+		12  u32 tick rate it was recorded at
+		16  u64 seed
+		24  u64 stream
+		32  u32 tick count
+		36  i32 p1 score at the end
+		40  i32 p2 score at the end
+		44  u32 config field count
+		48  i32 config fields, in PongConfig order
+		..  u16 input per tick
+		..  checkpoints, optional:
+		        u32 ticks between them (0 for none)
+		        u32 fields per checkpoint (PONG_SIM_STATE_FIELDS)
+		        u32 checkpoint count
+		        i32 pong_sim_state fields after every interval-th tick
+		..  checksums, optional:
+		        u32 count (tick count + 1, or 0 for none)
+		        u32 pong_sim_checksum before the first tick and after each
+		        i32 pong_sim_state fields before the first tick, if count > 0
+
+	The checkpoints show where a replay drifts from the recording, e.g.
+	after a compiler or platform change: pong_replay_verify stops at the
+	first one that differs, with both states to compare, then steps the
+	ticks since the checkpoint before it again against the checksums to
+	find the exact tick. A seeded match that already differs from the
+	recording's is reported as drift at tick 0.
+*/
+
+#ifndef PONG_REPLAY_H
+#define PONG_REPLAY_H
+
+#include <stddef.h> // size_t
+#include <stdio.h>  // FILE
+
+#include "pong_sim.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PONG_REPLAY_VERSION 1
+#define PONG_REPLAY_CHECK_EVERY 60	// ticks between checkpoints by default, a second at the default tick rate
+
+typedef struct PongReplay
+{
+	PongConfig config;
+	uint64_t seed;
+	uint64_t stream;
+	int tickRate;
+	int tickCount;
+	int p1Score;			// when the recording stopped
+	int p2Score;
+
+	const unsigned char* inputs;	// tickCount u16s, points into the parsed data
+	int checkEvery;			// ticks between checkpoints, 0 if there are none
+	int checkCount;
+	const unsigned char* checks;	// checkCount * PONG_SIM_STATE_FIELDS i32s
+	const unsigned char* sums;		// tickCount + 1 u32 checksums, NULL if there are none
+	const unsigned char* start;		// the seeded match's PONG_SIM_STATE_FIELDS i32s, NULL if not kept
+	void* memory;			// file contents, if pong_replay_load read them
+} PongReplay;
+
+// reads a recording from memory, e.g. a mapped file. data must outlive the replay.
+// returns 0 on success, -1 if it isn't a recording or is cut short
+int pong_replay_parse(PongReplay* replay, const void* data, size_t size);
+
+// reads a whole file and parses it, -1 on failure
+int pong_replay_load(PongReplay* replay, const char* path);
+void pong_replay_free(PongReplay* replay);
+
+// input for one tick
+PongInput pong_replay_input(const PongReplay* replay, int tick);
+
+// plays every tick into match (initialised and seeded from the recording).
+// returns 0 if the final score is the recorded one
+int pong_replay_run(const PongReplay* replay, PongMatch* match);
+
+// the state the recording had after checkpoint n's tick, (n + 1) * checkEvery
+void pong_replay_checkpoint(const PongReplay* replay, int n, int32_t fields[PONG_SIM_STATE_FIELDS]);
+
+// the recorded pong_sim_checksum after tick ticks, 0 for the seeded match.
+// Only if replay->sums is set
+uint32_t pong_replay_sum(const PongReplay* replay, int tick);
+
+// the state the recording had before the first tick. Only if replay->start is set
+void pong_replay_start_state(const PongReplay* replay, int32_t fields[PONG_SIM_STATE_FIELDS]);
+
+typedef struct PongReplayCheck
+{
+	int checkpoint;			// the first that differed, -1 if none did
+	int checked;			// checkpoints that matched before it
+	int tick;				// the state first differed after this many ticks, -1 if there
+							// are no checksums to tell: somewhere up to the checkpoint.
+							// 0, with checkpoint -1, if the seeded match already did
+	int scoreMatched;		// the final score is the recorded one, after a full run
+} PongReplayCheck;
+
+// pong_replay_run, comparing the state at every checkpoint on the way. It
+// stops at the first checkpoint that differs, with match at that tick, and
+// finds the tick the drift started from the checksums of the ticks since
+// the checkpoint before it. It stops before the first tick if the seeded
+// match isn't the recording's
+void pong_replay_verify(const PongReplay* replay, PongMatch* match, PongReplayCheck* check);
+
+typedef struct PongRecorder
+{
+	FILE* file;
+	int tickCount;
+
+	// checkpoints, written after the inputs when the recording closes
+	int checkEvery;
+	int32_t* checks;
+	int checkCount;
+	int checkCapacity;
+
+	// a checksum per tick, with the seeded match first, while checkpoints are on
+	uint32_t* sums;
+	int sumCount;
+	int sumCapacity;
+	int32_t start[PONG_SIM_STATE_FIELDS];	// the seeded match, written with the checksums
+} PongRecorder;
+
+// starts a recording with a checkpoint every checkEvery ticks (0 for none),
+// -1 if the file can't be written
+int pong_recorder_open(PongRecorder* recorder, const char* path, const PongConfig* config, uint64_t seed, uint64_t stream, int tickRate, int checkEvery);
+
+// appends one tick, the input exactly as it went into pong_sim_step
+void pong_recorder_add(PongRecorder* recorder, PongInput input);
+
+// after the tick's pong_sim_step: keeps its checksum, and the state if a
+// checkpoint is due
+void pong_recorder_state(PongRecorder* recorder, const PongMatch* match);
+
+// fills in the tick count and final score, and closes the file. -1 if writing failed
+int pong_recorder_close(PongRecorder* recorder, const PongMatch* match);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
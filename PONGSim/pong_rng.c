@@ -0,0 +1,32 @@
+/*
+	Program: PONG
+	Module: pong_rng
+*/
+
+#include "pong_rng.h"
+
+void pong_rng_seed(PongRng* rng, uint64_t seed, uint64_t stream)
+{
+	rng->state = 0;
+	rng->inc = (stream << 1) | 1;
+	pong_rng_next(rng);
+	rng->state += seed;
+	pong_rng_next(rng);
+}
+
+uint32_t pong_rng_next(PongRng* rng)
+{
+	uint64_t old = rng->state;
+	uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+	uint32_t rot = (uint32_t)(old >> 59);
+
+	rng->state = old * 6364136223846793005ULL + rng->inc;
+
+	return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+}
+
+int pong_rng_below(PongRng* rng, int bound)
+{
+	// scale instead of %, no division and no bias towards low numbers worth measuring
+	return (int)(((uint64_t)pong_rng_next(rng) * (uint32_t)bound) >> 32);
+}
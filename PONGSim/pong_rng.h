@@ -0,0 +1,38 @@
+/*
+	Program: PONG
+	Module: pong_rng
+
+	Small, fast random numbers that live inside whatever uses them, so
+	matches don't share a generator and can run side by side or be replayed
+	exactly. PCG32 (XSH RR): 64 bits of state plus a stream selector, every
+	(seed, stream) pair gives an independent sequence.
+*/
+
+#ifndef PONG_RNG_H
+#define PONG_RNG_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct PongRng
+{
+	uint64_t state;
+	uint64_t inc;			// stream selector, always odd
+} PongRng;
+
+void pong_rng_seed(PongRng* rng, uint64_t seed, uint64_t stream);
+
+// next 32 random bits
+uint32_t pong_rng_next(PongRng* rng);
+
+// 0..bound-1, bound > 0
+int pong_rng_below(PongRng* rng, int bound);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,468 @@
+/*
+	Program: PONG
+	Module: pong_rollback
+*/
+
+#include "pong_rollback.h"
+#include "pong_thread.h" // pong_clock_seconds()
+
+#include <stddef.h> // offsetof()
+#include <string.h> // memcpy(), memset()
+
+#define HELLO_EVERY 0.25	// seconds between a joining side's hellos
+
+// packets: "PN", a type byte, then little-endian fields
+#define PACKET_HELLO 1		// join -> host: let me in
+#define PACKET_WELCOME 2	// host -> join: u64 seed, u32 RWG mode, u32 field count, i32 config fields
+#define PACKET_INPUTS 3		// both ways, see send_inputs
+
+#define INPUTS_HEADER 28
+
+// PongConfig fields in welcome order, as in pong_replay
+static const size_t configFields[] = {
+	offsetof(PongConfig, scrWidth),
+	offsetof(PongConfig, scrHeight),
+	offsetof(PongConfig, paddleW),
+	offsetof(PongConfig, paddleH),
+	offsetof(PongConfig, ballSize),
+	offsetof(PongConfig, paddleSpeed),
+	offsetof(PongConfig, ballSpeedCapX),
+	offsetof(PongConfig, ballSpeedCapY),
+	offsetof(PongConfig, hitsPerSpeedUp),
+	offsetof(PongConfig, aiDetectRange),
+	offsetof(PongConfig, winScore),
+	offsetof(PongConfig, physics),
+	offsetof(PongConfig, tickRate),
+	offsetof(PongConfig, speedUpStep),
+	offsetof(PongConfig, spinStep)
+};
+
+#define CONFIG_FIELD_COUNT (int)(sizeof(configFields) / sizeof(configFields[0]))
+#define WELCOME_SIZE (3 + 16 + CONFIG_FIELD_COUNT * 4)
+
+//
+// little-endian fields
+//
+static unsigned int get_u16(const unsigned char* p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static unsigned int get_u32(const unsigned char* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static void put_u16(unsigned char* p, unsigned int value)
+{
+	p[0] = (unsigned char)value;
+	p[1] = (unsigned char)(value >> 8);
+}
+
+static void put_u32(unsigned char* p, unsigned int value)
+{
+	put_u16(p, value & 0xffff);
+	put_u16(p + 2, value >> 16);
+}
+
+static void put_header(unsigned char* p, int type)
+{
+	p[0] = 'P';
+	p[1] = 'N';
+	p[2] = (unsigned char)type;
+}
+
+//
+// inputs
+//
+
+// this side's paddle keys and serve, from either player's keys
+static PongInput own_input(int player, PongInput input)
+{
+	PongInput keys = (input | input >> 4) & 0x0f; // P2's keys onto P1's
+
+	return (player == 2 ? keys << 4 : keys) | (input & PONG_INPUT_SERVE);
+}
+
+// what the other side may send: its own paddle keys and serve
+static PongInput remote_mask(int player)
+{
+	return (player == 1 ? 0xf0u : 0x0fu) | PONG_INPUT_SERVE;
+}
+
+// the other side's input for a frame that hasn't arrived: the keys it held last, no commands
+static PongInput guess_remote(const PongRollback* rb)
+{
+	if (rb->remoteFrames == 0)
+	{
+		return 0;
+	}
+	return rb->remote[(rb->remoteFrames - 1) % PONG_ROLLBACK_RING] & PONG_INPUT_HELD_MASK;
+}
+
+// plays rb->frame with the inputs stored for it, saving the state before it
+static unsigned int play_frame(PongRollback* rb)
+{
+	int slot = rb->frame % PONG_ROLLBACK_RING;
+	PongInput input = rb->local[slot] | rb->remote[slot];
+
+	// the menu is skipped: the first frame and any serve between games start a game
+	if (!rb->match.gameOn && (rb->frame == 0 || (input & PONG_INPUT_SERVE)))
+	{
+		input |= rb->RWGMode ? PONG_INPUT_MODE_4 : PONG_INPUT_MODE_2;
+	}
+
+	rb->saved[slot] = rb->match;
+	rb->frame++;
+
+	return pong_sim_step(&rb->match, input);
+}
+
+// goes back to the first wrongly guessed frame and plays up to the present again
+static void roll_back(PongRollback* rb)
+{
+	int present = rb->frame;
+	int depth = present - rb->firstWrong;
+
+	rb->match = rb->saved[rb->firstWrong % PONG_ROLLBACK_RING];
+	rb->frame = rb->firstWrong;
+	rb->firstWrong = -1;
+
+	while (rb->frame < present)
+	{
+		if (rb->frame >= rb->remoteFrames)
+		{
+			rb->remote[rb->frame % PONG_ROLLBACK_RING] = guess_remote(rb);
+		}
+		play_frame(rb);
+	}
+
+	rb->stats.rollbacks++;
+	rb->stats.resimulated += depth;
+	if (depth > rb->stats.maxDepth)
+	{
+		rb->stats.maxDepth = depth;
+	}
+}
+
+//
+// checksums
+//
+
+// checksums every PONG_ROLLBACK_CHECK_EVERY frame that both sides' inputs are known up to
+static void update_checksums(PongRollback* rb)
+{
+	int confirmed = rb->remoteFrames < rb->frame ? rb->remoteFrames : rb->frame;
+
+	while (rb->checkedFrame + PONG_ROLLBACK_CHECK_EVERY <= confirmed)
+	{
+		int f = rb->checkedFrame + PONG_ROLLBACK_CHECK_EVERY;
+		const PongMatch* state = f == rb->frame ? &rb->match : &rb->saved[f % PONG_ROLLBACK_RING];
+
+		rb->checksums[f / PONG_ROLLBACK_CHECK_EVERY % PONG_ROLLBACK_CHECKSUMS] = pong_sim_checksum(state);
+		pong_sim_state(state, rb->checkStates[f / PONG_ROLLBACK_CHECK_EVERY % PONG_ROLLBACK_CHECKSUMS]);
+		rb->checkedFrame = f;
+	}
+}
+
+static void compare_checksum(PongRollback* rb, int frame, uint32_t checksum)
+{
+	if (frame <= rb->comparedFrame || frame > rb->checkedFrame
+		|| frame <= rb->checkedFrame - PONG_ROLLBACK_CHECK_EVERY * PONG_ROLLBACK_CHECKSUMS)
+	{
+		return; // seen already, not confirmed here yet, or too old to still have
+	}
+
+	if (rb->checksums[frame / PONG_ROLLBACK_CHECK_EVERY % PONG_ROLLBACK_CHECKSUMS] == checksum)
+	{
+		rb->stats.checksOk++;
+	}
+	else
+	{
+		rb->stats.checksFailed++;
+		if (rb->desyncFrame < 0)
+		{
+			rb->desyncFrame = frame;
+			memcpy(rb->desyncState, rb->checkStates[frame / PONG_ROLLBACK_CHECK_EVERY % PONG_ROLLBACK_CHECKSUMS], sizeof(rb->desyncState));
+		}
+	}
+	rb->comparedFrame = frame;
+}
+
+//
+// packets
+//
+
+static void send_hello(PongRollback* rb)
+{
+	unsigned char packet[3];
+
+	put_header(packet, PACKET_HELLO);
+	pong_net_send(&rb->net, packet, sizeof(packet));
+}
+
+static void send_welcome(PongRollback* rb)
+{
+	unsigned char packet[WELCOME_SIZE];
+
+	put_header(packet, PACKET_WELCOME);
+	put_u32(packet + 3, (unsigned int)rb->seed);
+	put_u32(packet + 7, (unsigned int)(rb->seed >> 32));
+	put_u32(packet + 11, rb->RWGMode);
+	put_u32(packet + 15, CONFIG_FIELD_COUNT);
+	for (int i = 0; i < CONFIG_FIELD_COUNT; i++)
+	{
+		put_u32(packet + 19 + i * 4, *(const int*)((const char*)&rb->match.config + configFields[i]));
+	}
+	pong_net_send(&rb->net, packet, sizeof(packet));
+}
+
+// every input the other side hasn't acknowledged, plus where we are and our latest checksum:
+//   0 header, 3 u32 frame, 7 i32 advantage, 11 u32 ack, 15 u32 checksum frame,
+//   19 u32 checksum, 23 u32 first input's frame, 27 u8 count, 28 u16 inputs
+static void send_inputs(PongRollback* rb)
+{
+	unsigned char packet[INPUTS_HEADER + PONG_ROLLBACK_RING * 2];
+	int advantage = rb->remoteFrame >= 0 ? rb->frame - rb->remoteFrame : 0;
+	int start = rb->remoteAck;
+	int count;
+
+	if (start < rb->frame - PONG_ROLLBACK_RING)
+	{
+		start = rb->frame - PONG_ROLLBACK_RING; // can't happen while both sides keep to the prediction limit
+	}
+	count = rb->frame - start;
+
+	put_header(packet, PACKET_INPUTS);
+	put_u32(packet + 3, rb->frame);
+	put_u32(packet + 7, (unsigned int)advantage);
+	put_u32(packet + 11, rb->remoteFrames);
+	put_u32(packet + 15, rb->checkedFrame);
+	put_u32(packet + 19, rb->checksums[rb->checkedFrame / PONG_ROLLBACK_CHECK_EVERY % PONG_ROLLBACK_CHECKSUMS]);
+	put_u32(packet + 23, start);
+	packet[27] = (unsigned char)count;
+	for (int i = 0; i < count; i++)
+	{
+		put_u16(packet + INPUTS_HEADER + i * 2, rb->local[(start + i) % PONG_ROLLBACK_RING]);
+	}
+	pong_net_send(&rb->net, packet, INPUTS_HEADER + count * 2);
+}
+
+static void read_welcome(PongRollback* rb, const unsigned char* packet, int size)
+{
+	PongConfig config;
+
+	if (rb->started || size < WELCOME_SIZE || (int)get_u32(packet + 15) != CONFIG_FIELD_COUNT)
+	{
+		return;
+	}
+
+	rb->seed = get_u32(packet + 3) | ((uint64_t)get_u32(packet + 7) << 32);
+	rb->RWGMode = (int)get_u32(packet + 11);
+	pong_config_default(&config);
+	for (int i = 0; i < CONFIG_FIELD_COUNT; i++)
+	{
+		*(int*)((char*)&config + configFields[i]) = (int)get_u32(packet + 19 + i * 4);
+	}
+
+	pong_sim_init(&rb->match, &config);
+	pong_sim_seed(&rb->match, rb->seed, 0);
+	rb->started = 1;
+}
+
+static void read_inputs(PongRollback* rb, const unsigned char* packet, int size)
+{
+	int frame, start, count;
+
+	if (!rb->started || size < INPUTS_HEADER)
+	{
+		return;
+	}
+	frame = (int)get_u32(packet + 3);
+	start = (int)get_u32(packet + 23);
+	count = packet[27];
+	if (size < INPUTS_HEADER + count * 2)
+	{
+		return;
+	}
+
+	// packets overtake each other, keep the newest
+	if (frame > rb->remoteFrame)
+	{
+		rb->remoteFrame = frame;
+		rb->remoteAdvantage = (int)get_u32(packet + 7);
+	}
+	if ((int)get_u32(packet + 11) > rb->remoteAck)
+	{
+		rb->remoteAck = (int)get_u32(packet + 11);
+	}
+	compare_checksum(rb, (int)get_u32(packet + 15), get_u32(packet + 19));
+
+	// only the next unknown input onwards, and not so far ahead it would overwrite one still needed
+	for (int i = 0; i < count; i++)
+	{
+		int f = start + i;
+		int slot = f % PONG_ROLLBACK_RING;
+		PongInput input = get_u16(packet + INPUTS_HEADER + i * 2) & remote_mask(rb->player);
+
+		if (f < rb->remoteFrames)
+		{
+			continue;
+		}
+		if (f > rb->remoteFrames || f >= rb->frame + PONG_ROLLBACK_RING - PONG_ROLLBACK_MAX_PREDICTION)
+		{
+			break;
+		}
+
+		if (f < rb->frame && rb->remote[slot] != input && (rb->firstWrong < 0 || f < rb->firstWrong))
+		{
+			rb->firstWrong = f;
+		}
+		rb->remote[slot] = input;
+		rb->remoteFrames++;
+	}
+}
+
+// sends what is due and reads everything waiting
+static void pump(PongRollback* rb)
+{
+	unsigned char packet[PONG_NET_MAX_PACKET];
+	int size;
+
+	pong_net_flush(&rb->net);
+
+	while ((size = pong_net_receive(&rb->net, packet, sizeof(packet))) > 0)
+	{
+		if (size < 3 || packet[0] != 'P' || packet[1] != 'N')
+		{
+			continue;
+		}
+		rb->lastHeard = pong_clock_seconds();
+
+		switch (packet[2]) {
+		case PACKET_HELLO:
+			if (rb->player == 1)
+			{
+				send_welcome(rb); // every time, in case the last one was lost
+				rb->started = 1;
+			}
+			break;
+		case PACKET_WELCOME:
+			read_welcome(rb, packet, size);
+			break;
+		case PACKET_INPUTS:
+			read_inputs(rb, packet, size);
+			break;
+		}
+	}
+}
+
+//
+// session
+//
+
+static void reset(PongRollback* rb, int player)
+{
+	memset(rb, 0, sizeof(*rb));
+	rb->player = player;
+	rb->remoteFrame = -1;
+	rb->firstWrong = -1;
+	rb->desyncFrame = -1;
+	rb->lastHello = -HELLO_EVERY;
+}
+
+int pong_rollback_host(PongRollback* rb, int port, const PongNetFaults* faults, const PongConfig* config, int RWGMode, uint64_t seed)
+{
+	reset(rb, 1);
+	rb->seed = seed;
+	rb->RWGMode = RWGMode;
+	pong_sim_init(&rb->match, config);
+	pong_sim_seed(&rb->match, seed, 0);
+
+	return pong_net_open(&rb->net, port, faults);
+}
+
+int pong_rollback_join(PongRollback* rb, const char* host, int port, const PongNetFaults* faults)
+{
+	reset(rb, 2);
+
+	if (pong_net_open(&rb->net, 0, faults) != 0)
+	{
+		return -1;
+	}
+	if (pong_net_set_peer(&rb->net, host, port) != 0)
+	{
+		pong_net_close(&rb->net);
+		return -1;
+	}
+
+	return 0;
+}
+
+int pong_rollback_connect(PongRollback* rb)
+{
+	double now = pong_clock_seconds();
+
+	if (rb->player == 2 && !rb->started && now - rb->lastHello >= HELLO_EVERY)
+	{
+		send_hello(rb);
+		rb->lastHello = now;
+	}
+	pump(rb);
+
+	return rb->started;
+}
+
+int pong_rollback_tick(PongRollback* rb, PongInput input, unsigned int* events)
+{
+	int slot = rb->frame % PONG_ROLLBACK_RING;
+
+	*events = 0;
+	pump(rb);
+	if (pong_clock_seconds() - rb->lastHeard > PONG_ROLLBACK_TIMEOUT)
+	{
+		return PONG_ROLLBACK_GONE;
+	}
+
+	if (rb->firstWrong >= 0)
+	{
+		roll_back(rb);
+	}
+	update_checksums(rb);
+
+	input = own_input(rb->player, input) | rb->pendingServe;
+	rb->pendingServe = 0;
+
+	// too many frames on guesses: wait for the other side's inputs
+	if (rb->frame - rb->remoteFrames >= PONG_ROLLBACK_MAX_PREDICTION)
+	{
+		rb->pendingServe = input & PONG_INPUT_SERVE;
+		rb->stats.stalls++;
+		send_inputs(rb);
+		return PONG_ROLLBACK_STALLED;
+	}
+
+	// both sides see the other one behind by the trip time. If we are further
+	// ahead than they are, we run early and make them roll back more, so skip a frame
+	if (rb->remoteFrame >= 0 && rb->frame >= rb->nextWait
+		&& (rb->frame - rb->remoteFrame) - rb->remoteAdvantage >= 2)
+	{
+		rb->pendingServe = input & PONG_INPUT_SERVE;
+		rb->nextWait = rb->frame + 8; // spread the waits out so they don't show
+		rb->stats.waits++;
+		send_inputs(rb);
+		return PONG_ROLLBACK_WAITED;
+	}
+
+	rb->local[slot] = input;
+	rb->remote[slot] = rb->frame < rb->remoteFrames ? rb->remote[slot] : guess_remote(rb);
+	*events = play_frame(rb);
+	send_inputs(rb);
+
+	return PONG_ROLLBACK_STEPPED;
+}
+
+void pong_rollback_close(PongRollback* rb)
+{
+	pong_net_close(&rb->net);
+}
@@ -0,0 +1,116 @@
+/*
+	Program: PONG
+	Module: pong_rollback
+
+	Online 1v1 with rollback. Each side runs the whole match itself: its
+	own input is used the moment it is pressed, and the other player's
+	input, which is still on its way, is guessed by repeating the last one
+	that arrived. When the real input turns up and the guess was wrong, the
+	match is put back to the state saved before that frame and played
+	forward again with what really happened, all within one tick. pong_sim
+	is deterministic, so both sides end on the same match; they swap
+	checksums of confirmed frames to prove it.
+
+	The host plays P1 and picks the seed and mode, the other side joins as
+	P2. Inputs go over pong_net UDP, every packet repeats all inputs the
+	other side hasn't acknowledged yet, so lost packets cost nothing but a
+	longer guess.
+*/
+
+#ifndef PONG_ROLLBACK_H
+#define PONG_ROLLBACK_H
+
+#include "pong_sim.h"
+#include "pong_net.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PONG_ROLLBACK_RING 64			// saved frames, at least twice the prediction
+#define PONG_ROLLBACK_MAX_PREDICTION 24	// frames played on guesses before waiting for the other side
+#define PONG_ROLLBACK_CHECK_EVERY 16	// frames between checksums
+#define PONG_ROLLBACK_CHECKSUMS 8		// kept to compare with the other side's, which lag behind
+#define PONG_ROLLBACK_TIMEOUT 5.0		// seconds without a packet before the other side counts as gone
+
+// pong_rollback_tick results
+#define PONG_ROLLBACK_STEPPED 0			// one frame was played
+#define PONG_ROLLBACK_STALLED 1			// too far ahead of the other side's inputs, nothing played
+#define PONG_ROLLBACK_WAITED 2			// held back a frame to let a slower side catch up
+#define PONG_ROLLBACK_GONE 3			// nothing heard for PONG_ROLLBACK_TIMEOUT
+
+typedef struct PongRollbackStats
+{
+	int rollbacks;			// wrong guesses corrected
+	int resimulated;		// frames played again because of them
+	int maxDepth;			// most frames rolled back at once
+	int stalls;
+	int waits;
+	int checksOk;
+	int checksFailed;		// desyncs, should always stay 0
+} PongRollbackStats;
+
+typedef struct PongRollback
+{
+	PongNet net;
+	int player;				// 1 hosts, 2 joins
+	int started;			// non-zero once both sides agree on the match
+	uint64_t seed;			// from the host
+	int RWGMode;
+	double lastHeard;		// pong_clock_seconds() of the last packet
+	double lastHello;
+
+	PongMatch match;		// the current state, before frame `frame`
+	int frame;				// next frame to play
+
+	// per frame, indexed by frame % PONG_ROLLBACK_RING
+	PongMatch saved[PONG_ROLLBACK_RING];	// state before the frame
+	PongInput local[PONG_ROLLBACK_RING];	// this side's input
+	PongInput remote[PONG_ROLLBACK_RING];	// the other side's, real or guessed
+
+	int remoteFrames;		// the other side's inputs are known for every frame before this
+	int remoteFrame;		// the latest frame the other side said it was on, -1 before any
+	int remoteAdvantage;	// how far it thought it was ahead of us
+	int remoteAck;			// it has every input of ours before this frame
+	int firstWrong;			// earliest frame played on a wrong guess, -1 if none
+	int nextWait;			// no time sync wait before this frame
+	PongInput pendingServe;	// a serve pressed while stalled, used on the next frame
+
+	// checksums of confirmed frames, one per PONG_ROLLBACK_CHECK_EVERY
+	int checkedFrame;		// ours are done up to this frame
+	uint32_t checksums[PONG_ROLLBACK_CHECKSUMS];
+	int comparedFrame;		// the other side's are compared up to this frame
+	int32_t checkStates[PONG_ROLLBACK_CHECKSUMS][PONG_SIM_STATE_FIELDS];	// what each checksum was taken of
+
+	// the first frame the checksums disagreed on, -1 if none, and this
+	// side's state after it. The other side has its own, to compare with
+	int desyncFrame;
+	int32_t desyncState[PONG_SIM_STATE_FIELDS];
+
+	PongRollbackStats stats;
+} PongRollback;
+
+// opens port and waits for someone to join. config, RWGMode and seed are
+// sent to them, so both sides play the same match. -1 if the port can't be opened
+int pong_rollback_host(PongRollback* rb, int port, const PongNetFaults* faults, const PongConfig* config, int RWGMode, uint64_t seed);
+
+// sets up to join host:port, -1 if the host doesn't resolve or no socket can be opened
+int pong_rollback_join(PongRollback* rb, const char* host, int port, const PongNetFaults* faults);
+
+// call every frame until it returns non-zero, which means the match is ready
+int pong_rollback_connect(PongRollback* rb);
+
+// plays the next frame with this side's input, after any rollback that
+// arrived packets call for. Either player's keys steer this side's paddle,
+// and only SERVE is kept of the commands. A serve with no game on starts a
+// new one. events gets the new frame's PONG_EVENT_* flags. returns a
+// PONG_ROLLBACK_* result
+int pong_rollback_tick(PongRollback* rb, PongInput input, unsigned int* events);
+
+void pong_rollback_close(PongRollback* rb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,349 @@
+/*
+	Program: PONG
+	Module: pong_server
+*/
+
+#include "pong_server.h"
+
+#include <stdlib.h> // calloc()
+#include <string.h> // memcmp(), memcpy(), memset()
+
+#define JOIN_SIZE 4
+#define WELCOME_SIZE 8
+#define INPUT_SIZE 14
+#define STATE_SIZE 34
+#define LEAVE_SIZE 8
+
+//
+// little-endian fields
+//
+static unsigned int get_u16(const unsigned char* p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static unsigned int get_u32(const unsigned char* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static void put_u16(unsigned char* p, unsigned int value)
+{
+	p[0] = (unsigned char)value;
+	p[1] = (unsigned char)(value >> 8);
+}
+
+static void put_u32(unsigned char* p, unsigned int value)
+{
+	put_u16(p, value & 0xffff);
+	put_u16(p + 2, value >> 16);
+}
+
+static void put_header(unsigned char* p, int type)
+{
+	p[0] = 'P';
+	p[1] = 'S';
+	p[2] = (unsigned char)type;
+}
+
+//
+// the pool
+//
+int pong_server_pool_init(PongServerPool* pool, const PongConfig* config, uint64_t seed, uint64_t streamBase, int capacity)
+{
+	memset(pool, 0, sizeof(*pool));
+	if (capacity <= 0 || capacity > PONG_SERVER_MAX_POOL)
+	{
+		return -1;
+	}
+	pool->matches = (PongServerMatch*)calloc(capacity, sizeof(PongServerMatch));
+	if (!pool->matches)
+	{
+		return -1;
+	}
+
+	pool->config = *config;
+	pool->seed = seed;
+	pool->streamBase = streamBase;
+	pool->capacity = capacity;
+	pool->waiting = -1;
+
+	// every slot free, lowest first
+	for (int i = 0; i < capacity; i++)
+	{
+		pool->matches[i].id = (uint32_t)i;
+		pool->matches[i].nextFree = i + 1 < capacity ? i + 1 : -1;
+	}
+	pool->freeList = 0;
+
+	return 0;
+}
+
+void pong_server_pool_free(PongServerPool* pool)
+{
+	free(pool->matches);
+	memset(pool, 0, sizeof(*pool));
+}
+
+static void start(PongServerMatch* m)
+{
+	pong_sim_step(&m->match, m->mode == PONG_SERVER_VS_AI ? PONG_INPUT_MODE_1 : PONG_INPUT_MODE_2);
+	m->step = pong_sim_step_fn(&m->match);
+}
+
+static void connect_peer(PongServerPeer* peer, const unsigned char* address, double now)
+{
+	memset(peer, 0, sizeof(*peer));
+	memcpy(peer->address, address, sizeof(peer->address));
+	peer->connected = 1;
+	peer->lastHeard = now;
+}
+
+PongServerMatch* pong_server_join(PongServerPool* pool, const unsigned char* address, int mode, int* player, double now)
+{
+	PongServerMatch* m;
+	int slot;
+
+	// a second join from someone already playing is a lost welcome
+	for (int i = 0; i < pool->capacity; i++)
+	{
+		m = &pool->matches[i];
+		for (int p = 0; p < 2 && m->live; p++)
+		{
+			if (m->peers[p].connected && memcmp(m->peers[p].address, address, sizeof(m->peers[p].address)) == 0)
+			{
+				*player = p + 1;
+				return m;
+			}
+		}
+	}
+
+	if (mode == PONG_SERVER_VS_PLAYER && pool->waiting >= 0)
+	{
+		m = &pool->matches[pool->waiting];
+		pool->waiting = -1;
+		connect_peer(&m->peers[1], address, now);
+		start(m);
+		*player = 2;
+		return m;
+	}
+
+	if (pool->freeList < 0)
+	{
+		return NULL;
+	}
+	slot = pool->freeList;
+	m = &pool->matches[slot];
+	pool->freeList = m->nextFree;
+	pool->live++;
+
+	// a new generation, so ids handed out for the slot before go stale
+	m->id = (uint32_t)slot | (((m->id >> 16) + 1) << 16);
+	m->tick = 0;
+	m->mode = mode == PONG_SERVER_VS_PLAYER ? PONG_SERVER_VS_PLAYER : PONG_SERVER_VS_AI;
+	m->live = 1;
+	m->nextFree = -1;
+	memset(m->peers, 0, sizeof(m->peers));
+	connect_peer(&m->peers[0], address, now);
+
+	pong_sim_init(&m->match, &pool->config);
+	pong_sim_seed(&m->match, pool->seed, pool->streamBase + pool->started++);
+	m->step = pong_sim_step;
+	if (m->mode == PONG_SERVER_VS_AI)
+	{
+		start(m);
+	}
+	else
+	{
+		pool->waiting = slot;
+	}
+
+	*player = 1;
+	return m;
+}
+
+PongServerMatch* pong_server_find(PongServerPool* pool, uint32_t id)
+{
+	int slot = (int)(id & 0xffff);
+
+	if (slot >= pool->capacity || !pool->matches[slot].live || pool->matches[slot].id != id)
+	{
+		return NULL;
+	}
+	return &pool->matches[slot];
+}
+
+void pong_server_input(PongServerMatch* m, int player, PongInput keys, uint32_t clientTime, double now)
+{
+	PongServerPeer* peer = &m->peers[player - 1];
+
+	if (!peer->connected)
+	{
+		return;
+	}
+	peer->held = keys & (PONG_INPUT_P1_UP | PONG_INPUT_P1_DOWN | PONG_INPUT_P1_LEFT | PONG_INPUT_P1_RIGHT);
+	peer->serve |= keys & PONG_INPUT_SERVE;
+	peer->clientTime = clientTime;
+	peer->lastHeard = now;
+}
+
+void pong_server_release(PongServerPool* pool, PongServerMatch* m)
+{
+	int slot = (int)(m - pool->matches);
+
+	if (!m->live)
+	{
+		return;
+	}
+	if (pool->waiting == slot)
+	{
+		pool->waiting = -1;
+	}
+	m->live = 0;
+	m->peers[0].connected = 0;
+	m->peers[1].connected = 0;
+	m->nextFree = pool->freeList;
+	pool->freeList = slot;
+	pool->live--;
+}
+
+unsigned int pong_server_tick(PongServerMatch* m)
+{
+	PongInput input;
+
+	// counted while waiting too, so the players can tell which states went missing
+	m->tick++;
+	if (!m->match.gameOn)
+	{
+		return 0;
+	}
+
+	// P2's keys are sent as P1's, they move up four bits
+	input = m->peers[0].held | m->peers[0].serve | (m->peers[1].held << 4) | m->peers[1].serve;
+	m->peers[0].serve = 0;
+	m->peers[1].serve = 0;
+
+	return m->step(&m->match, input);
+}
+
+int pong_server_flags(const PongServerMatch* m)
+{
+	int waiting = m->mode == PONG_SERVER_VS_PLAYER && !m->peers[1].connected;
+	int flags = 0;
+
+	if (m->match.ballInPlay)
+	{
+		flags |= PONG_SERVER_BALL_IN_PLAY;
+	}
+	if (waiting)
+	{
+		flags |= PONG_SERVER_WAITING;
+	}
+	else if (!m->match.gameOn)
+	{
+		flags |= PONG_SERVER_OVER;
+	}
+	return flags;
+}
+
+//
+// packets
+//
+int pong_server_write_join(unsigned char* packet, int mode)
+{
+	put_header(packet, PONG_SERVER_JOIN);
+	packet[3] = (unsigned char)mode;
+	return JOIN_SIZE;
+}
+
+int pong_server_write_welcome(unsigned char* packet, uint32_t match, int player)
+{
+	put_header(packet, PONG_SERVER_WELCOME);
+	put_u32(packet + 3, match);
+	packet[7] = (unsigned char)player;
+	return WELCOME_SIZE;
+}
+
+int pong_server_write_input(unsigned char* packet, uint32_t match, int player, PongInput keys, uint32_t clientTime)
+{
+	put_header(packet, PONG_SERVER_INPUT);
+	put_u32(packet + 3, match);
+	packet[7] = (unsigned char)player;
+	put_u16(packet + 8, keys);
+	put_u32(packet + 10, clientTime);
+	return INPUT_SIZE;
+}
+
+int pong_server_write_state(unsigned char* packet, const PongServerMatch* m, int player, int flags)
+{
+	put_header(packet, PONG_SERVER_STATE);
+	put_u32(packet + 3, m->id);
+	put_u32(packet + 7, m->tick);
+	put_u32(packet + 11, m->peers[player - 1].clientTime);
+	put_u32(packet + 15, (unsigned int)m->match.p1.y);
+	put_u32(packet + 19, (unsigned int)m->match.p2.y);
+	put_u32(packet + 23, (unsigned int)m->match.ball.x);
+	put_u32(packet + 27, (unsigned int)m->match.ball.y);
+	packet[31] = (unsigned char)(m->match.p1Score < 255 ? m->match.p1Score : 255);
+	packet[32] = (unsigned char)(m->match.p2Score < 255 ? m->match.p2Score : 255);
+	packet[33] = (unsigned char)flags;
+	return STATE_SIZE;
+}
+
+int pong_server_write_leave(unsigned char* packet, uint32_t match, int player)
+{
+	put_header(packet, PONG_SERVER_LEAVE);
+	put_u32(packet + 3, match);
+	packet[7] = (unsigned char)player;
+	return LEAVE_SIZE;
+}
+
+int pong_server_read(PongServerPacket* out, const unsigned char* packet, int size)
+{
+	static const int sizes[] = { 0, JOIN_SIZE, WELCOME_SIZE, INPUT_SIZE, STATE_SIZE, LEAVE_SIZE };
+
+	memset(out, 0, sizeof(*out));
+	if (size < 3 || packet[0] != 'P' || packet[1] != 'S' || packet[2] < PONG_SERVER_JOIN || packet[2] > PONG_SERVER_LEAVE
+		|| size < sizes[packet[2]])
+	{
+		return 0;
+	}
+
+	out->type = packet[2];
+	switch (out->type) {
+	case PONG_SERVER_JOIN:
+		out->mode = packet[3];
+		break;
+	case PONG_SERVER_WELCOME:
+	case PONG_SERVER_LEAVE:
+		out->match = get_u32(packet + 3);
+		out->player = packet[7];
+		break;
+	case PONG_SERVER_INPUT:
+		out->match = get_u32(packet + 3);
+		out->player = packet[7];
+		out->keys = get_u16(packet + 8);
+		out->clientTime = get_u32(packet + 10);
+		break;
+	case PONG_SERVER_STATE:
+		out->match = get_u32(packet + 3);
+		out->tick = get_u32(packet + 7);
+		out->clientTime = get_u32(packet + 11);
+		out->p1Y = (PongFixed)get_u32(packet + 15);
+		out->p2Y = (PongFixed)get_u32(packet + 19);
+		out->ballX = (PongFixed)get_u32(packet + 23);
+		out->ballY = (PongFixed)get_u32(packet + 27);
+		out->p1Score = packet[31];
+		out->p2Score = packet[32];
+		out->flags = packet[33];
+		break;
+	}
+
+	// players are 1 or 2
+	if ((out->type == PONG_SERVER_WELCOME || out->type == PONG_SERVER_INPUT || out->type == PONG_SERVER_LEAVE)
+		&& out->player != 1 && out->player != 2)
+	{
+		out->type = 0;
+	}
+	return out->type;
+}
@@ -0,0 +1,152 @@
+/*
+	Program: PONG
+	Module: pong_server
+
+	The part of the dedicated server that doesn't touch a socket: a pool
+	of matches and the packets clients and server swap. The server owns
+	every match and is the only one that plays it; clients send the keys
+	they hold and get the state back after each tick. Nothing is predicted
+	on the client, unlike pong_rollback, so this is for hosting many matches
+	cheaply rather than for playing over long distances.
+
+	A pool is meant for one thread. The server runs a pool per core, and
+	each pool's clients only ever talk to that pool's thread, so two
+	players are only paired with each other within a pool.
+
+	Packets are "PS", a type byte, then little-endian fields:
+
+		join     client -> server  u8 mode (PONG_SERVER_VS_*)
+		welcome  server -> client  u32 match, u8 player
+		input    client -> server  u32 match, u8 player, u16 keys, u32 client time
+		state    server -> client  u32 match, u32 tick, u32 client time,
+		                           i32 p1 y, i32 p2 y, i32 ball x, i32 ball y,
+		                           u8 p1 score, u8 p2 score, u8 flags
+		leave    client -> server  u32 match, u8 player
+
+	Keys are always sent as P1's (PONG_INPUT_P1_* and SERVE), whichever
+	paddle the client has. The client time is whatever the client likes;
+	the state echoes the latest one, so the client can time the round trip.
+*/
+
+#ifndef PONG_SERVER_H
+#define PONG_SERVER_H
+
+#include "pong_sim.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PONG_SERVER_MAX_PACKET 64
+#define PONG_SERVER_MAX_POOL 65536	// matches in one pool, match ids keep the slot in 16 bits
+#define PONG_SERVER_TIMEOUT 5.0		// seconds without a packet before a player counts as gone
+
+// packet types
+#define PONG_SERVER_JOIN 1
+#define PONG_SERVER_WELCOME 2
+#define PONG_SERVER_INPUT 3
+#define PONG_SERVER_STATE 4
+#define PONG_SERVER_LEAVE 5
+
+// join modes
+#define PONG_SERVER_VS_AI 0			// classic, against the AI built into pong_sim
+#define PONG_SERVER_VS_PLAYER 1		// classic, against the next player to join
+
+// state flags
+#define PONG_SERVER_BALL_IN_PLAY 1
+#define PONG_SERVER_WAITING 2		// no second player yet
+#define PONG_SERVER_OVER 4			// won, or the other player left. The match is gone
+
+// any packet, decoded. Only the fields of its type are set
+typedef struct PongServerPacket
+{
+	int type;					// PONG_SERVER_*, 0 for a packet that isn't one
+	int mode;
+	uint32_t match;
+	int player;					// 1 or 2
+	PongInput keys;
+	uint32_t clientTime;
+	uint32_t tick;
+	PongFixed p1Y, p2Y;			// paddle tops
+	PongFixed ballX, ballY;		// ball top left
+	int p1Score, p2Score;
+	int flags;
+} PongServerPacket;
+
+// one player's side of a match
+typedef struct PongServerPeer
+{
+	unsigned char address[16];	// struct sockaddr_in, as pong_net keeps it
+	int connected;
+	PongInput held;				// P1 keys, as sent
+	PongInput serve;			// SERVE if it was pressed since the last tick
+	uint32_t clientTime;		// latest one, echoed in every state
+	double lastHeard;
+} PongServerPeer;
+
+// everything the server keeps per match, pooled
+typedef struct PongServerMatch
+{
+	PongMatch match;
+	PongStepFn step;			// pong_sim_step for the mode, see pong_sim_step_fn
+	PongServerPeer peers[2];
+	uint32_t id;				// slot | generation << 16, so stale ids never find a new match
+	uint32_t tick;				// server ticks since the match was made, one state per player each
+	int mode;
+	int live;
+	int nextFree;				// free list, -1 at the end
+} PongServerMatch;
+
+typedef struct PongServerPool
+{
+	PongConfig config;
+	uint64_t seed;
+	uint64_t streamBase;		// pools on other threads use other streams
+	PongServerMatch* matches;
+	int capacity;
+	int live;
+	int freeList;
+	int waiting;				// a PONG_SERVER_VS_PLAYER match with one player, -1 if none
+	uint32_t started;			// matches started, picks each one's random stream
+} PongServerPool;
+
+// -1 when out of memory or capacity is over PONG_SERVER_MAX_POOL
+int pong_server_pool_init(PongServerPool* pool, const PongConfig* config, uint64_t seed, uint64_t streamBase, int capacity);
+void pong_server_pool_free(PongServerPool* pool);
+
+// the match for a join from address, sets player. A player who is already
+// in a match (their welcome got lost) gets the same one again. NULL when
+// the pool is full
+PongServerMatch* pong_server_join(PongServerPool* pool, const unsigned char* address, int mode, int* player, double now);
+
+// NULL if id is stale or was never handed out
+PongServerMatch* pong_server_find(PongServerPool* pool, uint32_t id);
+
+// a player's input packet
+void pong_server_input(PongServerMatch* m, int player, PongInput keys, uint32_t clientTime, double now);
+
+// gives the slot back. Send the players their last state first
+void pong_server_release(PongServerPool* pool, PongServerMatch* m);
+
+// plays one tick, returns the PONG_EVENT_* flags. Does nothing while the
+// match waits for a second player
+unsigned int pong_server_tick(PongServerMatch* m);
+
+// PONG_SERVER_* flags for the next state
+int pong_server_flags(const PongServerMatch* m);
+
+// packets, each returns its size
+int pong_server_write_join(unsigned char* packet, int mode);
+int pong_server_write_welcome(unsigned char* packet, uint32_t match, int player);
+int pong_server_write_input(unsigned char* packet, uint32_t match, int player, PongInput keys, uint32_t clientTime);
+int pong_server_write_state(unsigned char* packet, const PongServerMatch* m, int player, int flags);
+int pong_server_write_leave(unsigned char* packet, uint32_t match, int player);
+
+// returns the type, 0 if it isn't a whole packet of a known type
+int pong_server_read(PongServerPacket* out, const unsigned char* packet, int size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
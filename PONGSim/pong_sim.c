@@ -0,0 +1,588 @@
+/*
+	Program: PONG
+	Module: pong_sim
+
+	Physics, AI and scoring, moved out of the main loop. The order of the
+	updates below matches the original main loop exactly, quirks included,
+	so a headless match plays out the same as one in the window.
+*/
+
+#include "pong_sim.h"
+
+#include <stddef.h> // NULL
+
+void pong_config_default(PongConfig* config)
+{
+	config->scrWidth = 640;
+	config->scrHeight = 480;
+
+	config->paddleW = 8;
+	config->paddleH = 64;
+	config->ballSize = 8;
+
+	config->paddleSpeed = 7;
+
+	config->ballSpeedCapX = 6;
+	config->ballSpeedCapY = 10;
+
+	config->hitsPerSpeedUp = 1;
+	config->aiDetectRange = 3;
+	config->winScore = 11;
+
+	config->physics = PONG_PHYSICS_CLASSIC;
+
+	config->tickRate = 60;
+	config->speedUpStep = PONG_FIXED_ONE;
+	config->spinStep = PONG_FIXED_ONE;
+}
+
+PongFixed pong_tick_speed(const PongConfig* config, PongFixed speed)
+{
+	if (config->tickRate <= 0 || config->tickRate == 60)
+	{
+		return speed;
+	}
+	return (PongFixed)((int64_t)speed * 60 / config->tickRate);
+}
+
+void pong_tick_config(const PongConfig* config, PongTickConfig* tick)
+{
+	tick->width = PONG_FIXED(config->scrWidth);
+	tick->height = PONG_FIXED(config->scrHeight);
+	tick->halfWidth = PONG_FIXED(config->scrWidth / 2);
+	tick->aiDetectX = config->aiDetectRange != 0 ? PONG_FIXED(config->scrWidth / config->aiDetectRange) : 0;
+	tick->paddleSpeed = pong_tick_speed(config, PONG_FIXED(config->paddleSpeed));
+	tick->ballSpeedCapX = pong_tick_speed(config, PONG_FIXED(config->ballSpeedCapX));
+	tick->ballSpeedCapY = pong_tick_speed(config, PONG_FIXED(config->ballSpeedCapY));
+	tick->speedUpStep = pong_tick_speed(config, config->speedUpStep);
+	tick->spinStep = pong_tick_speed(config, config->spinStep);
+}
+
+int pong_rect_intersects(const PongRect* a, const PongRect* b)
+{
+	int aMin, aMax, bMin, bMax;
+
+	if (a->w <= 0 || a->h <= 0 || b->w <= 0 || b->h <= 0)
+	{
+		return 0;
+	}
+
+	// horizontal
+	aMin = a->x;
+	aMax = aMin + a->w;
+	bMin = b->x;
+	bMax = bMin + b->w;
+	if (bMin > aMin)
+	{
+		aMin = bMin;
+	}
+	if (bMax < aMax)
+	{
+		aMax = bMax;
+	}
+	if (aMax <= aMin)
+	{
+		return 0;
+	}
+
+	// vertical
+	aMin = a->y;
+	aMax = aMin + a->h;
+	bMin = b->y;
+	bMax = bMin + b->h;
+	if (bMin > aMin)
+	{
+		aMin = bMin;
+	}
+	if (bMax < aMax)
+	{
+		aMax = bMax;
+	}
+	if (aMax <= aMin)
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
+//
+// swept collision
+//
+
+#define SWEEP_NEVER INT64_MIN	// an axis that overlaps for the whole move
+
+// rounds towards minus infinity, so impact times never land inside the target
+static int64_t floor_div(int64_t a, int64_t b)
+{
+	int64_t q = a / b;
+
+	if ((a % b != 0) && ((a < 0) != (b < 0)))
+	{
+		q--;
+	}
+	return q;
+}
+
+// when [a, a + aw) moving by d starts and stops overlapping [b, b + bw).
+// returns 0 if it never does
+static int sweep_axis(int a, int aw, int d, int b, int bw, int64_t* entry, int64_t* exit)
+{
+	int64_t near, far;
+
+	if (d == 0)
+	{
+		*entry = SWEEP_NEVER;
+		*exit = INT64_MAX;
+		return a < b + bw && a + aw > b;
+	}
+
+	near = d > 0 ? (int64_t)b - a - aw : (int64_t)b + bw - a;
+	far = d > 0 ? (int64_t)b + bw - a : (int64_t)b - a - aw;
+	*entry = floor_div(near * PONG_SWEEP_ONE, d);
+	*exit = floor_div(far * PONG_SWEEP_ONE, d);
+	return 1;
+}
+
+int pong_rect_sweep(const PongRect* a, int dx, int dy, const PongRect* b, PongSweep* hit)
+{
+	int64_t entryX, exitX, entryY, exitY, entry, exit;
+
+	if (!sweep_axis(a->x, a->w, dx, b->x, b->w, &entryX, &exitX) || !sweep_axis(a->y, a->h, dy, b->y, b->h, &entryY, &exitY))
+	{
+		return 0;
+	}
+
+	entry = entryX > entryY ? entryX : entryY;
+	exit = exitX < exitY ? exitX : exitY;
+	if (entry >= exit || entry >= PONG_SWEEP_ONE || exit <= 0)
+	{
+		return 0;
+	}
+
+	hit->time = entry > 0 ? (int)entry : 0;
+	if (entryX == SWEEP_NEVER && entryY == SWEEP_NEVER)
+	{
+		hit->side = PONG_SIDE_NONE;	// not moving, and already inside
+	}
+	else if (entryX >= entryY)
+	{
+		hit->side = dx > 0 ? PONG_SIDE_LEFT : PONG_SIDE_RIGHT;
+	}
+	else
+	{
+		hit->side = dy > 0 ? PONG_SIDE_TOP : PONG_SIDE_BOTTOM;
+	}
+
+	return 1;
+}
+
+// half sizes are rounded down to whole pixels, as they always were
+static void update_centers(PongMatch* m)
+{
+	const PongConfig* c = &m->config;
+
+	m->p1Center.x = m->p1.x + PONG_FIXED(c->paddleW / 2);
+	m->p1Center.y = m->p1.y + PONG_FIXED(c->paddleH / 2);
+
+	m->p2Center.x = m->p2.x + PONG_FIXED(c->paddleW / 2);
+	m->p2Center.y = m->p2.y + PONG_FIXED(c->paddleH / 2);
+
+	m->ballCenter.x = m->ball.x + PONG_FIXED(c->ballSize / 2);
+	m->ballCenter.y = m->ball.y + PONG_FIXED(c->ballSize / 2);
+}
+
+static void reset_paddles(PongMatch* m)
+{
+	const PongConfig* c = &m->config;
+
+	m->p1.x = PONG_FIXED(c->paddleW); // paddle is away from the wall
+	m->p1.y = PONG_FIXED((c->scrHeight - c->paddleH) / 2);
+
+	m->p2.x = PONG_FIXED(c->scrWidth - (c->paddleW * 2)); // paddle is away from the wall
+	m->p2.y = PONG_FIXED((c->scrHeight - c->paddleH) / 2);
+}
+
+static void reset_ball(PongMatch* m)
+{
+	const PongConfig* c = &m->config;
+
+	m->ball.x = PONG_FIXED((c->scrWidth - c->ballSize) / 2);
+	m->ball.y = PONG_FIXED((c->scrHeight - c->ballSize) / 2);
+
+	// stop ball at reset location
+	m->ballSpeedX = 0;
+	m->ballSpeedY = 0;
+}
+
+static void reset_colors(PongMatch* m)
+{
+	m->p1ColorSetting = 0;
+	m->p2ColorSetting = 0;
+	m->ballColorSetting = 0;
+}
+
+void pong_sim_init(PongMatch* match, const PongConfig* config)
+{
+	PongMatch zero = { 0 };
+
+	*match = zero;
+	match->config = *config;
+	pong_tick_config(config, &match->tick);
+
+	match->p1.w = PONG_FIXED(config->paddleW);
+	match->p1.h = PONG_FIXED(config->paddleH);
+	match->p2.w = PONG_FIXED(config->paddleW);
+	match->p2.h = PONG_FIXED(config->paddleH);
+	match->ball.w = PONG_FIXED(config->ballSize);
+	match->ball.h = PONG_FIXED(config->ballSize);
+
+	reset_paddles(match);
+	reset_ball(match);
+
+	match->ballDirX = 1;
+	pong_rng_seed(&match->rng, 0, 0);
+
+	update_centers(match);
+}
+
+void pong_sim_seed(PongMatch* match, uint64_t seed, uint64_t stream)
+{
+	pong_rng_seed(&match->rng, seed, stream);
+}
+
+static void start_game(PongMatch* m, int multiplayer, int RWGMode)
+{
+	m->multiplayer = multiplayer;
+	m->gameOn = 1;
+	m->RWGMode = RWGMode;
+
+	// reset score
+	m->p1Score = 0;
+	m->p2Score = 0;
+
+	reset_paddles(m);
+	reset_ball(m);
+	reset_colors(m);
+}
+
+static void serve(PongMatch* m)
+{
+	const PongConfig* c = &m->config;
+
+	m->ballInPlay = 1;
+
+	// randomize initial speed and direction
+	m->ballSpeedX = pong_tick_speed(c, PONG_FIXED(2));
+	m->ballSpeedY = pong_tick_speed(c, PONG_FIXED(pong_rng_below(&m->rng, 3)));
+
+	if (pong_rng_below(&m->rng, 2) == 0) // 50/50 to start moving up/down
+	{
+		m->ballSpeedY *= -1;
+	}
+
+	if (m->lastPoint == 0) // new game
+	{
+		if (pong_rng_below(&m->rng, 2) == 0) // 50/50 to move toward P1
+		{
+			m->ballDirX = -1;
+		}
+	}
+	else if (m->lastPoint == 1) // if P1 scored last, move towards P2
+	{
+		m->ballDirX = 1;
+	}
+	else if (m->lastPoint == 2) // if P2 scored last, move towards P1
+	{
+		m->ballDirX = -1;
+	}
+}
+
+// edge-triggered colour switch: steps the setting once per key press
+static void color_switch(int held, int* lock, int* setting, int step)
+{
+	if (held && *lock == 0)
+	{
+		*lock = 1;
+		*setting += step;
+		if (*setting < 0)
+		{
+			*setting = PONG_COLOR_COUNT - 1;
+		}
+		else if (*setting >= PONG_COLOR_COUNT)
+		{
+			*setting = 0;
+		}
+	}
+	else if (!held && *lock == 1)
+	{
+		*lock = 0;
+	}
+}
+
+#define MAX_BOUNCES 8	// walls and paddles the ball can meet in one frame
+
+// 0 to 3, the same order as PONG_INPUT_MODE_1 to 4
+static int mode(const PongMatch* m)
+{
+	return (m->RWGMode == 1) * 2 + (m->multiplayer == 1);
+}
+
+// menu, new game and serve, the part of a frame that can change the mode
+static unsigned int commands(PongMatch* m, PongInput input)
+{
+	unsigned int events = 0;
+
+	if ((input & PONG_INPUT_MENU) && m->gameOn == 1)
+	{
+		m->gameOn = 0;
+		m->ballInPlay = 0;
+		events |= PONG_EVENT_MENU;
+	}
+
+	if ((input & PONG_INPUT_MODE_MASK) && m->gameOn == 0)
+	{
+		if (input & PONG_INPUT_MODE_1)
+		{
+			start_game(m, 0, 0);
+		}
+		else if (input & PONG_INPUT_MODE_2)
+		{
+			start_game(m, 1, 0);
+		}
+		else if (input & PONG_INPUT_MODE_3)
+		{
+			start_game(m, 0, 1);
+		}
+		else
+		{
+			start_game(m, 1, 1);
+		}
+		events |= PONG_EVENT_START;
+	}
+
+	if ((input & PONG_INPUT_SERVE) && m->ballInPlay == 0 && m->gameOn == 1)
+	{
+		serve(m);
+		events |= PONG_EVENT_SERVE;
+	}
+
+	return events;
+}
+
+// the rest of the frame, through the play function for the match's mode
+static unsigned int play(PongMatch* m, PongInput input);
+
+// mode() and physics, 0 to 7: the index of the play function for the match
+static int kernel(const PongMatch* m)
+{
+	return (m->config.physics == PONG_PHYSICS_SWEPT) * 4 + mode(m);
+}
+
+//
+// one play function per mode and physics, see pong_sim_kernel.h
+//
+
+// checks the mode and physics every frame, for comparing against the rest
+#define PONG_SIM_RWG (m->RWGMode == 1)
+#define PONG_SIM_MULTIPLAYER (m->multiplayer == 1)
+#define PONG_SIM_SWEPT (m->config.physics == PONG_PHYSICS_SWEPT)
+#define PONG_SIM_PLAY play_generic
+#define PONG_SIM_RETURN_BALL return_ball_generic
+#define PONG_SIM_SWEEP_BALL sweep_ball_generic
+#include "pong_sim_kernel.h"
+
+// classic, against the AI, classic physics
+#define PONG_SIM_RWG 0
+#define PONG_SIM_MULTIPLAYER 0
+#define PONG_SIM_SWEPT 0
+#define PONG_SIM_PLAY play_classic_ai
+#define PONG_SIM_RETURN_BALL return_ball_classic_ai
+#define PONG_SIM_SWEEP_BALL sweep_ball_classic_ai
+#define PONG_SIM_STEP step_classic_ai
+#include "pong_sim_kernel.h"
+
+// classic, two players, classic physics
+#define PONG_SIM_RWG 0
+#define PONG_SIM_MULTIPLAYER 1
+#define PONG_SIM_SWEPT 0
+#define PONG_SIM_PLAY play_classic_human
+#define PONG_SIM_RETURN_BALL return_ball_classic_human
+#define PONG_SIM_SWEEP_BALL sweep_ball_classic_human
+#define PONG_SIM_STEP step_classic_human
+#include "pong_sim_kernel.h"
+
+// RWG, against the AI, classic physics
+#define PONG_SIM_RWG 1
+#define PONG_SIM_MULTIPLAYER 0
+#define PONG_SIM_SWEPT 0
+#define PONG_SIM_PLAY play_rwg_ai
+#define PONG_SIM_RETURN_BALL return_ball_rwg_ai
+#define PONG_SIM_SWEEP_BALL sweep_ball_rwg_ai
+#define PONG_SIM_STEP step_rwg_ai
+#include "pong_sim_kernel.h"
+
+// RWG, two players, classic physics
+#define PONG_SIM_RWG 1
+#define PONG_SIM_MULTIPLAYER 1
+#define PONG_SIM_SWEPT 0
+#define PONG_SIM_PLAY play_rwg_human
+#define PONG_SIM_RETURN_BALL return_ball_rwg_human
+#define PONG_SIM_SWEEP_BALL sweep_ball_rwg_human
+#define PONG_SIM_STEP step_rwg_human
+#include "pong_sim_kernel.h"
+
+// classic, against the AI, swept physics
+#define PONG_SIM_RWG 0
+#define PONG_SIM_MULTIPLAYER 0
+#define PONG_SIM_SWEPT 1
+#define PONG_SIM_PLAY play_classic_ai_swept
+#define PONG_SIM_RETURN_BALL return_ball_classic_ai_swept
+#define PONG_SIM_SWEEP_BALL sweep_ball_classic_ai_swept
+#define PONG_SIM_STEP step_classic_ai_swept
+#include "pong_sim_kernel.h"
+
+// classic, two players, swept physics
+#define PONG_SIM_RWG 0
+#define PONG_SIM_MULTIPLAYER 1
+#define PONG_SIM_SWEPT 1
+#define PONG_SIM_PLAY play_classic_human_swept
+#define PONG_SIM_RETURN_BALL return_ball_classic_human_swept
+#define PONG_SIM_SWEEP_BALL sweep_ball_classic_human_swept
+#define PONG_SIM_STEP step_classic_human_swept
+#include "pong_sim_kernel.h"
+
+// RWG, against the AI, swept physics
+#define PONG_SIM_RWG 1
+#define PONG_SIM_MULTIPLAYER 0
+#define PONG_SIM_SWEPT 1
+#define PONG_SIM_PLAY play_rwg_ai_swept
+#define PONG_SIM_RETURN_BALL return_ball_rwg_ai_swept
+#define PONG_SIM_SWEEP_BALL sweep_ball_rwg_ai_swept
+#define PONG_SIM_STEP step_rwg_ai_swept
+#include "pong_sim_kernel.h"
+
+// RWG, two players, swept physics
+#define PONG_SIM_RWG 1
+#define PONG_SIM_MULTIPLAYER 1
+#define PONG_SIM_SWEPT 1
+#define PONG_SIM_PLAY play_rwg_human_swept
+#define PONG_SIM_RETURN_BALL return_ball_rwg_human_swept
+#define PONG_SIM_SWEEP_BALL sweep_ball_rwg_human_swept
+#define PONG_SIM_STEP step_rwg_human_swept
+#include "pong_sim_kernel.h"
+
+typedef unsigned int (*PlayFn)(PongMatch* m, PongInput input, const PongTickConfig* t);
+
+// indexed by kernel()
+static const PlayFn plays[8] = {
+	play_classic_ai, play_classic_human, play_rwg_ai, play_rwg_human,
+	play_classic_ai_swept, play_classic_human_swept, play_rwg_ai_swept, play_rwg_human_swept
+};
+
+static unsigned int play(PongMatch* m, PongInput input)
+{
+	if (m->gameOn != 1)
+	{
+		return 0;
+	}
+	return plays[kernel(m)](m, input, &m->tick);
+}
+
+unsigned int pong_sim_step(PongMatch* m, PongInput input)
+{
+	unsigned int events = commands(m, input);
+
+	return events | play(m, input);
+}
+
+unsigned int pong_sim_step_generic(PongMatch* m, PongInput input)
+{
+	unsigned int events = commands(m, input);
+
+	PongTickConfig tick;
+
+	if (m->gameOn != 1)
+	{
+		return events;
+	}
+	pong_tick_config(&m->config, &tick);
+	return events | play_generic(m, input, &tick);
+}
+
+PongStepFn pong_sim_step_fn(const PongMatch* m)
+{
+	static const PongStepFn steps[8] = {
+		step_classic_ai, step_classic_human, step_rwg_ai, step_rwg_human,
+		step_classic_ai_swept, step_classic_human_swept, step_rwg_ai_swept, step_rwg_human_swept
+	};
+
+	return steps[kernel(m)];
+}
+
+const char* const pong_sim_state_names[PONG_SIM_STATE_FIELDS] = {
+	"p1.x", "p1.y", "p2.x", "p2.y", "ball.x", "ball.y",
+	"p1Center.y", "p2Center.y", "ballCenter.x", "ballCenter.y",
+	"ballInPlay", "gameOn", "RWGMode", "multiplayer",
+	"p1AColorSwitchLock", "p1DColorSwitchLock", "p2LColorSwitchLock", "p2RColorSwitchLock",
+	"p1Score", "p2Score", "p1ColorSetting", "p2ColorSetting", "ballColorSetting",
+	"ballSpeedX", "ballSpeedY", "ballDirX", "aiMovement", "ballHits", "lastPoint",
+	"rng.state lo", "rng.state hi", "rng.inc lo", "rng.inc hi"
+};
+
+void pong_sim_state(const PongMatch* m, int32_t fields[PONG_SIM_STATE_FIELDS])
+{
+	int32_t* f = fields;
+
+	*f++ = m->p1.x; *f++ = m->p1.y; *f++ = m->p2.x; *f++ = m->p2.y; *f++ = m->ball.x; *f++ = m->ball.y;
+	*f++ = m->p1Center.y; *f++ = m->p2Center.y; *f++ = m->ballCenter.x; *f++ = m->ballCenter.y;
+	*f++ = m->ballInPlay; *f++ = m->gameOn; *f++ = m->RWGMode; *f++ = m->multiplayer;
+	*f++ = m->p1AColorSwitchLock; *f++ = m->p1DColorSwitchLock; *f++ = m->p2LColorSwitchLock; *f++ = m->p2RColorSwitchLock;
+	*f++ = m->p1Score; *f++ = m->p2Score; *f++ = m->p1ColorSetting; *f++ = m->p2ColorSetting; *f++ = m->ballColorSetting;
+	*f++ = m->ballSpeedX; *f++ = m->ballSpeedY; *f++ = m->ballDirX; *f++ = m->aiMovement; *f++ = m->ballHits; *f++ = m->lastPoint;
+	*f++ = (int32_t)m->rng.state; *f++ = (int32_t)(m->rng.state >> 32); *f++ = (int32_t)m->rng.inc; *f++ = (int32_t)(m->rng.inc >> 32);
+}
+
+static uint32_t rotl32(uint32_t x, int r)
+{
+	return (x << r) | (x >> (32 - r));
+}
+
+static uint32_t mix(uint32_t hash, int32_t field)
+{
+	uint32_t k = rotl32((uint32_t)field * 0xcc9e2d51u, 15) * 0x1b873593u;
+
+	return rotl32(hash ^ k, 13) * 5 + 0xe6546b64u;
+}
+
+// MurmurHash3's mixing a field at a time, over four interleaved lanes so
+// the multiplies of neighbouring fields don't wait on each other
+uint32_t pong_sim_checksum(const PongMatch* m)
+{
+	int32_t fields[PONG_SIM_STATE_FIELDS];
+	uint32_t a = 2166136261u, b = a ^ 1, c = a ^ 2, d = a ^ 3;
+	uint32_t hash;
+	int i;
+
+	pong_sim_state(m, fields);
+	for (i = 0; i + 4 <= PONG_SIM_STATE_FIELDS; i += 4)
+	{
+		a = mix(a, fields[i]);
+		b = mix(b, fields[i + 1]);
+		c = mix(c, fields[i + 2]);
+		d = mix(d, fields[i + 3]);
+	}
+	for (; i < PONG_SIM_STATE_FIELDS; i++)
+	{
+		a = mix(a, fields[i]);
+	}
+	hash = a ^ rotl32(b, 8) ^ rotl32(c, 16) ^ rotl32(d, 24);
+
+	// final avalanche, so a one bit difference flips about half the hash
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bu;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35u;
+	hash ^= hash >> 16;
+	return hash;
+}
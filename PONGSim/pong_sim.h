@@ -0,0 +1,273 @@
+/*
+	Program: PONG
+	Module: pong_sim
+
+	Headless simulation core. Holds all per-match state and advances it one
+	frame at a time from an explicit input bitmask, without a window, a
+	renderer or SDL. The SDL front end in main.c is a thin client over it.
+
+	Positions, sizes and speeds inside a match are 16.16 fixed point, so the
+	ball can move by fractions of a pixel and still play out exactly the same
+	on every compiler. The config is in whole pixels.
+*/
+
+#ifndef PONG_SIM_H
+#define PONG_SIM_H
+
+#include "pong_rng.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// fixed point
+//
+typedef int PongFixed;
+
+#define PONG_FIXED_SHIFT 16
+#define PONG_FIXED_ONE (1 << PONG_FIXED_SHIFT)
+
+// whole pixels to fixed point and back, PONG_PIXELS rounds down
+#define PONG_FIXED(pixels) ((PongFixed)(pixels) * PONG_FIXED_ONE)
+#define PONG_PIXELS(fixed) ((fixed) >> PONG_FIXED_SHIFT)
+
+// same layout as SDL_Rect / SDL_Point. In a PongMatch every field is a
+// PongFixed, the front end converts with PONG_PIXELS when it draws
+typedef struct PongRect
+{
+	int x, y;
+	int w, h;
+} PongRect;
+
+typedef struct PongPoint
+{
+	int x, y;
+} PongPoint;
+
+//
+// input: one bitmask per frame
+//
+
+// held keys, sampled once per frame
+#define PONG_INPUT_P1_UP      (1u << 0)  // W
+#define PONG_INPUT_P1_DOWN    (1u << 1)  // S
+#define PONG_INPUT_P1_LEFT    (1u << 2)  // A, RWG colour switch
+#define PONG_INPUT_P1_RIGHT   (1u << 3)  // D, RWG colour switch
+#define PONG_INPUT_P2_UP      (1u << 4)  // UP
+#define PONG_INPUT_P2_DOWN    (1u << 5)  // DOWN
+#define PONG_INPUT_P2_LEFT    (1u << 6)  // LEFT, RWG colour switch
+#define PONG_INPUT_P2_RIGHT   (1u << 7)  // RIGHT, RWG colour switch
+
+// commands, set only on the frame the key went down
+#define PONG_INPUT_SERVE      (1u << 8)  // SPACE
+#define PONG_INPUT_MODE_1     (1u << 9)  // [1] Classic vs. AI
+#define PONG_INPUT_MODE_2     (1u << 10) // [2] Classic vs. Human
+#define PONG_INPUT_MODE_3     (1u << 11) // [3] RWG Mode vs. AI
+#define PONG_INPUT_MODE_4     (1u << 12) // [4] RWG Mode vs. Human
+#define PONG_INPUT_MENU       (1u << 13) // ESC while a game is on
+
+#define PONG_INPUT_HELD_MASK  0x00ffu
+#define PONG_INPUT_MODE_MASK  (PONG_INPUT_MODE_1 | PONG_INPUT_MODE_2 | PONG_INPUT_MODE_3 | PONG_INPUT_MODE_4)
+
+typedef unsigned int PongInput;
+
+//
+// events: what happened during a frame, returned by pong_sim_step
+//
+
+#define PONG_EVENT_WALL_TOP    (1u << 0)
+#define PONG_EVENT_WALL_BOTTOM (1u << 1)
+#define PONG_EVENT_HIT_P1      (1u << 2)
+#define PONG_EVENT_HIT_P2      (1u << 3)
+#define PONG_EVENT_SCORE       (1u << 4) // see lastPoint for who scored
+#define PONG_EVENT_WIN         (1u << 5) // winScore reached, game is over
+#define PONG_EVENT_START       (1u << 6) // a new game was started from the menu
+#define PONG_EVENT_MENU        (1u << 7) // game abandoned, back to the menu
+#define PONG_EVENT_SERVE       (1u << 8)
+
+// colour settings shared by paddles and ball
+#define PONG_COLOR_WHITE 0
+#define PONG_COLOR_RED   1
+#define PONG_COLOR_GREEN 2
+#define PONG_COLOR_COUNT 3
+
+// ball physics, PongConfig.physics
+#define PONG_PHYSICS_CLASSIC 0	// move, then test for overlap: fast balls pass through paddles
+#define PONG_PHYSICS_SWEPT   1	// swept collision, walls and paddles are met at their time of impact
+
+//
+// balance settings, fixed for the whole match
+//
+typedef struct PongConfig
+{
+	int scrWidth;
+	int scrHeight;
+
+	int paddleW;
+	int paddleH;
+	int ballSize;
+
+	// speeds are pixels per 1/60 s, see tickRate
+	int paddleSpeed;
+
+	int ballSpeedCapX;
+	int ballSpeedCapY;
+
+	int hitsPerSpeedUp;		// Every X hits, increase ballSpeedX
+	int aiDetectRange;		// min of 2, larger numbers make ai detect ball farther away
+	int winScore;
+
+	int physics;			// PONG_PHYSICS_*
+
+	int tickRate;			// pong_sim_step calls per second, every speed is scaled to it
+	PongFixed speedUpStep;	// added to ballSpeedX every hitsPerSpeedUp hits
+	PongFixed spinStep;		// added to ballSpeedY by a paddle moving as it hits
+} PongConfig;
+
+//
+// the config as a frame uses it, speeds per tick and sizes as PongFixed.
+// Worked out once when the match is set up, see pong_tick_config
+//
+typedef struct PongTickConfig
+{
+	PongFixed width;
+	PongFixed height;
+	PongFixed halfWidth;
+	PongFixed aiDetectX;	// the AI goes for a ball heading its way past here
+	PongFixed paddleSpeed;
+	PongFixed ballSpeedCapX;
+	PongFixed ballSpeedCapY;
+	PongFixed speedUpStep;
+	PongFixed spinStep;
+} PongTickConfig;
+
+//
+// everything that changes during a match
+//
+typedef struct PongMatch
+{
+	PongConfig config;
+	PongTickConfig tick;	// from config, doesn't change either
+
+	// PongFixed, like the speeds below
+	PongRect p1;
+	PongRect p2;
+	PongRect ball;
+
+	PongPoint p1Center;		// used in collision detection and by the AI
+	PongPoint p2Center;
+	PongPoint ballCenter;
+
+	// flags
+	int ballInPlay;			// non-zero when ball has been served, reverts when a point is scored
+	int gameOn;				// non-zero when a game has started, reverts when a player wins
+	int RWGMode;			// non-zero to play Red, White, Green mode
+	int multiplayer;		// non-zero to play against another human player
+
+	// key locks: prevents firing per frame
+	int p1AColorSwitchLock;
+	int p1DColorSwitchLock;
+	int p2LColorSwitchLock;
+	int p2RColorSwitchLock;
+
+	int p1Score;
+	int p2Score;
+
+	int p1ColorSetting;
+	int p2ColorSetting;
+	int ballColorSetting;
+
+	PongFixed ballSpeedX;	// per tick, always positive, see ballDirX
+	PongFixed ballSpeedY;	// per tick
+	int ballDirX;
+
+	int aiMovement;			// 0 = stationary; 1 = down; -1 = up
+	int ballHits;
+	int lastPoint;			// set to 1 when P1 scores, and 2 when P2 scores. Determines serve direction
+
+	PongRng rng;			// serves and RWG colour changes, see pong_sim_seed
+} PongMatch;
+
+// fills in the stock balance settings (640x480, first to 11, classic physics, 60 ticks a second)
+void pong_config_default(PongConfig* config);
+
+// a speed in pixels per 1/60 s (as PongFixed) as a distance per tick at config->tickRate
+PongFixed pong_tick_speed(const PongConfig* config, PongFixed speed);
+
+// fills in tick from config. pong_sim_init does this, only code that sets a
+// match's config itself needs to
+void pong_tick_config(const PongConfig* config, PongTickConfig* tick);
+
+// puts a match in the menu state with paddles and ball centred
+void pong_sim_init(PongMatch* match, const PongConfig* config);
+
+// seeds the match's own random numbers. The same seed, stream and inputs
+// always play out the same; matches on different streams of one seed are
+// independent of each other
+void pong_sim_seed(PongMatch* match, uint64_t seed, uint64_t stream);
+
+// advances the match by one frame and returns the PONG_EVENT_* flags that fired
+unsigned int pong_sim_step(PongMatch* match, PongInput input);
+
+typedef unsigned int (*PongStepFn)(PongMatch* match, PongInput input);
+
+// pong_sim_step built for the mode and physics match is playing with now,
+// with the checks for the others compiled out. Look it up once a game has
+// started and call it every frame; a later game in another mode still
+// plays correctly, just through pong_sim_step's own lookup
+PongStepFn pong_sim_step_fn(const PongMatch* match);
+
+// pong_sim_step checking the mode and physics at every turn and scaling
+// every speed to the tick rate each frame, as it did before the
+// specialised versions, for benchmarks and comparisons
+unsigned int pong_sim_step_generic(PongMatch* match, PongInput input);
+
+// every field that changes during a match as ints, in a fixed order:
+// rects, centres, flags, locks, scores, colours, speeds and the RNG. What
+// pong_sim_checksum hashes, and what recordings keep to show where a
+// replay drifted. Padding bytes are never read
+#define PONG_SIM_STATE_FIELDS 33
+
+void pong_sim_state(const PongMatch* match, int32_t fields[PONG_SIM_STATE_FIELDS]);
+
+// names of the pong_sim_state fields, for printing two states side by side
+extern const char* const pong_sim_state_names[PONG_SIM_STATE_FIELDS];
+
+// hash of pong_sim_state, a word at a time, for spotting two copies of a
+// match that have drifted apart. Cheap enough to take every tick
+uint32_t pong_sim_checksum(const PongMatch* match);
+
+// same rules as SDL_HasIntersection
+int pong_rect_intersects(const PongRect* a, const PongRect* b);
+
+//
+// swept collision
+//
+
+// the side of the target that was struck
+#define PONG_SIDE_NONE   0
+#define PONG_SIDE_LEFT   1
+#define PONG_SIDE_RIGHT  2
+#define PONG_SIDE_TOP    3
+#define PONG_SIDE_BOTTOM 4
+
+// times are fractions of the move, in 1/PONG_SWEEP_ONE
+#define PONG_SWEEP_ONE 65536
+
+typedef struct PongSweep
+{
+	int time;				// time of impact, 0 to PONG_SWEEP_ONE - 1
+	int side;				// PONG_SIDE_*
+} PongSweep;
+
+// moves a by (dx, dy) and returns non-zero if it starts to overlap b on the
+// way, with the time and side of the impact. Rects that already overlap hit
+// at time 0, on the side of the axis they came together on last
+int pong_rect_sweep(const PongRect* a, int dx, int dy, const PongRect* b, PongSweep* hit);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
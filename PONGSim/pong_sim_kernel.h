@@ -0,0 +1,366 @@
+/*
+	Program: PONG
+	Module: pong_sim
+
+	One frame of play for a match with a game on, everything in
+	pong_sim_step after the commands. Included once per mode and physics by
+	pong_sim.c, which first defines:
+
+		PONG_SIM_RWG            non-zero in RWG mode
+		PONG_SIM_MULTIPLAYER    non-zero with two humans, zero against the built-in AI
+		PONG_SIM_SWEPT          non-zero with PONG_PHYSICS_SWEPT
+		PONG_SIM_PLAY           name of the generated play function
+		PONG_SIM_RETURN_BALL    names of its helpers
+		PONG_SIM_SWEEP_BALL
+		PONG_SIM_STEP           optional, name of a whole step built on it
+
+	and undefines them all again at the end. Defined as constants the
+	compiler drops every mode and physics check: classic matches never look
+	at colours, which can't change outside RWG mode, human matches never run
+	the AI, and each physics only keeps its own collisions. Defined as tests
+	of the match it gives the unspecialised frame that checks each time.
+
+	Speeds and distances come in a PongTickConfig, worked out once per
+	match by the specialised frames and every frame by the unspecialised
+	one.
+*/
+
+// a paddle only meets a ball of its own colour, in classic mode both are always colour 0
+#define PONG_SIM_SAME_COLOR(setting) (!PONG_SIM_RWG || (setting) == m->ballColorSetting)
+
+// a paddle sent the ball back: turn it round, count the hit and add the
+// paddle's movement to its vertical speed
+static unsigned int PONG_SIM_RETURN_BALL(PongMatch* m, PongInput input, int player, const PongTickConfig* t)
+{
+	PongFixed capY = t->ballSpeedCapY;
+	PongFixed spin = t->spinStep;
+
+	m->ballDirX *= -1;
+	m->ballHits++;
+
+	if (player == 1)
+	{
+		if ((input & PONG_INPUT_P1_UP) && m->ballSpeedY > -capY) // paddle moving up
+		{
+			m->ballSpeedY -= spin;
+		}
+		else if ((input & PONG_INPUT_P1_DOWN) && m->ballSpeedY < capY) // paddle moving down
+		{
+			m->ballSpeedY += spin;
+		}
+	}
+	else
+	{
+		if (((input & PONG_INPUT_P2_UP) && m->ballSpeedY > -capY) || (PONG_SIM_MULTIPLAYER && m->aiMovement == -1))
+		{
+			m->ballSpeedY -= spin;
+		}
+		else if (((input & PONG_INPUT_P2_DOWN) && m->ballSpeedY < capY) || (PONG_SIM_MULTIPLAYER && m->aiMovement == 1))
+		{
+			m->ballSpeedY += spin;
+		}
+	}
+
+	if (PONG_SIM_RWG)
+	{
+		m->ballColorSetting = pong_rng_below(&m->rng, 3);
+	}
+
+	return player == 1 ? PONG_EVENT_HIT_P1 : PONG_EVENT_HIT_P2;
+}
+
+// PONG_PHYSICS_SWEPT: moves the ball a whole frame, meeting walls and paddles
+// in the order it reaches them, however fast it goes. Walls reflect it where
+// it touches. A paddle's face returns it, the paddle's ends only turn it
+// vertically, and a paddle of the wrong RWG colour lets it through
+static unsigned int PONG_SIM_SWEEP_BALL(PongMatch* m, PongInput input, const PongTickConfig* t)
+{
+	PongFixed bottom = t->height - m->ball.h;
+	int left = PONG_SWEEP_ONE;	// of the frame
+	unsigned int events = 0;
+
+	for (int bounce = 0; bounce < MAX_BOUNCES && left > 0; bounce++)
+	{
+		PongFixed dx = m->ballSpeedX * m->ballDirX;
+		PongFixed dy = m->ballSpeedY;
+		PongSweep first, hit;
+		PongRect* paddle = NULL;
+		int player = 0;
+
+		first.time = left;
+		first.side = PONG_SIDE_NONE;
+
+		// walls, the ball is always between them
+		if (dy < 0 && (int64_t)m->ball.y * PONG_SWEEP_ONE / -dy < first.time)
+		{
+			first.time = (int)((int64_t)m->ball.y * PONG_SWEEP_ONE / -dy);
+			first.side = PONG_SIDE_TOP;
+		}
+		else if (dy > 0 && (int64_t)(bottom - m->ball.y) * PONG_SWEEP_ONE / dy < first.time)
+		{
+			first.time = (int)((int64_t)(bottom - m->ball.y) * PONG_SWEEP_ONE / dy);
+			first.side = PONG_SIDE_BOTTOM;
+		}
+
+		// only the paddle it's heading for, and only in its colour
+		if (m->ballDirX == -1 && PONG_SIM_SAME_COLOR(m->p1ColorSetting)
+			&& pong_rect_sweep(&m->ball, dx, dy, &m->p1, &hit) && hit.time < first.time)
+		{
+			first = hit;
+			paddle = &m->p1;
+			player = 1;
+		}
+		else if (m->ballDirX == 1 && PONG_SIM_SAME_COLOR(m->p2ColorSetting)
+			&& pong_rect_sweep(&m->ball, dx, dy, &m->p2, &hit) && hit.time < first.time)
+		{
+			first = hit;
+			paddle = &m->p2;
+			player = 2;
+		}
+
+		m->ball.x += (int)floor_div((int64_t)dx * first.time, PONG_SWEEP_ONE);
+		m->ball.y += (int)floor_div((int64_t)dy * first.time, PONG_SWEEP_ONE);
+		left -= first.time;
+
+		if (first.side == PONG_SIDE_NONE)
+		{
+			break;
+		}
+		if (!paddle) // wall
+		{
+			m->ball.y = first.side == PONG_SIDE_TOP ? 0 : bottom;
+			m->ballSpeedY *= -1;
+			events |= first.side == PONG_SIDE_TOP ? PONG_EVENT_WALL_TOP : PONG_EVENT_WALL_BOTTOM;
+		}
+		else if (first.side == PONG_SIDE_LEFT || first.side == PONG_SIDE_RIGHT)
+		{
+			m->ball.x = first.side == PONG_SIDE_LEFT ? paddle->x - m->ball.w : paddle->x + paddle->w;
+			events |= PONG_SIM_RETURN_BALL(m, input, player, t);
+		}
+		else
+		{
+			m->ball.y = first.side == PONG_SIDE_TOP ? paddle->y - m->ball.h : paddle->y + paddle->h;
+			if (m->ball.y < 0 || m->ball.y > bottom) // squeezed between the paddle's end and the wall
+			{
+				m->ball.y = m->ball.y < 0 ? 0 : bottom;
+			}
+			if ((first.side == PONG_SIDE_TOP) == (m->ballSpeedY > 0))
+			{
+				m->ballSpeedY *= -1; // away from the paddle
+			}
+		}
+	}
+
+	return events;
+}
+
+static unsigned int PONG_SIM_PLAY(PongMatch* m, PongInput input, const PongTickConfig* t)
+{
+	const PongConfig* c = &m->config;
+	PongFixed paddleSpeed = t->paddleSpeed;
+	PongFixed width = t->width;
+	PongFixed height = t->height;
+	unsigned int events = 0;
+
+	//
+	// update paddle position based on input
+	//
+
+	// player 1 controls
+	if (input & PONG_INPUT_P1_UP)
+	{
+		m->p1.y -= paddleSpeed;
+	}
+	if (input & PONG_INPUT_P1_DOWN)
+	{
+		m->p1.y += paddleSpeed;
+	}
+
+	// player 2 controls
+	if (PONG_SIM_MULTIPLAYER)
+	{
+		if (input & PONG_INPUT_P2_UP)
+		{
+			m->p2.y -= paddleSpeed;
+		}
+		if (input & PONG_INPUT_P2_DOWN)
+		{
+			m->p2.y += paddleSpeed;
+		}
+	}
+	else // AI controls
+	{
+		if (m->ballCenter.x > t->aiDetectX && m->ballDirX == 1) // if ball on AI side and headed towards AI
+		{
+			if (m->ballCenter.y > m->p2Center.y + paddleSpeed) // move down to ball
+			{
+				m->p2.y += paddleSpeed;
+				m->aiMovement = 1;
+			}
+			else if (m->ballCenter.y < m->p2Center.y - paddleSpeed) // move up to ball
+			{
+				m->p2.y -= paddleSpeed;
+				m->aiMovement = -1;
+			}
+		}
+		else
+		{
+			m->aiMovement = 0;
+		}
+	}
+
+	// RWG Controls
+	if (PONG_SIM_RWG)
+	{
+		// player 1
+		color_switch(input & PONG_INPUT_P1_LEFT, &m->p1AColorSwitchLock, &m->p1ColorSetting, -1);
+		color_switch(input & PONG_INPUT_P1_RIGHT, &m->p1DColorSwitchLock, &m->p1ColorSetting, 1);
+
+		// player 2
+		if (PONG_SIM_MULTIPLAYER)
+		{
+			color_switch(input & PONG_INPUT_P2_LEFT, &m->p2LColorSwitchLock, &m->p2ColorSetting, -1);
+			color_switch(input & PONG_INPUT_P2_RIGHT, &m->p2RColorSwitchLock, &m->p2ColorSetting, 1);
+		}
+		else // AI RWG Controls
+		{
+			if (m->ballDirX > 0 && m->ballCenter.x > t->halfWidth)
+			{
+				m->p2ColorSetting = m->ballColorSetting; // always match ball color
+			}
+		}
+	}
+
+	// player 1 boundary collision (before the ball moves, swept collision needs the paddles where they end up)
+	if (m->p1.y < 0)
+	{
+		m->p1.y = 0;
+	}
+	if (m->p1.y > height - m->p1.h)
+	{
+		m->p1.y = height - m->p1.h;
+	}
+
+	// player 2 boundary collision
+	if (m->p2.y < 0)
+	{
+		m->p2.y = 0;
+	}
+	if (m->p2.y > height - m->p2.h)
+	{
+		m->p2.y = height - m->p2.h;
+	}
+
+	// ball movement
+	if (m->ballInPlay != 0)
+	{
+		if (PONG_SIM_SWEPT)
+		{
+			events |= PONG_SIM_SWEEP_BALL(m, input, t);
+		}
+		else
+		{
+			m->ball.x += m->ballSpeedX * m->ballDirX;
+			m->ball.y += m->ballSpeedY;
+		}
+	}
+	if (m->ballHits >= c->hitsPerSpeedUp)
+	{
+		m->ballHits = 0;
+		if (m->ballSpeedX < t->ballSpeedCapX)
+		{
+			m->ballSpeedX += t->speedUpStep;
+		}
+	}
+
+	// ball boundary collision
+	if (m->ball.y < 0)
+	{
+		events |= PONG_EVENT_WALL_TOP;
+		m->ball.y = 0;
+		m->ballSpeedY *= -1;
+	}
+	if (m->ball.y > height - m->ball.h)
+	{
+		events |= PONG_EVENT_WALL_BOTTOM;
+		m->ball.y = height - m->ball.h;
+		m->ballSpeedY *= -1;
+	}
+
+	update_centers(m);
+
+	//
+	// ball and paddle collision
+	//
+
+	// classic physics: https://www.youtube.com/watch?v=SHsYjWm8XSI
+	if (!PONG_SIM_SWEPT)
+	{
+		if (pong_rect_intersects(&m->ball, &m->p1) && m->ballDirX == -1 && PONG_SIM_SAME_COLOR(m->p1ColorSetting))
+		{
+			events |= PONG_SIM_RETURN_BALL(m, input, 1, t);
+		}
+		else if (pong_rect_intersects(&m->ball, &m->p2) && m->ballDirX == 1 && PONG_SIM_SAME_COLOR(m->p2ColorSetting))
+		{
+			events |= PONG_SIM_RETURN_BALL(m, input, 2, t);
+		}
+	}
+
+	// ball out of bounds
+	if (m->ball.x < 0 - m->ball.w || m->ball.x > width) // score
+	{
+		if (m->ball.x > width)	// player 1 score
+		{
+			m->p1Score++;
+			m->lastPoint = 1;
+		}
+		else						// player 2 score
+		{
+			m->p2Score++;
+			m->lastPoint = 2;
+		}
+		events |= PONG_EVENT_SCORE;
+
+		// play is paused
+		m->ballInPlay = 0;
+
+		if (PONG_SIM_RWG)
+		{
+			reset_colors(m);
+		}
+		reset_ball(m);
+
+		// win score reached
+		if (m->p1Score >= c->winScore || m->p2Score >= c->winScore)
+		{
+			m->gameOn = 0;
+			events |= PONG_EVENT_WIN;
+		}
+	}
+
+	return events;
+}
+
+#ifdef PONG_SIM_STEP
+// commands and play, for pong_sim_step_fn. A command that starts a game in
+// another mode sends that frame through pong_sim_step's lookup instead
+static unsigned int PONG_SIM_STEP(PongMatch* m, PongInput input)
+{
+	unsigned int events = commands(m, input);
+
+	if (m->gameOn != 1 || kernel(m) != PONG_SIM_SWEPT * 4 + PONG_SIM_RWG * 2 + PONG_SIM_MULTIPLAYER)
+	{
+		return events | play(m, input);
+	}
+	return events | PONG_SIM_PLAY(m, input, &m->tick);
+}
+#endif
+
+#undef PONG_SIM_SAME_COLOR
+#undef PONG_SIM_RWG
+#undef PONG_SIM_MULTIPLAYER
+#undef PONG_SIM_SWEPT
+#undef PONG_SIM_PLAY
+#undef PONG_SIM_RETURN_BALL
+#undef PONG_SIM_SWEEP_BALL
+#undef PONG_SIM_STEP
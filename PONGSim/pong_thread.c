@@ -0,0 +1,301 @@
+/*
+	Program: PONG
+	Module: pong_thread
+*/
+
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L // clock_gettime()
+#endif
+
+#include "pong_thread.h"
+
+#include <stdlib.h> // malloc()
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+struct PongThread
+{
+	HANDLE handle;
+	PongThreadFn fn;
+	void* data;
+};
+
+static DWORD WINAPI thread_main(LPVOID param)
+{
+	PongThread* thread = (PongThread*)param;
+	return (DWORD)thread->fn(thread->data);
+}
+
+PongThread* pong_thread_create(PongThreadFn fn, void* data)
+{
+	PongThread* thread = (PongThread*)malloc(sizeof(PongThread));
+
+	if (!thread)
+	{
+		return NULL;
+	}
+	thread->fn = fn;
+	thread->data = data;
+	thread->handle = CreateThread(NULL, 0, thread_main, thread, 0, NULL);
+	if (!thread->handle)
+	{
+		free(thread);
+		return NULL;
+	}
+
+	return thread;
+}
+
+int pong_thread_join(PongThread* thread)
+{
+	DWORD result = 0;
+
+	WaitForSingleObject(thread->handle, INFINITE);
+	GetExitCodeThread(thread->handle, &result);
+	CloseHandle(thread->handle);
+	free(thread);
+
+	return (int)result;
+}
+
+int pong_cpu_count(void)
+{
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
+void pong_spin_lock(PongSpinLock* lock)
+{
+	while (InterlockedExchange(lock, 1) != 0)
+	{
+		while (*lock != 0)
+		{
+			YieldProcessor();
+		}
+	}
+}
+
+void pong_spin_unlock(PongSpinLock* lock)
+{
+	InterlockedExchange(lock, 0);
+}
+
+struct PongSemaphore
+{
+	HANDLE handle;
+};
+
+PongSemaphore* pong_semaphore_create(int count)
+{
+	PongSemaphore* semaphore = (PongSemaphore*)malloc(sizeof(PongSemaphore));
+
+	if (!semaphore)
+	{
+		return NULL;
+	}
+	semaphore->handle = CreateSemaphore(NULL, count, 0x7fffffff, NULL);
+	if (!semaphore->handle)
+	{
+		free(semaphore);
+		return NULL;
+	}
+
+	return semaphore;
+}
+
+void pong_semaphore_destroy(PongSemaphore* semaphore)
+{
+	CloseHandle(semaphore->handle);
+	free(semaphore);
+}
+
+void pong_semaphore_post(PongSemaphore* semaphore)
+{
+	ReleaseSemaphore(semaphore->handle, 1, NULL);
+}
+
+void pong_semaphore_wait(PongSemaphore* semaphore)
+{
+	WaitForSingleObject(semaphore->handle, INFINITE);
+}
+
+long pong_atomic_add(volatile long* value, long amount)
+{
+	return InterlockedExchangeAdd(value, amount);
+}
+
+double pong_clock_seconds(void)
+{
+	LARGE_INTEGER count, frequency;
+
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&frequency);
+	return (double)count.QuadPart / (double)frequency.QuadPart;
+}
+
+void pong_sleep_ms(int ms)
+{
+	Sleep(ms > 0 ? (DWORD)ms : 0);
+}
+
+#else
+
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+struct PongThread
+{
+	pthread_t handle;
+	PongThreadFn fn;
+	void* data;
+	int result;
+};
+
+static void* thread_main(void* param)
+{
+	PongThread* thread = (PongThread*)param;
+	thread->result = thread->fn(thread->data);
+	return NULL;
+}
+
+PongThread* pong_thread_create(PongThreadFn fn, void* data)
+{
+	PongThread* thread = (PongThread*)malloc(sizeof(PongThread));
+
+	if (!thread)
+	{
+		return NULL;
+	}
+	thread->fn = fn;
+	thread->data = data;
+	thread->result = 0;
+	if (pthread_create(&thread->handle, NULL, thread_main, thread) != 0)
+	{
+		free(thread);
+		return NULL;
+	}
+
+	return thread;
+}
+
+int pong_thread_join(PongThread* thread)
+{
+	int result;
+
+	pthread_join(thread->handle, NULL);
+	result = thread->result;
+	free(thread);
+
+	return result;
+}
+
+int pong_cpu_count(void)
+{
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (int)count : 1;
+}
+
+void pong_spin_lock(PongSpinLock* lock)
+{
+	while (__sync_lock_test_and_set(lock, 1) != 0)
+	{
+		while (*lock != 0)
+		{
+			sched_yield();
+		}
+	}
+}
+
+void pong_spin_unlock(PongSpinLock* lock)
+{
+	__sync_lock_release(lock);
+}
+
+// a mutex and a condition variable, unnamed POSIX semaphores aren't everywhere
+struct PongSemaphore
+{
+	pthread_mutex_t mutex;
+	pthread_cond_t posted;
+	int count;
+};
+
+PongSemaphore* pong_semaphore_create(int count)
+{
+	PongSemaphore* semaphore = (PongSemaphore*)malloc(sizeof(PongSemaphore));
+
+	if (!semaphore)
+	{
+		return NULL;
+	}
+	if (pthread_mutex_init(&semaphore->mutex, NULL) != 0)
+	{
+		free(semaphore);
+		return NULL;
+	}
+	if (pthread_cond_init(&semaphore->posted, NULL) != 0)
+	{
+		pthread_mutex_destroy(&semaphore->mutex);
+		free(semaphore);
+		return NULL;
+	}
+	semaphore->count = count;
+
+	return semaphore;
+}
+
+void pong_semaphore_destroy(PongSemaphore* semaphore)
+{
+	pthread_cond_destroy(&semaphore->posted);
+	pthread_mutex_destroy(&semaphore->mutex);
+	free(semaphore);
+}
+
+void pong_semaphore_post(PongSemaphore* semaphore)
+{
+	pthread_mutex_lock(&semaphore->mutex);
+	semaphore->count++;
+	pthread_cond_signal(&semaphore->posted);
+	pthread_mutex_unlock(&semaphore->mutex);
+}
+
+void pong_semaphore_wait(PongSemaphore* semaphore)
+{
+	pthread_mutex_lock(&semaphore->mutex);
+	while (semaphore->count == 0)
+	{
+		pthread_cond_wait(&semaphore->posted, &semaphore->mutex);
+	}
+	semaphore->count--;
+	pthread_mutex_unlock(&semaphore->mutex);
+}
+
+long pong_atomic_add(volatile long* value, long amount)
+{
+	return __sync_fetch_and_add(value, amount);
+}
+
+double pong_clock_seconds(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec + now.tv_nsec / 1e9;
+}
+
+void pong_sleep_ms(int ms)
+{
+	struct timespec wait;
+
+	wait.tv_sec = ms / 1000;
+	wait.tv_nsec = (ms % 1000) * 1000000L;
+	nanosleep(&wait, NULL);
+}
+
+#endif
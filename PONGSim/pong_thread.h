@@ -0,0 +1,58 @@
+/*
+	Program: PONG
+	Module: pong_thread
+
+	Just enough threading for the headless tools: start/join a thread,
+	spin locks, semaphores, atomic add, CPU count, a wall clock and sleep.
+	Win32 threads on Windows, pthreads everywhere else.
+*/
+
+#ifndef PONG_THREAD_H
+#define PONG_THREAD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct PongThread PongThread;
+
+typedef int (*PongThreadFn)(void* data);
+
+// returns NULL if the thread could not be started
+PongThread* pong_thread_create(PongThreadFn fn, void* data);
+
+// waits for the thread to finish and returns what fn returned
+int pong_thread_join(PongThread* thread);
+
+// logical processors available to this process, at least 1
+int pong_cpu_count(void);
+
+// 0 = unlocked
+typedef volatile long PongSpinLock;
+
+void pong_spin_lock(PongSpinLock* lock);
+void pong_spin_unlock(PongSpinLock* lock);
+
+typedef struct PongSemaphore PongSemaphore;
+
+// counts posts, a wait takes one or sleeps until there is one. NULL if it
+// could not be made
+PongSemaphore* pong_semaphore_create(int count);
+void pong_semaphore_destroy(PongSemaphore* semaphore);
+void pong_semaphore_post(PongSemaphore* semaphore);
+void pong_semaphore_wait(PongSemaphore* semaphore);
+
+// adds to *value and returns the value it had before
+long pong_atomic_add(volatile long* value, long amount);
+
+// monotonic wall clock in seconds, for timing runs across threads
+double pong_clock_seconds(void);
+
+// gives up the CPU for about ms milliseconds
+void pong_sleep_ms(int ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,274 @@
+/*
+	Program: PONG
+	Tool: sim_bench
+
+	Headless throughput test for the simulation. Steps a batch of matches
+	with scripted input and reports match-frames per second. With --verify
+	every lane is also stepped through pong_sim_step and compared field by
+	field after every frame. With --variants it instead times each game
+	mode under both physics one match at a time, through
+	pong_sim_step_generic and through the step pong_sim_step_fn picks.
+
+	usage: sim_bench [--matches N] [--frames N] [--scalar] [--verify] [--variants]
+*/
+
+#include <stdio.h>  // standard input/output
+#include <stdlib.h> // atoi(), malloc()
+#include <string.h> // strcmp(), memcmp()
+#include <time.h>   // clock()
+
+#include "pong_sim.h"
+#include "pong_batch.h"
+
+// scripted players: held keys change every few frames, games are started in mode 0 to 3 and served right away
+static PongInput script_input(unsigned int* state, int lane, int mode, int gameOn, int ballInPlay, int frame)
+{
+	static PongInput held[1 << 16];
+	PongInput input;
+
+	if (frame % 8 == 0)
+	{
+		*state = *state * 1103515245u + 12345u;
+		held[lane & 0xffff] = (*state >> 16) & PONG_INPUT_HELD_MASK;
+	}
+	input = held[lane & 0xffff];
+
+	if (!gameOn)
+	{
+		input |= PONG_INPUT_MODE_1 << mode;
+	}
+	else if (!ballInPlay)
+	{
+		input |= PONG_INPUT_SERVE;
+	}
+
+	return input;
+}
+
+#define VARIANT_RUNS 5
+
+// count matches in one mode, each played through for frames before the next,
+// by pong_sim_step_generic or by the specialised step. returns the seconds taken
+static double play_variant(const PongConfig* config, PongMatch* matches, int count, int frames, int mode, int specialised)
+{
+	clock_t start, elapsed;
+
+	for (int i = 0; i < count; i++)
+	{
+		pong_sim_init(&matches[i], config);
+		pong_sim_seed(&matches[i], 1, i);
+		pong_sim_step(&matches[i], PONG_INPUT_MODE_1 << mode);
+	}
+
+	start = clock();
+	for (int i = 0; i < count; i++)
+	{
+		PongMatch* m = &matches[i];
+		PongStepFn step = specialised ? pong_sim_step_fn(m) : pong_sim_step_generic;
+		unsigned int state = i;
+
+		for (int f = 0; f < frames; f++)
+		{
+			step(m, script_input(&state, i, mode, m->gameOn, m->ballInPlay, f));
+		}
+	}
+	elapsed = clock() - start;
+
+	return elapsed > 0 ? (double)elapsed / CLOCKS_PER_SEC : 1.0 / CLOCKS_PER_SEC;
+}
+
+static int bench_variants(const PongConfig* defaults, int count, int frames)
+{
+	static const char* const names[4] = { "classic vs AI", "classic 2P", "RWG vs AI", "RWG 2P" };
+	PongMatch* generic = (PongMatch*)malloc(count * sizeof(PongMatch));
+	PongMatch* specialised = (PongMatch*)malloc(count * sizeof(PongMatch));
+	double total = (double)count * frames / 1e6;
+
+	if (!generic || !specialised)
+	{
+		fprintf(stderr, "*** Out of memory\n");
+		return 1;
+	}
+
+	printf("%d matches x %d frames per mode, M match-frames per second\n\n", count, frames);
+	printf("mode           physics  generic  specialised  speedup\n");
+	for (int kernel = 0; kernel < 8; kernel++)
+	{
+		PongConfig config = *defaults;
+		int mode = kernel % 4;
+		double genericTime = 0.0, specialisedTime = 0.0;
+
+		config.physics = kernel < 4 ? PONG_PHYSICS_CLASSIC : PONG_PHYSICS_SWEPT;
+
+		// best of a few alternating runs, so a busy moment doesn't count against one side
+		for (int run = 0; run < VARIANT_RUNS; run++)
+		{
+			double t = play_variant(&config, generic, count, frames, mode, 0);
+
+			if (run == 0 || t < genericTime)
+			{
+				genericTime = t;
+			}
+			t = play_variant(&config, specialised, count, frames, mode, 1);
+			if (run == 0 || t < specialisedTime)
+			{
+				specialisedTime = t;
+			}
+		}
+
+		if (memcmp(generic, specialised, count * sizeof(PongMatch)) != 0)
+		{
+			fprintf(stderr, "*** %s, %s physics plays differently when specialised\n", names[mode], kernel < 4 ? "classic" : "swept");
+			return 1;
+		}
+		printf("%-13s %8s %8.1f %12.1f %8.2fx\n", names[mode], kernel < 4 ? "classic" : "swept",
+			total / genericTime, total / specialisedTime, genericTime / specialisedTime);
+	}
+
+	free(generic);
+	free(specialised);
+
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	PongConfig config;
+	PongBatch batch;
+	PongMatch* reference = NULL;
+	unsigned int* scriptState;
+	int matches = 4096;
+	int frames = 10000;
+	int scalar = 0;
+	int verify = 0;
+	int variants = 0;
+	long long points = 0;
+	clock_t start, elapsed;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--matches") == 0 && i + 1 < argc)
+		{
+			matches = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+		{
+			frames = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--scalar") == 0)
+		{
+			scalar = 1;
+		}
+		else if (strcmp(argv[i], "--verify") == 0)
+		{
+			verify = 1;
+		}
+		else if (strcmp(argv[i], "--variants") == 0)
+		{
+			variants = 1;
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s [--matches N] [--frames N] [--scalar] [--verify] [--variants]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	pong_config_default(&config);
+	if (variants && matches > 0)
+	{
+		return bench_variants(&config, matches, frames);
+	}
+	if (matches <= 0 || pong_batch_create(&batch, &config, matches) != 0)
+	{
+		fprintf(stderr, "*** Failed to allocate %d matches\n", matches);
+		return 1;
+	}
+
+	scriptState = (unsigned int*)calloc(matches, sizeof(unsigned int));
+	if (verify)
+	{
+		reference = (PongMatch*)malloc(matches * sizeof(PongMatch));
+	}
+	if (!scriptState || (verify && !reference))
+	{
+		fprintf(stderr, "*** Out of memory\n");
+		return 1;
+	}
+
+	for (int i = 0; i < matches; i++)
+	{
+		PongMatch match;
+
+		pong_sim_init(&match, &config);
+		pong_sim_seed(&match, 1, i);
+		pong_batch_load(&batch, i, &match);
+		if (verify)
+		{
+			reference[i] = match;
+		}
+		scriptState[i] = i;
+	}
+
+	printf("%d matches x %d frames, %s kernel%s\n", matches, frames, scalar ? "scalar" : pong_batch_kernel_name(), verify ? ", verifying" : "");
+
+	start = clock();
+	for (int f = 0; f < frames; f++)
+	{
+		for (int i = 0; i < matches; i++)
+		{
+			batch.input[i] = script_input(&scriptState[i], i, i % 4, batch.gameOn[i], batch.ballInPlay[i], f);
+		}
+
+		if (scalar)
+		{
+			pong_batch_step_scalar(&batch);
+		}
+		else
+		{
+			pong_batch_step(&batch);
+		}
+
+		for (int i = 0; i < matches; i++)
+		{
+			if (batch.events[i] & PONG_EVENT_SCORE)
+			{
+				points++;
+			}
+		}
+
+		if (verify)
+		{
+			for (int i = 0; i < matches; i++)
+			{
+				PongMatch lane;
+				unsigned int events = pong_sim_step(&reference[i], batch.input[i]);
+
+				pong_batch_store(&batch, i, &lane);
+				if (events != batch.events[i] || memcmp(&lane, &reference[i], sizeof(lane)) != 0)
+				{
+					fprintf(stderr, "*** Match %d differs from pong_sim_step at frame %d\n", i, f);
+					return 1;
+				}
+			}
+		}
+	}
+	elapsed = clock() - start;
+
+	if (elapsed <= 0)
+	{
+		elapsed = 1;
+	}
+	printf("%lld points scored\n", points);
+	printf("%.1f M match-frames per second%s\n", (double)matches * frames / ((double)elapsed / CLOCKS_PER_SEC) / 1e6, verify ? " (including verification)" : "");
+	if (verify)
+	{
+		printf("all matches identical to pong_sim_step\n");
+	}
+
+	pong_batch_destroy(&batch);
+	free(reference);
+	free(scriptState);
+
+	return 0;
+}
@@ -0,0 +1,372 @@
+/*
+	Program: PONG
+	Tool: tournament
+
+	Round-robin tournament between AI controllers, no window needed. Every
+	ordered pair of controllers plays the requested number of games, spread
+	over all cores with pong_jobs. Each game plays on its own random stream
+	of the tournament seed, picked by the game's number, so results are the
+	same for any thread count.
+
+	--rallies FILE writes a record of every rally played to FILE, see
+	pong_rally, for the rallies tool or anything that reads columns.
+
+	usage: tournament [--games N] [--threads N] [--seed N] [--rwg]
+	                  [--swept] [--ball-cap N] [--max-frames N]
+	                  [--rallies FILE] [controller ...]
+*/
+
+#include <stdio.h>  // standard input/output
+#include <stdlib.h> // atoi(), calloc()
+#include <string.h> // strcmp()
+
+#include "pong_sim.h"
+#include "pong_ai.h"
+#include "pong_jobs.h"
+#include "pong_rally.h"
+#include "pong_thread.h"
+
+#define MAX_CONTROLLERS 16
+
+// totals for one controller, kept per worker so threads never share a counter
+typedef struct Totals
+{
+	long long games;
+	long long wins;
+	long long unfinished;
+	long long pointsFor;
+	long long pointsAgainst;
+	long long rallies;
+	long long hits;
+	long long frames;
+	int longestRally;
+	char padding[60];
+} Totals;
+
+typedef struct Tournament Tournament;
+
+// one worker's rallies, written out a chunk at a time
+typedef struct RallyBuffer
+{
+	Tournament* tournament;
+	PongRallyChunk chunk;
+} RallyBuffer;
+
+struct Tournament
+{
+	PongConfig config;
+	const PongController* controllers[MAX_CONTROLLERS];
+	int controllerCount;
+	int pairs[MAX_CONTROLLERS * MAX_CONTROLLERS][2];	// [pair] = { player 1, player 2 } controller index
+	int pairCount;
+	int gamesPerPair;
+	int RWGMode;
+	int maxFrames;
+	unsigned int seed;
+
+	Totals* totals;				// [worker * controllerCount + controller]
+	long long* pairWins;		// [worker * pairCount + pair], wins for player 1
+
+	PongRallyWriter rallies;
+	PongSpinLock ralliesLock;	// one chunk written at a time
+	RallyBuffer* rallyBuffers;	// [worker], NULL without --rallies
+};
+
+static void add_rally(void* user, const PongRally* rally)
+{
+	RallyBuffer* b = (RallyBuffer*)user;
+
+	if (pong_rally_chunk_add(&b->chunk, rally))
+	{
+		pong_spin_lock(&b->tournament->ralliesLock);
+		pong_rally_writer_write(&b->tournament->rallies, &b->chunk);
+		pong_spin_unlock(&b->tournament->ralliesLock);
+	}
+}
+
+static void add_result(Totals* t, int won, int unfinished, int pointsFor, int pointsAgainst, const PongMatchResult* r)
+{
+	t->games++;
+	t->wins += won;
+	t->unfinished += unfinished;
+	t->pointsFor += pointsFor;
+	t->pointsAgainst += pointsAgainst;
+	t->rallies += r->rallies;
+	t->hits += r->hits;
+	t->frames += r->frames;
+	if (r->longestRally > t->longestRally)
+	{
+		t->longestRally = r->longestRally;
+	}
+}
+
+static void play_job(void* user, int job, int worker)
+{
+	Tournament* t = (Tournament*)user;
+	int pair = job / t->gamesPerPair;
+	int a = t->pairs[pair][0];
+	int b = t->pairs[pair][1];
+	Totals* totals = t->totals + worker * t->controllerCount;
+	PongMatchResult r;
+
+	if (t->rallyBuffers)
+	{
+		pong_ai_play_rallies(&t->config, t->controllers[a], t->controllers[b], t->RWGMode, t->seed, job, t->maxFrames, &r, add_rally, &t->rallyBuffers[worker]);
+	}
+	else
+	{
+		pong_ai_play(&t->config, t->controllers[a], t->controllers[b], t->RWGMode, t->seed, job, t->maxFrames, &r);
+	}
+
+	add_result(&totals[a], r.winner == 1, r.winner == 0, r.p1Score, r.p2Score, &r);
+	add_result(&totals[b], r.winner == 2, r.winner == 0, r.p2Score, r.p1Score, &r);
+	if (r.winner == 1)
+	{
+		t->pairWins[worker * t->pairCount + pair]++;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Tournament t;
+	int threads = pong_cpu_count();
+	int games;
+	double start, elapsed;
+	int nameWidth = 10;	// "controller"
+	const char* ralliesFile = NULL;
+
+	memset(&t, 0, sizeof(t));
+	pong_config_default(&t.config);
+	t.gamesPerPair = 100;
+	t.maxFrames = 60 * 60 * 10; // ten minutes at 60 ticks per second
+	t.seed = 1;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--games") == 0 && i + 1 < argc)
+		{
+			t.gamesPerPair = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			threads = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+		{
+			t.seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "--max-frames") == 0 && i + 1 < argc)
+		{
+			t.maxFrames = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--rwg") == 0)
+		{
+			t.RWGMode = 1;
+		}
+		else if (strcmp(argv[i], "--swept") == 0)
+		{
+			t.config.physics = PONG_PHYSICS_SWEPT;
+		}
+		else if (strcmp(argv[i], "--ball-cap") == 0 && i + 1 < argc)
+		{
+			t.config.ballSpeedCapX = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--rallies") == 0 && i + 1 < argc)
+		{
+			ralliesFile = argv[++i];
+		}
+		else if (argv[i][0] != '-' && t.controllerCount < MAX_CONTROLLERS)
+		{
+			t.controllers[t.controllerCount] = pong_controller_find(argv[i]);
+			if (!t.controllers[t.controllerCount])
+			{
+				fprintf(stderr, "*** Unknown controller: %s\n", argv[i]);
+				return 1;
+			}
+			t.controllerCount++;
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s [--games N] [--threads N] [--seed N] [--rwg] [--swept] [--ball-cap N] [--max-frames N] [--rallies FILE] [controller ...]\n\ncontrollers:\n", argv[0]);
+			for (int c = 0; c < pong_controller_count; c++)
+			{
+				fprintf(stderr, "  %-16s %s\n", pong_controllers[c].name, pong_controllers[c].description);
+			}
+			return 1;
+		}
+	}
+
+	// everyone plays by default
+	if (t.controllerCount == 0)
+	{
+		for (int c = 0; c < pong_controller_count && c < MAX_CONTROLLERS; c++)
+		{
+			t.controllers[t.controllerCount++] = &pong_controllers[c];
+		}
+	}
+	if (t.gamesPerPair <= 0 || threads <= 0 || t.maxFrames <= 0 || t.config.ballSpeedCapX <= 0)
+	{
+		fprintf(stderr, "*** --games, --threads, --ball-cap and --max-frames must be positive\n");
+		return 1;
+	}
+
+	// every ordered pair, so each controller plays both sides against each opponent
+	for (int a = 0; a < t.controllerCount; a++)
+	{
+		for (int b = 0; b < t.controllerCount; b++)
+		{
+			if (a != b || t.controllerCount == 1)
+			{
+				t.pairs[t.pairCount][0] = a;
+				t.pairs[t.pairCount][1] = b;
+				t.pairCount++;
+			}
+		}
+	}
+	games = t.pairCount * t.gamesPerPair;
+
+	t.totals = (Totals*)calloc(threads * t.controllerCount, sizeof(Totals));
+	t.pairWins = (long long*)calloc(threads * t.pairCount, sizeof(long long));
+	if (!t.totals || !t.pairWins)
+	{
+		fprintf(stderr, "*** Out of memory\n");
+		return 1;
+	}
+	if (ralliesFile)
+	{
+		t.rallyBuffers = (RallyBuffer*)calloc(threads, sizeof(RallyBuffer));
+		if (!t.rallyBuffers)
+		{
+			fprintf(stderr, "*** Out of memory\n");
+			return 1;
+		}
+		if (pong_rally_writer_open(&t.rallies, ralliesFile) != 0)
+		{
+			fprintf(stderr, "*** Failed to open rally file %s\n", ralliesFile);
+			return 1;
+		}
+		for (int w = 0; w < threads; w++)
+		{
+			t.rallyBuffers[w].tournament = &t;
+		}
+	}
+
+	printf("%d games (%d per pairing, %s, %s physics, ball cap %d), %d threads, seed %u\n\n", games, t.gamesPerPair, t.RWGMode ? "RWG" : "classic",
+		t.config.physics == PONG_PHYSICS_SWEPT ? "swept" : "classic", t.config.ballSpeedCapX, threads, t.seed);
+
+	start = pong_clock_seconds();
+	if (pong_jobs_run(games, threads, play_job, &t) != 0)
+	{
+		fprintf(stderr, "*** Some worker threads failed to start\n");
+	}
+	elapsed = pong_clock_seconds() - start;
+
+	// whatever each worker had left over
+	if (t.rallyBuffers)
+	{
+		long long rows;
+
+		for (int w = 0; w < threads; w++)
+		{
+			pong_rally_writer_write(&t.rallies, &t.rallyBuffers[w].chunk);
+		}
+		rows = t.rallies.rows;
+		if (pong_rally_writer_close(&t.rallies) != 0)
+		{
+			fprintf(stderr, "*** Failed to write rally file %s\n", ralliesFile);
+		}
+		else
+		{
+			printf("%lld rallies written to %s\n\n", rows, ralliesFile);
+		}
+		free(t.rallyBuffers);
+	}
+
+	// fold the per-worker totals into worker 0
+	for (int w = 1; w < threads; w++)
+	{
+		for (int c = 0; c < t.controllerCount; c++)
+		{
+			Totals* sum = &t.totals[c];
+			Totals* add = &t.totals[w * t.controllerCount + c];
+
+			sum->games += add->games;
+			sum->wins += add->wins;
+			sum->unfinished += add->unfinished;
+			sum->pointsFor += add->pointsFor;
+			sum->pointsAgainst += add->pointsAgainst;
+			sum->rallies += add->rallies;
+			sum->hits += add->hits;
+			sum->frames += add->frames;
+			if (add->longestRally > sum->longestRally)
+			{
+				sum->longestRally = add->longestRally;
+			}
+		}
+		for (int p = 0; p < t.pairCount; p++)
+		{
+			t.pairWins[p] += t.pairWins[w * t.pairCount + p];
+		}
+	}
+
+	// columns as wide as the longest controller name
+	for (int c = 0; c < t.controllerCount; c++)
+	{
+		int width = (int)strlen(t.controllers[c]->name);
+
+		if (width > nameWidth)
+		{
+			nameWidth = width;
+		}
+	}
+
+	printf("%-*s %7s %7s %9s %9s %9s %9s %8s\n", nameWidth, "controller", "games", "win %", "pts/game", "opp/game", "hits/pt", "longest", "unfin.");
+	for (int c = 0; c < t.controllerCount; c++)
+	{
+		Totals* s = &t.totals[c];
+
+		printf("%-*s %7lld %7.1f %9.2f %9.2f %9.2f %9d %8lld\n", nameWidth, t.controllers[c]->name, s->games,
+			100.0 * s->wins / s->games,
+			(double)s->pointsFor / s->games,
+			(double)s->pointsAgainst / s->games,
+			s->rallies ? (double)s->hits / s->rallies : 0.0,
+			s->longestRally,
+			s->unfinished);
+	}
+
+	printf("\nP1 win %% by pairing (row = player 1, column = player 2)\n%-*s", nameWidth, "");
+	for (int b = 0; b < t.controllerCount; b++)
+	{
+		printf(" %*s", nameWidth, t.controllers[b]->name);
+	}
+	printf("\n");
+	for (int a = 0; a < t.controllerCount; a++)
+	{
+		printf("%-*s", nameWidth, t.controllers[a]->name);
+		for (int b = 0; b < t.controllerCount; b++)
+		{
+			int found = 0;
+
+			for (int p = 0; p < t.pairCount; p++)
+			{
+				if (t.pairs[p][0] == a && t.pairs[p][1] == b)
+				{
+					printf(" %*.1f", nameWidth, 100.0 * t.pairWins[p] / t.gamesPerPair);
+					found = 1;
+				}
+			}
+			if (!found)
+			{
+				printf(" %*s", nameWidth, "-");
+			}
+		}
+		printf("\n");
+	}
+
+	printf("\n%.2f s, %.0f games per second\n", elapsed, games / (elapsed > 0 ? elapsed : 1e-9));
+
+	free(t.totals);
+	free(t.pairWins);
+
+	return 0;
+}
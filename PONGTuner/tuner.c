@@ -0,0 +1,557 @@
+/*
+	Program: PONG
+	Tool: tuner
+
+	Searches the balance settings with a genetic algorithm and writes the
+	best ones as a profile the game loads with --profile. Each candidate
+	plays a batch of headless games between a reference controller (P1)
+	and the AI built into pong_sim (P2), spread over all cores with
+	pong_jobs, and is scored by how far it lands from the targets:
+
+		hits per point, how long a rally lasts in paddle hits
+		AI win %, the built-in AI's share of games against the reference
+		seconds per point
+		minutes per game
+
+	Every candidate plays the same games (the same streams of the seed), so
+	two candidates are compared on equal terms and the whole run is the
+	same for any thread count. Results are cached by a hash of the
+	settings, so a candidate bred twice is only played once.
+
+	usage: tuner [--generations N] [--population N] [--games N] [--threads N]
+	             [--seed N] [--reference NAME] [--rwg] [--swept]
+	             [--rally HITS] [--ai-win PCT] [--point-seconds S]
+	             [--game-minutes M] [--max-frames N] [--out FILE]
+*/
+
+#include <stddef.h> // offsetof()
+#include <stdio.h>  // standard input/output
+#include <stdlib.h> // atoi(), atof(), calloc()
+#include <string.h> // strcmp(), memcmp()
+
+#include "pong_sim.h"
+#include "pong_ai.h"
+#include "pong_jobs.h"
+#include "pong_profile.h"
+#include "pong_rng.h"
+#include "pong_thread.h"
+
+//
+// the settings being tuned, and the range each is searched over
+//
+typedef struct Param
+{
+	const char* name;
+	size_t offset;		// in PongConfig
+	int min, max;
+} Param;
+
+static const Param params[] = {
+	{ "paddleSpeed", offsetof(PongConfig, paddleSpeed), 2, 16 },
+	{ "ballSpeedCapX", offsetof(PongConfig, ballSpeedCapX), 3, 20 },
+	{ "ballSpeedCapY", offsetof(PongConfig, ballSpeedCapY), 2, 16 },
+	{ "hitsPerSpeedUp", offsetof(PongConfig, hitsPerSpeedUp), 1, 10 },
+	{ "aiDetectRange", offsetof(PongConfig, aiDetectRange), 2, 8 },
+	{ "winScore", offsetof(PongConfig, winScore), 3, 21 }
+};
+
+#define PARAM_COUNT (int)(sizeof(params) / sizeof(params[0]))
+
+// what a candidate's games came to
+typedef struct Measures
+{
+	double rally;			// hits per point
+	double aiWin;			// 0 to 1
+	double pointSeconds;
+	double gameMinutes;
+	double unfinished;		// share of games cut off by maxFrames
+	double error;			// distance from the targets, lower is better
+} Measures;
+
+typedef struct Candidate
+{
+	int genes[PARAM_COUNT];
+	Measures measures;
+} Candidate;
+
+// one cache entry, found by a hash of the genes
+typedef struct Entry
+{
+	uint32_t hash;
+	int used;
+	int genes[PARAM_COUNT];
+	Measures measures;
+} Entry;
+
+// totals for one candidate, kept per worker so threads never share a counter
+typedef struct Totals
+{
+	long long games;
+	long long aiWins;
+	long long unfinished;
+	long long rallies;
+	long long hits;
+	long long frames;
+	char padding[16];
+} Totals;
+
+typedef struct Tuner
+{
+	PongConfig config;			// everything not being tuned
+	const PongController* reference;
+	int RWGMode;
+	int games;					// per candidate
+	int maxFrames;
+	unsigned int seed;
+
+	// targets, 0 leaves that measure out
+	double targetRally;
+	double targetAIWin;
+	double targetPointSeconds;
+	double targetGameMinutes;
+
+	Entry* cache;
+	int cacheSize;				// a power of two
+	int evaluated;				// candidates played
+	int cacheHits;
+
+	// the candidates being played by pong_jobs
+	Entry** pending;
+	int pendingCount;
+	PongConfig* pendingConfigs;
+	Totals* totals;				// [worker * pendingCount + pending]
+} Tuner;
+
+//
+// candidates
+//
+static void apply_genes(PongConfig* config, const int* genes)
+{
+	for (int p = 0; p < PARAM_COUNT; p++)
+	{
+		*(int*)((char*)config + params[p].offset) = genes[p];
+	}
+}
+
+static int clamp_gene(int p, int value)
+{
+	return value < params[p].min ? params[p].min : value > params[p].max ? params[p].max : value;
+}
+
+// FNV-1a over the genes
+static uint32_t hash_genes(const int* genes)
+{
+	uint32_t hash = 2166136261u;
+
+	for (int p = 0; p < PARAM_COUNT; p++)
+	{
+		uint32_t value = (uint32_t)genes[p];
+
+		for (int b = 0; b < 4; b++)
+		{
+			hash = (hash ^ ((value >> (b * 8)) & 0xff)) * 16777619u;
+		}
+	}
+	return hash;
+}
+
+// the entry for genes, a new unused one if they've never been seen
+static Entry* find_entry(Tuner* t, const int* genes)
+{
+	uint32_t hash = hash_genes(genes);
+	int i = (int)(hash & (t->cacheSize - 1));
+
+	while (t->cache[i].used && (t->cache[i].hash != hash || memcmp(t->cache[i].genes, genes, sizeof(t->cache[i].genes)) != 0))
+	{
+		i = (i + 1) & (t->cacheSize - 1);
+	}
+	t->cache[i].hash = hash;
+	return &t->cache[i];
+}
+
+static double miss(double measured, double target)
+{
+	double share = target > 0.0 ? (measured - target) / target : 0.0;
+
+	return share * share;
+}
+
+static void measure(const Tuner* t, const PongConfig* config, const Totals* s, Measures* m)
+{
+	int tickRate = config->tickRate > 0 ? config->tickRate : 60;
+
+	m->aiWin = (double)s->aiWins / s->games;
+	m->unfinished = (double)s->unfinished / s->games;
+	m->gameMinutes = (double)s->frames / s->games / tickRate / 60.0;
+	if (s->rallies == 0)
+	{
+		// not one point in any game, as far from the targets as it gets
+		m->rally = 0.0;
+		m->pointSeconds = 0.0;
+		m->error = 1e9;
+		return;
+	}
+	m->rally = (double)s->hits / s->rallies;
+	m->pointSeconds = (double)s->frames / s->rallies / tickRate;
+
+	m->error = miss(m->rally, t->targetRally) + miss(m->aiWin, t->targetAIWin)
+		+ miss(m->pointSeconds, t->targetPointSeconds) + miss(m->gameMinutes, t->targetGameMinutes);
+}
+
+static void play_job(void* user, int job, int worker)
+{
+	Tuner* t = (Tuner*)user;
+	int candidate = job / t->games;
+	int game = job % t->games;
+	Totals* s = &t->totals[worker * t->pendingCount + candidate];
+	PongMatchResult r;
+
+	// the same stream for the same game number, whatever the candidate
+	pong_ai_play(&t->pendingConfigs[candidate], t->reference, NULL, t->RWGMode, t->seed, game, t->maxFrames, &r);
+
+	s->games++;
+	s->aiWins += r.winner == 2;
+	s->unfinished += r.winner == 0;
+	s->rallies += r.rallies;
+	s->hits += r.hits;
+	s->frames += r.frames;
+}
+
+// fills in the measures of every candidate, playing only the ones not in
+// the cache. Returns -1 when out of memory
+static int evaluate(Tuner* t, Candidate* population, int count, int threads)
+{
+	t->pendingCount = 0;
+	for (int c = 0; c < count; c++)
+	{
+		Entry* e = find_entry(t, population[c].genes);
+
+		if (e->used)
+		{
+			t->cacheHits++;
+			continue;
+		}
+		// claimed now, so a twin later in the population is a hit too
+		e->used = 1;
+		memcpy(e->genes, population[c].genes, sizeof(e->genes));
+		t->pendingConfigs[t->pendingCount] = t->config;
+		apply_genes(&t->pendingConfigs[t->pendingCount], e->genes);
+		t->pending[t->pendingCount++] = e;
+	}
+
+	if (t->pendingCount > 0)
+	{
+		t->totals = (Totals*)calloc(threads * t->pendingCount, sizeof(Totals));
+		if (!t->totals)
+		{
+			return -1;
+		}
+		if (pong_jobs_run(t->pendingCount * t->games, threads, play_job, t) != 0)
+		{
+			fprintf(stderr, "*** Some worker threads failed to start\n");
+		}
+
+		// fold the per-worker totals into worker 0
+		for (int p = 0; p < t->pendingCount; p++)
+		{
+			Totals* sum = &t->totals[p];
+
+			for (int w = 1; w < threads; w++)
+			{
+				Totals* add = &t->totals[w * t->pendingCount + p];
+
+				sum->games += add->games;
+				sum->aiWins += add->aiWins;
+				sum->unfinished += add->unfinished;
+				sum->rallies += add->rallies;
+				sum->hits += add->hits;
+				sum->frames += add->frames;
+			}
+			measure(t, &t->pendingConfigs[p], sum, &t->pending[p]->measures);
+		}
+		t->evaluated += t->pendingCount;
+
+		free(t->totals);
+		t->totals = NULL;
+	}
+
+	for (int c = 0; c < count; c++)
+	{
+		population[c].measures = find_entry(t, population[c].genes)->measures;
+	}
+	return 0;
+}
+
+//
+// breeding
+//
+
+// best first; equal errors keep their order, so runs repeat exactly
+static void sort_population(Candidate* population, int count)
+{
+	for (int i = 1; i < count; i++)
+	{
+		Candidate c = population[i];
+		int j = i;
+
+		while (j > 0 && population[j - 1].measures.error > c.measures.error)
+		{
+			population[j] = population[j - 1];
+			j--;
+		}
+		population[j] = c;
+	}
+}
+
+// the better of two picked at random
+static const Candidate* select_parent(PongRng* rng, const Candidate* population, int count)
+{
+	int a = pong_rng_below(rng, count);
+	int b = pong_rng_below(rng, count);
+
+	return population[a].measures.error <= population[b].measures.error ? &population[a] : &population[b];
+}
+
+static void breed(PongRng* rng, const Candidate* parents, int count, Candidate* children, int elites)
+{
+	// the best go through unchanged
+	for (int c = 0; c < elites; c++)
+	{
+		children[c] = parents[c];
+	}
+
+	for (int c = elites; c < count; c++)
+	{
+		const Candidate* a = select_parent(rng, parents, count);
+		const Candidate* b = select_parent(rng, parents, count);
+
+		for (int p = 0; p < PARAM_COUNT; p++)
+		{
+			int gene = pong_rng_below(rng, 2) ? a->genes[p] : b->genes[p];
+
+			// a quarter of the genes move by up to a quarter of their range
+			if (pong_rng_below(rng, 4) == 0)
+			{
+				int step = 1 + pong_rng_below(rng, (params[p].max - params[p].min) / 4 + 1);
+
+				gene += pong_rng_below(rng, 2) ? step : -step;
+			}
+			children[c].genes[p] = clamp_gene(p, gene);
+		}
+	}
+}
+
+static void print_candidate(const Candidate* c)
+{
+	for (int p = 0; p < PARAM_COUNT; p++)
+	{
+		printf(" %s %d", params[p].name, c->genes[p]);
+	}
+	printf("\n");
+}
+
+static void print_measures(const Measures* m)
+{
+	printf("%.2f hits/pt, AI win %.1f%%, %.2f s/pt, %.2f min/game, %.1f%% unfinished\n",
+		m->rally, 100.0 * m->aiWin, m->pointSeconds, m->gameMinutes, 100.0 * m->unfinished);
+}
+
+int main(int argc, char** argv)
+{
+	Tuner t;
+	Candidate* population;
+	Candidate* children;
+	PongRng rng;
+	int threads = pong_cpu_count();
+	int generations = 12;
+	int count = 16;
+	const char* outFile = "tuned.profile";
+	char comment[1024];
+	PongConfig best;
+	double start, elapsed;
+
+	memset(&t, 0, sizeof(t));
+	pong_config_default(&t.config);
+	t.reference = pong_controller_find("intercept-medium");
+	t.games = 500;
+	t.maxFrames = 60 * 60 * 10; // ten minutes at 60 ticks per second
+	t.seed = 1;
+	t.targetRally = 6.0;
+	t.targetAIWin = 0.5;
+	t.targetPointSeconds = 8.0;
+	t.targetGameMinutes = 2.5;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--generations") == 0 && i + 1 < argc)
+		{
+			generations = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--population") == 0 && i + 1 < argc)
+		{
+			count = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--games") == 0 && i + 1 < argc)
+		{
+			t.games = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			threads = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+		{
+			t.seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "--reference") == 0 && i + 1 < argc)
+		{
+			t.reference = pong_controller_find(argv[++i]);
+			if (!t.reference)
+			{
+				fprintf(stderr, "*** Unknown controller: %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--rwg") == 0)
+		{
+			t.RWGMode = 1;
+		}
+		else if (strcmp(argv[i], "--swept") == 0)
+		{
+			t.config.physics = PONG_PHYSICS_SWEPT;
+		}
+		else if (strcmp(argv[i], "--rally") == 0 && i + 1 < argc)
+		{
+			t.targetRally = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--ai-win") == 0 && i + 1 < argc)
+		{
+			t.targetAIWin = atof(argv[++i]) / 100.0;
+		}
+		else if (strcmp(argv[i], "--point-seconds") == 0 && i + 1 < argc)
+		{
+			t.targetPointSeconds = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--game-minutes") == 0 && i + 1 < argc)
+		{
+			t.targetGameMinutes = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--max-frames") == 0 && i + 1 < argc)
+		{
+			t.maxFrames = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+		{
+			outFile = argv[++i];
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s [--generations N] [--population N] [--games N] [--threads N] [--seed N] [--reference NAME] [--rwg] [--swept]\n"
+				"             [--rally HITS] [--ai-win PCT] [--point-seconds S] [--game-minutes M] [--max-frames N] [--out FILE]\n\n"
+				"targets of 0 are left out\n", argv[0]);
+			return 1;
+		}
+	}
+	if (generations <= 0 || count < 2 || t.games <= 0 || threads <= 0 || t.maxFrames <= 0)
+	{
+		fprintf(stderr, "*** --generations, --games, --threads and --max-frames must be positive, --population at least 2\n");
+		return 1;
+	}
+	if (t.targetRally < 0.0 || t.targetAIWin < 0.0 || t.targetAIWin > 1.0 || t.targetPointSeconds < 0.0 || t.targetGameMinutes < 0.0)
+	{
+		fprintf(stderr, "*** Targets can't be negative, or an AI win over 100%%\n");
+		return 1;
+	}
+
+	// room for every candidate of every generation at under half full
+	t.cacheSize = 1;
+	while (t.cacheSize < 2 * count * generations + 1)
+	{
+		t.cacheSize *= 2;
+	}
+	t.cache = (Entry*)calloc(t.cacheSize, sizeof(Entry));
+	t.pending = (Entry**)calloc(count, sizeof(Entry*));
+	t.pendingConfigs = (PongConfig*)calloc(count, sizeof(PongConfig));
+	population = (Candidate*)calloc(count, sizeof(Candidate));
+	children = (Candidate*)calloc(count, sizeof(Candidate));
+	if (!t.cache || !t.pending || !t.pendingConfigs || !population || !children)
+	{
+		fprintf(stderr, "*** Out of memory\n");
+		return 1;
+	}
+
+	// the stock settings start out in the running, the rest are random
+	pong_rng_seed(&rng, t.seed, 0);
+	for (int c = 0; c < count; c++)
+	{
+		for (int p = 0; p < PARAM_COUNT; p++)
+		{
+			population[c].genes[p] = c == 0
+				? clamp_gene(p, *(const int*)((const char*)&t.config + params[p].offset))
+				: params[p].min + pong_rng_below(&rng, params[p].max - params[p].min + 1);
+		}
+	}
+
+	printf("%d generations of %d, %d games each (%s vs built-in AI, %s, %s physics), %d threads, seed %u\n",
+		generations, count, t.games, t.reference->name, t.RWGMode ? "RWG" : "classic",
+		t.config.physics == PONG_PHYSICS_SWEPT ? "swept" : "classic", threads, t.seed);
+	printf("targets: %.2f hits/pt, AI win %.1f%%, %.2f s/pt, %.2f min/game\n\n",
+		t.targetRally, 100.0 * t.targetAIWin, t.targetPointSeconds, t.targetGameMinutes);
+
+	start = pong_clock_seconds();
+	for (int g = 0; g < generations; g++)
+	{
+		Candidate* swap;
+		int evaluated = t.evaluated;
+
+		if (evaluate(&t, population, count, threads) != 0)
+		{
+			fprintf(stderr, "*** Out of memory\n");
+			return 1;
+		}
+		sort_population(population, count);
+
+		printf("generation %2d: %2d played, error %.4f:", g + 1, t.evaluated - evaluated, population[0].measures.error);
+		print_candidate(&population[0]);
+
+		// the last generation is only played, not bred from
+		if (g + 1 < generations)
+		{
+			breed(&rng, population, count, children, count / 4 > 0 ? count / 4 : 1);
+			swap = population;
+			population = children;
+			children = swap;
+		}
+	}
+	elapsed = pong_clock_seconds() - start;
+
+	printf("\nbest:");
+	print_candidate(&population[0]);
+	printf("      ");
+	print_measures(&population[0].measures);
+	printf("\n%d candidates played, %d cache hits, %.1f s, %.0f games per second\n", t.evaluated, t.cacheHits, elapsed,
+		(double)t.evaluated * t.games / (elapsed > 0 ? elapsed : 1e-9));
+
+	best = t.config;
+	apply_genes(&best, population[0].genes);
+	sprintf(comment, "PONG balance profile, tuned over %d games against %s (%s)\n"
+		"targets: %.2f hits/pt, AI win %.1f%%, %.2f s/pt, %.2f min/game\n"
+		"reached: %.2f hits/pt, AI win %.1f%%, %.2f s/pt, %.2f min/game",
+		t.games, t.reference->name, t.RWGMode ? "RWG" : "classic",
+		t.targetRally, 100.0 * t.targetAIWin, t.targetPointSeconds, t.targetGameMinutes,
+		population[0].measures.rally, 100.0 * population[0].measures.aiWin, population[0].measures.pointSeconds, population[0].measures.gameMinutes);
+	if (pong_profile_save(&best, outFile, comment) != 0)
+	{
+		fprintf(stderr, "*** Failed to write %s\n", outFile);
+		return 1;
+	}
+	printf("wrote %s\n", outFile);
+
+	free(t.cache);
+	free(t.pending);
+	free(t.pendingConfigs);
+	free(population);
+	free(children);
+
+	return 0;
+}